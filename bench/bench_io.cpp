@@ -0,0 +1,629 @@
+#include "benchmark.h"
+#include "batch.h"
+#include "nativefile.h"
+#include "stepwriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <BRepBuilderAPI_MakeEdge.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <Precision.hxx>
+
+namespace
+{
+	// largest distance between the poles of two curve lists, infinite if their shapes differ
+	double maxPoleDistance(const std::vector<Handle(Geom_BSplineCurve)>& a, const std::vector<Handle(Geom_BSplineCurve)>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return HUGE_VAL;
+		}
+
+		double distance = 0.0;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (a[i]->NbPoles() != b[i]->NbPoles())
+			{
+				return HUGE_VAL;
+			}
+			for (int k = 1; k <= a[i]->NbPoles(); ++k)
+			{
+				distance = std::max(distance, a[i]->Pole(k).Distance(b[i]->Pole(k)));
+			}
+		}
+		return distance;
+	}
+
+	/*
+	 * Write a STEP file holding "copies" copies of the data section of a model, the entities of copy k are renumbered
+	 * by k times the largest id so that every copy is a separate root. Returns the number of bytes written.
+	 **/
+	size_t writeScaledModel(const std::string& source, const std::string& target, int copies)
+	{
+		std::ifstream input(source, std::ios::binary);
+		std::stringstream buffer;
+		buffer << input.rdbuf();
+		std::string text = buffer.str();
+
+		size_t dataBegin = text.find("DATA;");
+		size_t dataEnd = text.rfind("ENDSEC;");
+		if (dataBegin == std::string::npos || dataEnd == std::string::npos || dataEnd < dataBegin)
+		{
+			return 0;
+		}
+		dataBegin += 5;
+		std::string data = text.substr(dataBegin, dataEnd - dataBegin);
+
+		long long maxId = 0;
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			if (data[i] == '#' && i + 1 < data.size() && std::isdigit(static_cast<unsigned char>(data[i + 1])))
+			{
+				maxId = std::max(maxId, std::stoll(data.substr(i + 1, 18)));
+			}
+		}
+
+		std::ofstream output(target, std::ios::binary);
+		output << text.substr(0, dataBegin);
+		std::string copy;
+		for (int k = 0; k < copies; ++k)
+		{
+			// renumber the references outside strings
+			copy.clear();
+			bool inString = false;
+			for (size_t i = 0; i < data.size(); ++i)
+			{
+				char c = data[i];
+				copy += c;
+				if (c == '\'')
+				{
+					inString = !inString;
+				}
+				else if (c == '#' && !inString)
+				{
+					size_t end = i + 1;
+					while (end < data.size() && std::isdigit(static_cast<unsigned char>(data[end])))
+					{
+						++end;
+					}
+					if (end > i + 1)
+					{
+						copy += std::to_string(std::stoll(data.substr(i + 1, end - i - 1)) + k * maxId);
+						i = end - 1;
+					}
+				}
+			}
+			output << copy;
+		}
+		output << text.substr(dataEnd);
+		return static_cast<size_t>(output.tellp());
+	}
+
+	// one fixed-column IGES line: data in columns 1-72, section letter and sequence number
+	std::string igesLine(const std::string& data, char section, int sequence)
+	{
+		char tail[9];
+		std::snprintf(tail, sizeof(tail), "%c%7d", section, sequence);
+		std::string line = data;
+		line.resize(72, ' ');
+		return line + tail + "\n";
+	}
+
+	// split delimited tokens into lines of at most "width" columns without breaking a token
+	std::vector<std::string> wrapTokens(const std::vector<std::string>& tokens, size_t width)
+	{
+		std::vector<std::string> lines(1);
+		for (size_t i = 0; i < tokens.size(); ++i)
+		{
+			std::string token = tokens[i] + (i + 1 == tokens.size() ? ";" : ",");
+			if (lines.back().size() + token.size() > width)
+			{
+				lines.emplace_back();
+			}
+			lines.back() += token;
+		}
+		return lines;
+	}
+
+	std::string igesReal(double value)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%.16E", value);
+		return text;
+	}
+
+	// write curves as independent rational B-spline curve entities (type 126) in millimetres, returns the bytes written
+	size_t writeIgesCurves(const std::vector<Handle(Geom_BSplineCurve)>& curves, const std::string& filename)
+	{
+		std::ofstream output(filename, std::ios::binary);
+		output << igesLine("skin_bench synthetic sections", 'S', 1);
+
+		std::vector<std::string> global = { "1H,", "1H;", "", "", "10Hskin_bench", "", "32", "38", "6", "308", "15", "", "1.0", "2",
+			"2HMM", "1", "0.01", "15H20240101.000000", "1.0E-6", "1000.0", "", "", "11", "0", "15H20240101.000000" };
+		std::vector<std::string> lines = wrapTokens(global, 72);
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			output << igesLine(lines[i], 'G', static_cast<int>(i) + 1);
+		}
+		int numGlobal = static_cast<int>(lines.size());
+
+		// parameter lines of every curve, then the directory entries pointing at them
+		std::vector<std::string> parameters;
+		std::vector<std::pair<int, int>> ranges;
+		for (size_t n = 0; n < curves.size(); ++n)
+		{
+			const Handle(Geom_BSplineCurve)& curve = curves[n];
+			int degree = curve->Degree();
+			std::vector<std::string> tokens = { "126", std::to_string(curve->NbPoles() - 1), std::to_string(degree), "0", "0", "1", "0" };
+			for (int k = 1; k <= curve->NbKnots(); ++k)
+			{
+				for (int m = 0; m < curve->Multiplicity(k); ++m)
+				{
+					tokens.push_back(igesReal(curve->Knot(k)));
+				}
+			}
+			for (int i = 1; i <= curve->NbPoles(); ++i)
+			{
+				tokens.push_back(igesReal(curve->Weight(i)));
+			}
+			for (int i = 1; i <= curve->NbPoles(); ++i)
+			{
+				const gp_Pnt& pole = curve->Pole(i);
+				tokens.insert(tokens.end(), { igesReal(pole.X()), igesReal(pole.Y()), igesReal(pole.Z()) });
+			}
+			tokens.insert(tokens.end(), { igesReal(curve->FirstParameter()), igesReal(curve->LastParameter()), "0.0", "0.0", "0.0" });
+
+			char pointer[9];
+			std::snprintf(pointer, sizeof(pointer), "%8d", static_cast<int>(2 * n + 1));
+			ranges.emplace_back(static_cast<int>(parameters.size()) + 1, 0);
+			for (std::string& line : wrapTokens(tokens, 64))
+			{
+				line.resize(64, ' ');
+				parameters.push_back(line + pointer);
+			}
+			ranges.back().second = static_cast<int>(parameters.size()) + 1 - ranges.back().first;
+		}
+
+		for (size_t n = 0; n < curves.size(); ++n)
+		{
+			char first[73], second[73];
+			std::snprintf(first, sizeof(first), "%8d%8d%8d%8d%8d%8d%8d%8d%8s", 126, ranges[n].first, 0, 0, 0, 0, 0, 0, "00000000");
+			std::snprintf(second, sizeof(second), "%8d%8d%8d%8d%8d%8s%8s%8s%8d", 126, 0, 0, ranges[n].second, 0, "", "", "BSPLINE", 0);
+			output << igesLine(first, 'D', static_cast<int>(2 * n + 1)) << igesLine(second, 'D', static_cast<int>(2 * n + 2));
+		}
+		for (size_t i = 0; i < parameters.size(); ++i)
+		{
+			output << igesLine(parameters[i], 'P', static_cast<int>(i) + 1);
+		}
+
+		char terminate[73];
+		std::snprintf(terminate, sizeof(terminate), "S%7dG%7dD%7dP%7d", 1, numGlobal, static_cast<int>(2 * curves.size()),
+			static_cast<int>(parameters.size()));
+		output << igesLine(terminate, 'T', 1);
+		return static_cast<size_t>(output.tellp());
+	}
+
+	// load time of the fast STEP reader against the full transfer on copies of curves1.step
+	void benchStepCurves(bench::Reporter& reporter)
+	{
+		std::string source = reporter.config().dataDir + "/curves1.step";
+		std::vector<int> copyCounts = reporter.config().full ? std::vector<int>{ 1, 100, 1000, 10000 } : std::vector<int>{ 1, 100, 1000 };
+
+		for (int copies : copyCounts)
+		{
+			std::string filename = (std::filesystem::temp_directory_path() / ("skin_bench_curves_" + std::to_string(copies) + ".step")).string();
+			size_t bytes = writeScaledModel(source, filename, copies);
+			if (bytes == 0)
+			{
+				std::cerr << "cannot scale " << source << std::endl;
+				return;
+			}
+
+			std::vector<Handle(Geom_BSplineCurve)> fullCurves;
+			bench::Timing full = bench::measure([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				io::readModel(filename.c_str(), shapes);
+				util::collectBSplineCurves(shapes, fullCurves);
+			}, 1);
+
+			for (int numThreads : { 1, reporter.config().maxThreads })
+			{
+				std::vector<Handle(Geom_BSplineCurve)> curves;
+				std::string error;
+				bench::Timing timing = bench::measure([&]()
+				{
+					if (!io::readStepCurves(filename, curves, error, numThreads))
+					{
+						std::cerr << error << std::endl;
+					}
+				}, 1);
+
+				reporter.add("io.readStepCurves", { { "copies", copies }, { "megabytes", bytes / 1048576.0 }, { "threads", numThreads } }, timing,
+					{ { "readModel_ms", full.best }, { "speedup", full.best / timing.best }, { "curves", curves.size() },
+					{ "readModel_curves", fullCurves.size() }, { "max_diff", maxPoleDistance(curves, fullCurves) } });
+
+				if (numThreads == reporter.config().maxThreads)
+				{
+					break;
+				}
+			}
+
+			std::filesystem::remove(filename);
+		}
+	}
+	// load time of the fast IGES reader against the full transfer of one file
+	void benchIgesFile(bench::Reporter& reporter, const std::string& name, const std::string& filename,
+		std::vector<std::pair<std::string, double>> params)
+	{
+		std::vector<Handle(Geom_BSplineCurve)> fullCurves;
+		bench::Timing full = bench::measure([&]()
+		{
+			Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+			io::readModel(filename.c_str(), shapes);
+			util::collectBSplineCurves(shapes, fullCurves);
+		}, 1);
+
+		params.push_back({ "megabytes", std::filesystem::file_size(filename) / 1048576.0 });
+		params.push_back({ "threads", 1 });
+		for (int numThreads : { 1, reporter.config().maxThreads })
+		{
+			std::vector<Handle(Geom_BSplineCurve)> curves;
+			std::string error;
+			bench::Timing timing = bench::measure([&]()
+			{
+				if (!io::readIgesCurves(filename, curves, error, numThreads))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, 1);
+
+			params.back().second = numThreads;
+			reporter.add(name, params, timing,
+				{ { "readModel_ms", full.best }, { "speedup", full.best / timing.best }, { "curves", curves.size() },
+				{ "readModel_curves", fullCurves.size() }, { "max_diff", maxPoleDistance(curves, fullCurves) } });
+
+			if (numThreads == reporter.config().maxThreads)
+			{
+				break;
+			}
+		}
+	}
+
+	// demo.igs and synthetic files of 128-pole cubic sections
+	void benchIgesCurves(bench::Reporter& reporter)
+	{
+		benchIgesFile(reporter, "io.readIgesCurves.demo", reporter.config().dataDir + "/demo.igs", {});
+
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		for (int numSections : sectionCounts)
+		{
+			std::string filename = (std::filesystem::temp_directory_path() / ("skin_bench_sections_" + std::to_string(numSections) + ".igs")).string();
+			writeIgesCurves(bench::makeSections(numSections, 128, 3), filename);
+			benchIgesFile(reporter, "io.readIgesCurves", filename, { { "sections", numSections } });
+			std::filesystem::remove(filename);
+		}
+	}
+
+	// surface whose pole (i, j) is the pole i of section j, with a uniform clamped knot vector at v
+	Handle(Geom_BSplineSurface) makeSurface(const std::vector<Handle(Geom_BSplineCurve)>& sections, int degreeV)
+	{
+		const Handle(Geom_BSplineCurve)& first = sections.front();
+		int numPolesV = static_cast<int>(sections.size());
+		TColgp_Array2OfPnt poles(1, first->NbPoles(), 1, numPolesV);
+		for (int j = 1; j <= numPolesV; ++j)
+		{
+			for (int i = 1; i <= first->NbPoles(); ++i)
+			{
+				poles.SetValue(i, j, sections[j - 1]->Pole(i));
+			}
+		}
+
+		int numKnotsV = numPolesV - degreeV + 1;
+		TColStd_Array1OfReal knotsV(1, numKnotsV);
+		TColStd_Array1OfInteger multsV(1, numKnotsV);
+		for (int i = 1; i <= numKnotsV; ++i)
+		{
+			knotsV.SetValue(i, static_cast<double>(i - 1) / (numKnotsV - 1));
+			multsV.SetValue(i, 1);
+		}
+		multsV.SetValue(1, degreeV + 1);
+		multsV.SetValue(numKnotsV, degreeV + 1);
+
+		return new Geom_BSplineSurface(poles, first->Knots(), knotsV, first->Multiplicities(), multsV, first->Degree(), degreeV);
+	}
+
+	// save and load times of the native format against STEP, for section sets and for the surface built on their poles
+	void benchNative(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		std::filesystem::path directory = std::filesystem::temp_directory_path();
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<Handle(Geom_BSplineCurve)> sections = bench::makeSections(numSections, 128, 3);
+			std::string nativeName = (directory / ("skin_bench_native_" + std::to_string(numSections) + ".nrb")).string();
+			std::string stepName = (directory / ("skin_bench_native_" + std::to_string(numSections) + ".step")).string();
+			std::string error;
+
+			bench::Timing saveNative = bench::measure([&]()
+			{
+				if (!io::saveNative(nativeName, sections, {}, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, 1);
+			bench::Timing saveStep = bench::measure([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				for (const auto& section : sections)
+				{
+					shapes->Append(BRepBuilderAPI_MakeEdge(section).Edge());
+				}
+				io::saveStep(stepName.c_str(), shapes, STEPControl_AsIs);
+			}, 1);
+
+			io::NativeFile file;
+			bench::Timing open = bench::measure([&]()
+			{
+				if (!file.open(nativeName, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			});
+			file.close();
+
+			std::vector<Handle(Geom_BSplineCurve)> curves;
+			std::vector<Handle(Geom_BSplineSurface)> surfaces;
+			bench::Timing loadNative = bench::measure([&]()
+			{
+				if (!io::readNative(nativeName, curves, surfaces, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, 1);
+
+			std::vector<Handle(Geom_BSplineCurve)> fastCurves;
+			bench::Timing loadFast = bench::measure([&]()
+			{
+				io::readStepCurves(stepName, fastCurves, error, 1);
+			}, 1);
+			std::vector<Handle(Geom_BSplineCurve)> stepCurves;
+			bench::Timing loadStep = bench::measure([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				io::readModel(stepName.c_str(), shapes);
+				util::collectBSplineCurves(shapes, stepCurves);
+			}, 1);
+
+			reporter.add("io.native.curves", { { "sections", numSections }, { "poles", 128 } }, loadNative,
+				{ { "open_ms", open.best }, { "save_ms", saveNative.best }, { "saveStep_ms", saveStep.best },
+				{ "readStepCurves_ms", loadFast.best }, { "readModel_ms", loadStep.best },
+				{ "load_speedup", loadStep.best / loadNative.best }, { "save_speedup", saveStep.best / saveNative.best },
+				{ "native_mb", std::filesystem::file_size(nativeName) / 1048576.0 }, { "step_mb", std::filesystem::file_size(stepName) / 1048576.0 },
+				{ "max_diff", maxPoleDistance(curves, sections) }, { "step_max_diff", maxPoleDistance(stepCurves, sections) } });
+
+			// one surface of 128 by numSections poles
+			Handle(Geom_BSplineSurface) surface = makeSurface(sections, 3);
+			bench::Timing saveSurface = bench::measure([&]()
+			{
+				if (!io::saveNative(nativeName, {}, { surface }, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, 1);
+			bench::Timing saveSurfaceStep = bench::measure([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				shapes->Append(BRepBuilderAPI_MakeFace(surface, Precision::Confusion()).Face());
+				io::saveStep(stepName.c_str(), shapes, STEPControl_AsIs);
+			}, 1);
+			bench::Timing loadSurface = bench::measure([&]()
+			{
+				if (!io::readNative(nativeName, curves, surfaces, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, 1);
+			bench::Timing loadSurfaceStep = bench::measure([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				io::readModel(stepName.c_str(), shapes);
+			}, 1);
+
+			reporter.add("io.native.surface", { { "sections", numSections }, { "poles", 128 } }, loadSurface,
+				{ { "save_ms", saveSurface.best }, { "saveStep_ms", saveSurfaceStep.best }, { "readModel_ms", loadSurfaceStep.best },
+				{ "load_speedup", loadSurfaceStep.best / loadSurface.best }, { "save_speedup", saveSurfaceStep.best / saveSurface.best },
+				{ "native_mb", std::filesystem::file_size(nativeName) / 1048576.0 }, { "step_mb", std::filesystem::file_size(stepName) / 1048576.0 } });
+
+			std::filesystem::remove(nativeName);
+			std::filesystem::remove(stepName);
+		}
+	}
+
+	// run a writer once, peakMB receives the growth of the peak resident memory over the memory at its start
+	bench::Timing measureWriter(const std::function<void()>& write, double& peakMB)
+	{
+		bool reset = bench::resetPeakMemory();
+		double start = bench::residentMemoryMB();
+		bench::Timing timing = bench::measure(write, 1, 0.0);
+		peakMB = reset ? bench::peakMemoryMB() - start : NAN;
+		return timing;
+	}
+
+	// time and memory of the streaming STEP writer, single and sharded, against saveStep of one face per surface
+	void benchStepStream(bench::Reporter& reporter)
+	{
+		std::vector<int> surfaceCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		const uint64_t shardBytes = 16 << 20;
+		Handle(Geom_BSplineSurface) model = makeSurface(bench::makeSections(16, 64, 3), 3);
+
+		for (int numSurfaces : surfaceCounts)
+		{
+			std::vector<Handle(Geom_BSplineSurface)> surfaces;
+			for (int k = 0; k < numSurfaces; ++k)
+			{
+				surfaces.emplace_back(Handle(Geom_BSplineSurface)::DownCast(model->Copy()));
+			}
+			std::string filename = (std::filesystem::temp_directory_path() / ("skin_bench_stream_" + std::to_string(numSurfaces) + ".step")).string();
+			std::string error;
+			std::vector<std::string> files;
+
+			double streamPeak = 0.0;
+			bench::Timing stream = measureWriter([&]()
+			{
+				if (!io::saveStepStream(filename, {}, surfaces, error))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, streamPeak);
+			double megabytes = std::filesystem::file_size(filename) / 1048576.0;
+			std::filesystem::remove(filename);
+
+			double shardedPeak = 0.0;
+			bench::Timing sharded = measureWriter([&]()
+			{
+				if (!io::saveStepStream(filename, {}, surfaces, error, shardBytes, &files))
+				{
+					std::cerr << error << std::endl;
+				}
+			}, shardedPeak);
+			for (const auto& file : files)
+			{
+				std::filesystem::remove(file);
+			}
+
+			double stepPeak = 0.0;
+			bench::Timing step = measureWriter([&]()
+			{
+				Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+				for (const auto& surface : surfaces)
+				{
+					shapes->Append(BRepBuilderAPI_MakeFace(surface, Precision::Confusion()).Face());
+				}
+				io::saveStep(filename.c_str(), shapes, STEPControl_AsIs);
+			}, stepPeak);
+			double stepMegabytes = std::filesystem::exists(filename) ? std::filesystem::file_size(filename) / 1048576.0 : 0.0;
+			std::filesystem::remove(filename);
+
+			reporter.add("io.stepStream", { { "surfaces", numSurfaces }, { "poles", model->NbUPoles() * model->NbVPoles() } }, stream,
+				{ { "megabytes", megabytes }, { "mb_per_s", megabytes / (stream.best / 1000.0) }, { "peak_rss_mb", streamPeak },
+				{ "sharded_ms", sharded.best }, { "shards", files.size() }, { "sharded_peak_rss_mb", shardedPeak },
+				{ "saveStep_ms", step.best }, { "saveStep_megabytes", stepMegabytes }, { "saveStep_peak_rss_mb", stepPeak },
+				{ "speedup", step.best / stream.best } });
+		}
+	}
+
+	// end-to-end batch of jobs read, skinned and written one after the other and by batch::runPipeline
+	void benchBatchPipeline(bench::Reporter& reporter)
+	{
+		int numInputs = reporter.config().full ? 64 : 16;
+		std::filesystem::path directory = std::filesystem::temp_directory_path() / "skin_bench_pipeline";
+		std::filesystem::create_directories(directory);
+
+		for (std::string format : { "step", "nrb" })
+		{
+			// two jobs per input, all the sections and the first half of them
+			std::vector<batch::Job> jobs;
+			for (int i = 0; i < numInputs; ++i)
+			{
+				std::vector<Handle(Geom_BSplineCurve)> sections = bench::makeSections(40, 64 + 8 * (i % 8), 3);
+				std::string input = (directory / ("input_" + std::to_string(i) + "." + format)).string();
+				std::string error;
+				if (format == "nrb")
+				{
+					io::saveNative(input, sections, {}, error);
+				}
+				else
+				{
+					Handle(TopTools_HSequenceOfShape) shapes = new TopTools_HSequenceOfShape();
+					for (const auto& section : sections)
+					{
+						shapes->Append(BRepBuilderAPI_MakeEdge(section).Edge());
+					}
+					io::saveStep(input.c_str(), shapes, STEPControl_AsIs);
+				}
+
+				batch::Job job;
+				job.input = input;
+				job.output = (directory / ("output_" + std::to_string(i) + "_all." + format)).string();
+				jobs.push_back(job);
+				job.selection.resize(20);
+				std::iota(job.selection.begin(), job.selection.end(), 1);
+				job.output = (directory / ("output_" + std::to_string(i) + "_half." + format)).string();
+				jobs.push_back(job);
+			}
+
+			SkinOptions options;
+			int numFailed = 0;
+			double sequentialPeak = 0.0;
+			bench::Timing sequential = measureWriter([&]()
+			{
+				numFailed = 0;
+				std::string loadedInput;
+				std::vector<Handle(Geom_BSplineCurve)> curves;
+				for (const auto& job : jobs)
+				{
+					std::string error;
+					std::vector<Handle(Geom_BSplineCurve)> sections;
+					Handle(Geom_BSplineSurface) surface;
+					if (job.input != loadedInput)
+					{
+						loadedInput = job.input;
+						batch::loadCurves(job.input, curves, error);
+					}
+					bool success = batch::selectCurves(job, curves, sections, error) && batch::skinSections(job, sections, options, surface, error) &&
+						batch::writeSurface(job, surface, error);
+					numFailed += success ? 0 : 1;
+				}
+			}, sequentialPeak);
+
+			// one skin worker, and the threads left by the reader and the writer
+			std::vector<int> workerCounts = { 1 };
+			if (reporter.config().maxThreads > 3)
+			{
+				workerCounts.push_back(reporter.config().maxThreads - 2);
+			}
+			for (int numSkinWorkers : workerCounts)
+			{
+				batch::PipelineOptions pipelineOptions;
+				pipelineOptions.numSkinWorkers = numSkinWorkers;
+				int numPipelineFailed = 0;
+				double pipelinePeak = 0.0;
+				bench::Timing pipelined = measureWriter([&]()
+				{
+					numPipelineFailed = 0;
+					batch::runPipeline(jobs, options, pipelineOptions, [&](batch::JobResult& result)
+					{
+						numPipelineFailed += result.success ? 0 : 1;
+					});
+				}, pipelinePeak);
+
+				reporter.add("io.pipeline." + format, { { "jobs", jobs.size() }, { "queue_depth", pipelineOptions.queueDepth },
+					{ "skin_workers", numSkinWorkers } }, pipelined,
+					{ { "jobs_per_s", jobs.size() * 1000.0 / pipelined.best }, { "peak_rss_mb", pipelinePeak }, { "failed", numPipelineFailed },
+					{ "sequential_ms", sequential.best }, { "sequential_peak_rss_mb", sequentialPeak }, { "sequential_failed", numFailed },
+					{ "speedup", sequential.best / pipelined.best } });
+			}
+		}
+
+		std::filesystem::remove_all(directory);
+	}
+}
+
+std::vector<bench::Group> bench::ioBenchmarks()
+{
+	return {
+		{ "io.readStepCurves", benchStepCurves },
+		{ "io.readIgesCurves", benchIgesCurves },
+		{ "io.native", benchNative },
+		{ "io.stepStream", benchStepStream },
+		{ "io.pipeline", benchBatchPipeline },
+	};
+}
@@ -0,0 +1,397 @@
+#include "benchmark.h"
+#include "basis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace
+{
+	volatile double sink = 0.0;	// keeps the optimizer from dropping benchmarked calls
+
+	std::vector<int> pointCounts(const bench::Config& config)
+	{
+		return config.full ? std::vector<int>{ 16, 256, 4096, 65536 } : std::vector<int>{ 16, 256, 4096 };
+	}
+
+	// points on a helix, column c is shifted by c
+	TColgp_Array1OfPnt makeColumn(int numPoints, int column)
+	{
+		TColgp_Array1OfPnt points(1, numPoints);
+		for (int i = 1; i <= numPoints; ++i)
+		{
+			double t = 0.05 * i;
+			points.SetValue(i, gp_Pnt(std::cos(t) + column, std::sin(t), 0.1 * t));
+		}
+		return points;
+	}
+
+	// clamped averaged knot vector of numPoints chord length parameters
+	void makeKnots(int numPoints, int degree, std::vector<double>& params, std::vector<double>& knots)
+	{
+		nurbs::getChordParameterization(makeColumn(numPoints, 0), params);
+		nurbs::averageKnotVector(degree, params, knots);
+	}
+
+	std::vector<double> randomParams(int count)
+	{
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<double> distribution(0.0, 1.0);
+		std::vector<double> params(count);
+		for (auto& u : params)
+		{
+			u = distribution(generator);
+		}
+		return params;
+	}
+
+	void benchFindSpan(bench::Reporter& reporter)
+	{
+		std::vector<double> us = randomParams(4096);
+		for (int degree : { 1, 3, 5, 7 })
+		{
+			for (int numPoints : pointCounts(reporter.config()))
+			{
+				if (numPoints <= degree)
+				{
+					continue;
+				}
+				std::vector<double> params, knots;
+				makeKnots(numPoints, degree, params, knots);
+
+				bench::Timing timing = bench::measure([&]()
+					{
+						int sum = 0;
+						for (double u : us)
+						{
+							sum += nurbs::findSpan(degree, knots, u);
+						}
+						sink = sum;
+					});
+				reporter.add("nurbs.findSpan", { { "degree", degree }, { "knots", knots.size() }, { "calls", us.size() } }, timing,
+					{ { "ns_per_call", timing.best * 1e6 / us.size() } });
+			}
+		}
+	}
+
+	// calcBasisFunctions before the degree specialized kernels, kept as the reference of allocations and time
+	void legacyBasisFunctions(int span, int degree, const std::vector<double>& knots, double u, std::vector<double>& basisFuns)
+	{
+		basisFuns.resize(degree + 1);
+		std::vector<double> left(degree + 1), right(degree + 1);
+		basisFuns[0] = 1.0;
+
+		for (int j = 1; j <= degree; j++)
+		{
+			left[j] = u - knots[span + 1 - j];
+			right[j] = knots[span + j] - u;
+			double saved = 0.0;
+			for (int r = 0; r < j; r++)
+			{
+				double temp = basisFuns[r] / (right[r + 1] + left[j - r]);
+				basisFuns[r] = saved + right[r + 1] * temp;
+				saved = left[j - r] * temp;
+			}
+			basisFuns[j] = saved;
+		}
+	}
+
+	void benchBasisFunctions(bench::Reporter& reporter)
+	{
+		std::vector<double> us = randomParams(4096);
+		double numCalls = static_cast<double>(us.size());
+
+		for (int degree : { 1, 2, 3, 4, 5, 6, 7, 9 })
+		{
+			std::vector<double> params, knots;
+			makeKnots(256, degree, params, knots);
+			std::vector<int> spans(us.size());
+			for (size_t i = 0; i < us.size(); ++i)
+			{
+				spans[i] = nurbs::findSpan(degree, knots, us[i]);
+			}
+
+			std::vector<double> values(degree + 1);
+			double buffer[nurbs::maxBasisDegree + 1];
+
+			// time a variant and count its allocations over one sweep of the parameters
+			auto run = [&](const char* variant, auto call)
+			{
+				long long before = bench::allocationCount();
+				for (size_t i = 0; i < us.size(); ++i)
+				{
+					call(i);
+				}
+				double allocationsPerCall = (bench::allocationCount() - before) / numCalls;
+
+				bench::Timing timing = bench::measure([&]()
+					{
+						for (size_t i = 0; i < us.size(); ++i)
+						{
+							call(i);
+						}
+						sink = values[0] + buffer[0];
+					});
+				reporter.add(std::string("nurbs.calcBasisFunctions.") + variant, { { "degree", degree }, { "calls", numCalls } }, timing,
+					{ { "ns_per_call", timing.best * 1e6 / numCalls }, { "allocations_per_call", allocationsPerCall } });
+			};
+
+			run("legacy", [&](size_t i) { legacyBasisFunctions(spans[i], degree, knots, us[i], values); });
+			run("vector", [&](size_t i) { nurbs::calcBasisFunctions(spans[i], degree, knots, us[i], values); });
+			run("pointer", [&](size_t i) { nurbs::calcBasisFunctions(spans[i], degree, knots.data(), us[i], buffer); });
+		}
+	}
+
+	// batched evaluation against one scalar call per parameter, differences are measured in units of the last place
+	void benchBasisFunctionsBatch(bench::Reporter& reporter)
+	{
+		int count = reporter.config().full ? 1000000 : 65536;
+		std::vector<double> random = randomParams(count);
+		std::vector<double> grid(count);
+		for (int i = 0; i < count; ++i)
+		{
+			grid[i] = static_cast<double>(i) / (count - 1);
+		}
+
+		for (int degree : { 1, 3, 5, 7 })
+		{
+			std::vector<double> params, knots;
+			makeKnots(256, degree, params, knots);
+
+			std::vector<int> spans(count);
+			std::vector<double> batch(static_cast<size_t>(degree + 1) * count);
+			std::vector<double> scalar(static_cast<size_t>(degree + 1) * count);
+			double values[nurbs::maxBasisDegree + 1];
+
+			// sorted grid samples and random parameters
+			for (bool sorted : { true, false })
+			{
+				const std::vector<double>& us = sorted ? grid : random;
+
+				bench::Timing scalarTiming = bench::measure([&]()
+					{
+						for (int i = 0; i < count; ++i)
+						{
+							int span = nurbs::findSpan(degree, knots, us[i]);
+							nurbs::calcBasisFunctions(span, degree, knots.data(), us[i], values);
+							for (int k = 0; k <= degree; ++k)
+							{
+								scalar[static_cast<size_t>(k) * count + i] = values[k];
+							}
+						}
+					});
+				bench::Timing batchTiming = bench::measure([&]()
+					{
+						nurbs::calcBasisFunctionsBatch(degree, knots, us.data(), count, spans.data(), batch.data());
+					});
+
+				double maxUlps = 0.0;
+				for (size_t i = 0; i < batch.size(); ++i)
+				{
+					double ulp = std::max(std::abs(scalar[i]), std::numeric_limits<double>::min()) * std::numeric_limits<double>::epsilon();
+					maxUlps = std::max(maxUlps, std::abs(batch[i] - scalar[i]) / ulp);
+				}
+
+				reporter.add("nurbs.calcBasisFunctionsBatch", { { "degree", degree }, { "params", count }, { "sorted", sorted },
+					{ "lanes", nurbs::batchLaneWidth() } }, batchTiming,
+					{ { "scalar_ms", scalarTiming.best }, { "speedup", scalarTiming.best / batchTiming.best }, { "max_ulps", maxUlps } });
+			}
+		}
+	}
+
+	void benchChordParameterization(bench::Reporter& reporter)
+	{
+		for (int numColumns : { 16, 512 })
+		{
+			for (int numPoints : pointCounts(reporter.config()))
+			{
+				if (static_cast<double>(numColumns) * numPoints > 4e6)
+				{
+					continue;
+				}
+				std::vector<TColgp_Array1OfPnt> columns;
+				for (int c = 0; c < numColumns; ++c)
+				{
+					columns.emplace_back(makeColumn(numPoints, c));
+				}
+
+				std::vector<double> params;
+				bench::Timing timing = bench::measure([&]()
+					{
+						nurbs::getChordParameterization(columns, params);
+						sink = params[1];
+					});
+				reporter.add("nurbs.getChordParameterization", { { "columns", numColumns }, { "points", numPoints } }, timing,
+					{ { "ns_per_point", timing.best * 1e6 / (static_cast<double>(numColumns) * numPoints) } });
+			}
+		}
+	}
+
+	// the chord length parameterization of a control net as it was done before: one pass for the total lengths
+	// of the columns and another one computing the same distances again
+	void twoPassChordParameterization(const nurbs::ControlNet& net, std::vector<double>& params)
+	{
+		int size = net.rows();
+		int number = net.cols();
+		const double* x = net.plane(0);
+		const double* y = net.plane(1);
+		const double* z = net.plane(2);
+
+		auto distance = [&](int j, int i)
+		{
+			size_t k = static_cast<size_t>(j) * number + i;
+			double dx = x[k] - x[k - number];
+			double dy = y[k] - y[k - number];
+			double dz = z[k] - z[k - number];
+			return std::sqrt(dx * dx + dy * dy + dz * dz);
+		};
+
+		std::vector<double> lengths(number, 0.0);
+		for (int j = 1; j < size; ++j)
+		{
+			for (int i = 0; i < number; ++i)
+			{
+				lengths[i] += distance(j, i);
+			}
+		}
+
+		params.assign(size, 0.0);
+		params[size - 1] = 1.0;
+		std::vector<double> accumulated(number, 0.0);
+		for (int j = 1; j < size - 1; ++j)
+		{
+			double sum = 0.0;
+			for (int i = 0; i < number; ++i)
+			{
+				accumulated[i] += distance(j, i) / lengths[i];
+				sum += accumulated[i];
+			}
+			params[j] = sum / number;
+		}
+	}
+
+	// parameters of the rows of large control nets, row j is a helix shifted by j
+	void benchParameterization(bench::Reporter& reporter)
+	{
+		std::vector<std::pair<int, int>> sizes = { { 1000, 128 }, { 1000, 1024 }, { 100, 16384 } };
+		if (reporter.config().full)
+		{
+			sizes.push_back({ 10000, 512 });
+		}
+
+		for (const auto& size : sizes)
+		{
+			int numRows = size.first, numCols = size.second;
+			nurbs::ControlNet net(numRows, numCols);
+			for (int j = 0; j < numRows; ++j)
+			{
+				TColgp_Array1OfPnt row = makeColumn(numCols, 0);
+				for (int i = 1; i <= numCols; ++i)
+				{
+					row.SetValue(i, gp_Pnt(row.Value(i).X(), row.Value(i).Y() + 0.01 * std::sin(0.1 * j), row.Value(i).Z() + j));
+				}
+				net.setRow(j, row);
+			}
+
+			std::vector<double> reference, params;
+			bench::Timing twoPass = bench::measure([&]()
+				{
+					twoPassChordParameterization(net, reference);
+					sink = reference[1];
+				});
+
+			const std::pair<const char*, nurbs::Parameterization> schemes[] = { { "chord", nurbs::Parameterization::ChordLength },
+				{ "centripetal", nurbs::Parameterization::Centripetal }, { "uniform", nurbs::Parameterization::Uniform } };
+			for (const auto& scheme : schemes)
+			{
+				for (int numThreads : { 1, reporter.config().maxThreads })
+				{
+					bench::Timing timing = bench::measure([&]()
+						{
+							nurbs::getParameterization(net, scheme.second, params, numThreads);
+							sink = params[1];
+						});
+
+					double maxDiff = 0.0;
+					for (int j = 0; j < numRows && scheme.second == nurbs::Parameterization::ChordLength; ++j)
+					{
+						maxDiff = std::max(maxDiff, std::abs(params[j] - reference[j]));
+					}
+
+					reporter.add(std::string("nurbs.getParameterization.") + scheme.first, { { "rows", numRows }, { "columns", numCols },
+						{ "threads", numThreads }, { "lanes", nurbs::batchLaneWidth() } }, timing,
+						{ { "two_pass_ms", twoPass.best }, { "speedup", twoPass.best / timing.best },
+						{ "ns_per_point", timing.best * 1e6 / (static_cast<double>(numRows) * numCols) }, { "max_diff", maxDiff } });
+
+					if (numThreads == reporter.config().maxThreads)
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void benchAverageKnotVector(bench::Reporter& reporter)
+	{
+		for (int degree : { 1, 3, 5, 7 })
+		{
+			for (int numPoints : pointCounts(reporter.config()))
+			{
+				if (numPoints <= degree)
+				{
+					continue;
+				}
+				std::vector<double> params, knots;
+				nurbs::getChordParameterization(makeColumn(numPoints, 0), params);
+
+				bench::Timing timing = bench::measure([&]()
+					{
+						nurbs::averageKnotVector(degree, params, knots);
+						sink = knots[degree + 1];
+					});
+				reporter.add("nurbs.averageKnotVector", { { "degree", degree }, { "points", numPoints } }, timing);
+			}
+		}
+	}
+
+	void benchCurveInterpolation(bench::Reporter& reporter)
+	{
+		for (int degree : { 1, 3, 5, 7 })
+		{
+			for (int numPoints : pointCounts(reporter.config()))
+			{
+				if (numPoints <= degree)
+				{
+					continue;
+				}
+				std::vector<double> params, knots;
+				makeKnots(numPoints, degree, params, knots);
+				TColgp_Array1OfPnt points = makeColumn(numPoints, 0);
+				TColgp_Array1OfPnt controlPoints(1, numPoints);
+
+				bench::Timing timing = bench::measure([&]()
+					{
+						nurbs::curveInterpolation(params, knots, points, controlPoints);
+						sink = controlPoints.Value(1).X();
+					});
+				reporter.add("nurbs.curveInterpolation", { { "degree", degree }, { "points", numPoints } }, timing,
+					{ { "ns_per_point", timing.best * 1e6 / numPoints } });
+			}
+		}
+	}
+}
+
+std::vector<bench::Group> bench::nurbsBenchmarks()
+{
+	return {
+		{ "nurbs.findSpan", benchFindSpan },
+		{ "nurbs.calcBasisFunctions", benchBasisFunctions },
+		{ "nurbs.calcBasisFunctionsBatch", benchBasisFunctionsBatch },
+		{ "nurbs.getChordParameterization", benchChordParameterization },
+		{ "nurbs.getParameterization", benchParameterization },
+		{ "nurbs.averageKnotVector", benchAverageKnotVector },
+		{ "nurbs.curveInterpolation", benchCurveInterpolation },
+	};
+}
@@ -0,0 +1,795 @@
+#include "benchmark.h"
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <map>
+#include <random>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct Family
+	{
+		int numSections;
+		int numPoles;
+		int degree;
+	};
+
+	// section families sweeping the section count, the poles per section and the degree
+	std::vector<Family> families(const bench::Config& config)
+	{
+		std::vector<int> sectionCounts = config.full ? std::vector<int>{ 10, 100, 1000, 10000 } : std::vector<int>{ 10, 100, 1000 };
+		std::vector<int> poleCounts = config.full ? std::vector<int>{ 16, 128, 512 } : std::vector<int>{ 16, 128 };
+		std::vector<int> degrees = config.full ? std::vector<int>{ 1, 3, 5 } : std::vector<int>{ 3 };
+
+		std::vector<Family> result;
+		for (int numSections : sectionCounts)
+		{
+			for (int numPoles : poleCounts)
+			{
+				for (int degree : degrees)
+				{
+					// keep the control net under a few million points
+					if (static_cast<double>(numSections) * numPoles <= 2e6)
+					{
+						result.push_back({ numSections, numPoles, degree });
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	// time the constructor and skin() separately on fresh copies of the curves
+	void benchPipeline(bench::Reporter& reporter, const std::string& name, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+		int degreeV, std::vector<std::pair<std::string, double>> params)
+	{
+		int repeats = curves.size() >= 1000 ? 1 : 3;
+		double constructBest = 0.0, skinBest = 0.0;
+		int polesU = 0, polesV = 0;
+
+		for (int r = 0; r < repeats; ++r)
+		{
+			std::vector<Handle(Geom_BSplineCurve)> sections = bench::copyCurves(curves);
+
+			auto start = Clock::now();
+			Skin skin(sections, degreeV);
+			double constructMs = elapsedMs(start);
+
+			start = Clock::now();
+			skin.skin();
+			double skinMs = elapsedMs(start);
+
+			constructBest = r == 0 ? constructMs : std::min(constructBest, constructMs);
+			skinBest = r == 0 ? skinMs : std::min(skinBest, skinMs);
+
+			Handle(Geom_BSplineSurface) surface = skin.getSurface();
+			if (!surface.IsNull())
+			{
+				polesU = surface->NbUPoles();
+				polesV = surface->NbVPoles();
+			}
+		}
+
+		params.push_back({ "degreeV", degreeV });
+		reporter.add({ name, params, { { "construct_ms", constructBest }, { "skin_ms", skinBest },
+			{ "total_ms", constructBest + skinBest }, { "poles_u", polesU }, { "poles_v", polesV } } });
+	}
+
+	void benchSyntheticFamilies(bench::Reporter& reporter)
+	{
+		for (const Family& family : families(reporter.config()))
+		{
+			std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(family.numSections, family.numPoles, family.degree);
+			benchPipeline(reporter, "skin.synthetic", curves, std::min(3, family.numSections - 1),
+				{ { "sections", family.numSections }, { "poles", family.numPoles }, { "degree", family.degree } });
+		}
+	}
+
+	void benchShippedModel(bench::Reporter& reporter)
+	{
+		std::string filename = reporter.config().dataDir + "/curves1.step";
+		std::vector<Handle(Geom_BSplineCurve)> curves;
+		std::string error;
+
+		auto start = Clock::now();
+		if (!batch::loadCurves(filename, curves, error))
+		{
+			std::cerr << error << std::endl;
+			return;
+		}
+		reporter.add({ "io.readModel.curves1", { { "curves", curves.size() } }, { { "read_ms", elapsedMs(start) } } });
+
+		benchPipeline(reporter, "skin.curves1", curves, std::min(3, static_cast<int>(curves.size()) - 1),
+			{ { "sections", curves.size() } });
+	}
+
+	bool isIdentical(const Handle(Geom_BSplineSurface)& a, const Handle(Geom_BSplineSurface)& b)
+	{
+		if (a.IsNull() || b.IsNull() || a->NbUPoles() != b->NbUPoles() || a->NbVPoles() != b->NbVPoles())
+		{
+			return false;
+		}
+
+		const TColgp_Array2OfPnt& polesA = a->Poles();
+		const TColgp_Array2OfPnt& polesB = b->Poles();
+		for (int i = polesA.LowerRow(); i <= polesA.UpperRow(); ++i)
+		{
+			for (int j = polesA.LowerCol(); j <= polesA.UpperCol(); ++j)
+			{
+				const gp_Pnt& pa = polesA.Value(i, j);
+				const gp_Pnt& pb = polesB.Value(i, j);
+				if (pa.X() != pb.X() || pa.Y() != pb.Y() || pa.Z() != pb.Z())
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// time skin() with 1 to maxThreads threads and compare every result with the serial one
+	void benchThreadScaling(bench::Reporter& reporter)
+	{
+		int numSections = reporter.config().full ? 1000 : 300;
+		int numPoles = 500;
+		std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+
+		// 1, 2, 4, ... and maxThreads
+		std::vector<int> threadCounts;
+		for (int numThreads = 1; numThreads < reporter.config().maxThreads; numThreads *= 2)
+		{
+			threadCounts.push_back(numThreads);
+		}
+		threadCounts.push_back(reporter.config().maxThreads);
+
+		Handle(Geom_BSplineSurface) reference;
+		double serialTime = 0.0;
+		for (int numThreads : threadCounts)
+		{
+			double best = 0.0;
+			Handle(Geom_BSplineSurface) surface;
+			for (int r = 0; r < 5; ++r)
+			{
+				SkinOptions options;
+				options.numThreads = numThreads;
+				Skin skin(bench::copyCurves(curves), 3, options);
+
+				auto start = Clock::now();
+				skin.skin();
+				double elapsed = elapsedMs(start);
+
+				best = r == 0 ? elapsed : std::min(best, elapsed);
+				surface = skin.getSurface();
+			}
+
+			if (numThreads == 1)
+			{
+				reference = surface;
+				serialTime = best;
+			}
+
+			reporter.add({ "skin.threadScaling", { { "sections", numSections }, { "poles", numPoles }, { "threads", numThreads } },
+				{ { "skin_ms", best }, { "speedup", serialTime / best }, { "identical", isIdentical(reference, surface) ? 1.0 : 0.0 } } });
+		}
+	}
+
+	// merge of the knots as Skin::refineKnots did it before, equal knots only
+	void legacyMergeKnots(const std::vector<TColStd_Array1OfReal>& knotVectors, const std::vector<TColStd_Array1OfInteger>& multVectors,
+		TColStd_Array1OfReal& knots, TColStd_Array1OfInteger& mults)
+	{
+		std::map<Standard_Real, Standard_Integer> knotMap;
+		for (size_t k = 0; k < knotVectors.size(); ++k)
+		{
+			for (Standard_Integer i = knotVectors[k].Lower(); i <= knotVectors[k].Upper(); ++i)
+			{
+				Standard_Real knot = knotVectors[k].Value(i);
+				Standard_Integer mult = multVectors[k].Value(i);
+				if (knotMap.find(knot) != knotMap.end())
+				{
+					knotMap[knot] = std::max(knotMap[knot], mult);
+				}
+				else
+				{
+					knotMap[knot] = mult;
+				}
+			}
+		}
+
+		knots.Resize(1, static_cast<int>(knotMap.size()), false);
+		mults.Resize(1, static_cast<int>(knotMap.size()), false);
+		Standard_Integer index = 1;
+		for (const auto& [knot, mult] : knotMap)
+		{
+			knots.SetValue(index, knot);
+			mults.SetValue(index, mult);
+			++index;
+		}
+	}
+
+	int numPoles(int degree, const TColStd_Array1OfInteger& mults)
+	{
+		int sum = 0;
+		for (int i = mults.Lower(); i <= mults.Upper(); ++i)
+		{
+			sum += mults.Value(i);
+		}
+		return sum - degree - 1;
+	}
+
+	// uniform interior knots moved by a few ulps as they come out of exporters, every tenth section has an extra knot
+	void makeJitteredKnots(int numSections, int numKnots, int degree, std::vector<TColStd_Array1OfReal>& knotVectors,
+		std::vector<TColStd_Array1OfInteger>& multVectors)
+	{
+		std::mt19937 generator(7);
+		std::uniform_int_distribution<int> ulps(-4, 4);
+
+		knotVectors.clear();
+		multVectors.clear();
+		for (int j = 0; j < numSections; ++j)
+		{
+			std::vector<double> values;
+			for (int i = 0; i < numKnots; ++i)
+			{
+				double knot = static_cast<double>(i) / (numKnots - 1);
+				if (i > 0 && i < numKnots - 1)
+				{
+					for (int step = ulps(generator); step != 0; step += step > 0 ? -1 : 1)
+					{
+						knot = std::nextafter(knot, step > 0 ? 2.0 : -1.0);
+					}
+				}
+				values.push_back(knot);
+			}
+			if (j % 10 == 0)
+			{
+				values.push_back((j / 10 % (numKnots - 1) + 0.5) / (numKnots - 1));
+				std::sort(values.begin(), values.end());
+			}
+
+			int size = static_cast<int>(values.size());
+			TColStd_Array1OfReal knots(1, size);
+			TColStd_Array1OfInteger mults(1, size);
+			for (int i = 0; i < size; ++i)
+			{
+				knots.SetValue(i + 1, values[i]);
+				mults.SetValue(i + 1, 1);
+			}
+			mults.SetValue(1, degree + 1);
+			mults.SetValue(size, degree + 1);
+			knotVectors.push_back(knots);
+			multVectors.push_back(mults);
+		}
+	}
+
+	// merge of jittered knot vectors, the legacy exact merge against the k-way merge with and without tolerance
+	void benchKnotMerge(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 1000, 10000 } : std::vector<int>{ 1000 };
+		int degree = 3;
+		int numKnots = 30;
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<TColStd_Array1OfReal> knotVectors;
+			std::vector<TColStd_Array1OfInteger> multVectors;
+			makeJitteredKnots(numSections, numKnots, degree, knotVectors, multVectors);
+
+			std::vector<const TColStd_Array1OfReal*> knotPointers;
+			std::vector<const TColStd_Array1OfInteger*> multPointers;
+			for (int j = 0; j < numSections; ++j)
+			{
+				knotPointers.push_back(&knotVectors[j]);
+				multPointers.push_back(&multVectors[j]);
+			}
+
+			std::vector<std::pair<std::string, double>> params = { { "sections", numSections }, { "knots", numKnots } };
+			TColStd_Array1OfReal knots(1, 1);
+			TColStd_Array1OfInteger mults(1, 1);
+
+			bench::Timing legacy = bench::measure([&]() { legacyMergeKnots(knotVectors, multVectors, knots, mults); });
+			reporter.add("skin.knotMerge.legacy", params, legacy, { { "merged_knots", knots.Length() }, { "poles", numPoles(degree, mults) } });
+
+			for (double tolerance : { 0.0, Precision::PConfusion() })
+			{
+				nurbs::KnotMergeReport report;
+				bench::Timing merge = bench::measure([&]() { nurbs::mergeKnots(knotPointers, multPointers, tolerance, knots, mults, report); });
+
+				std::vector<std::pair<std::string, double>> tolParams = params;
+				tolParams.push_back({ "tolerance", tolerance });
+				reporter.add("skin.knotMerge.kway", tolParams, merge, { { "merged_knots", report.numMergedKnots },
+					{ "snapped_knots", report.numSnappedKnots }, { "poles", numPoles(degree, mults) }, { "speedup", legacy.best / merge.best } });
+			}
+		}
+	}
+
+	// copy of a section moved by dy and dz, with an additional knot if requested
+	Handle(Geom_BSplineCurve) editedSection(const Handle(Geom_BSplineCurve)& curve, double dy, double dz, bool newKnot)
+	{
+		Handle(Geom_BSplineCurve) section = Handle(Geom_BSplineCurve)::DownCast(curve->Copy());
+		TColgp_Array1OfPnt poles = section->Poles();
+		for (int i = poles.Lower(); i <= poles.Upper(); ++i)
+		{
+			poles.ChangeValue(i).SetY(poles.Value(i).Y() + dy);
+			poles.ChangeValue(i).SetZ(poles.Value(i).Z() + dz);
+		}
+		section = new Geom_BSplineCurve(poles, section->Knots(), section->Multiplicities(), section->Degree());
+		if (newKnot)
+		{
+			TColStd_Array1OfReal knots(1, 1);
+			TColStd_Array1OfInteger mults(1, 1);
+			knots.SetValue(1, 0.5 * (section->Knot(1) + section->Knot(2)));
+			mults.SetValue(1, 1);
+			section->InsertKnots(knots, mults);
+		}
+		return section;
+	}
+
+	// latency of editing one section of a skinned surface against constructing it again
+	void benchIncremental(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		int numPoles = 64;
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+			int middle = numSections / 2;
+			Handle(Geom_BSplineCurve) moved = editedSection(curves[middle], 0.1, 0.0, false);
+			Handle(Geom_BSplineCurve) refined = editedSection(curves[middle], 0.0, -0.5, true);
+			std::vector<std::pair<std::string, double>> params = { { "sections", numSections }, { "poles", numPoles } };
+
+			bench::Timing rebuild = bench::measure([&]()
+			{
+				Skin skin(curves, 3);
+				skin.skin();
+			});
+			reporter.add("skin.incremental.rebuild", params, rebuild);
+
+			Skin skin(curves, 3);
+			skin.skin();
+
+			// same knots, only the edited section is made compatible
+			bench::Timing replace = bench::measure([&]() { skin.replaceSection(middle, moved); });
+			bench::Timing replaceSkin = bench::measure([&]()
+			{
+				skin.replaceSection(middle, moved);
+				skin.skin();
+			});
+			reporter.add("skin.incremental.replace", params, replace, { { "with_skin_ms", replaceSkin.best },
+				{ "speedup", rebuild.best / replaceSkin.best } });
+
+			// a new knot is inserted into every other section, removing the section takes it out again
+			double addBest = 0.0, removeBest = 0.0;
+			for (int r = 0; r < 3; ++r)
+			{
+				auto start = Clock::now();
+				skin.addSection(refined, middle);
+				skin.skin();
+				double addMs = elapsedMs(start);
+
+				start = Clock::now();
+				skin.removeSection(middle);
+				skin.skin();
+				double removeMs = elapsedMs(start);
+
+				addBest = r == 0 ? addMs : std::min(addBest, addMs);
+				removeBest = r == 0 ? removeMs : std::min(removeBest, removeMs);
+			}
+			reporter.add({ "skin.incremental.addRemove", params, { { "add_knot_ms", addBest }, { "remove_knot_ms", removeBest },
+				{ "rebuild_ms", rebuild.best } } });
+		}
+	}
+
+	// skinning without cache, with a cold cache storing the result and with a hit
+	void benchCache(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		int numPoles = 64;
+		std::filesystem::path directory = std::filesystem::temp_directory_path() / "skin_bench_cache";
+
+		for (int numSections : sectionCounts)
+		{
+			for (bool mixed : { false, true })
+			{
+				// mixed sections alternate degrees and knot vectors, so the compatibility does real work
+				std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+				if (mixed)
+				{
+					std::vector<Handle(Geom_BSplineCurve)> others = bench::makeSections(numSections, numPoles - 1, 2);
+					for (int j = 1; j < numSections; j += 2)
+					{
+						curves[j] = others[j];
+					}
+				}
+				std::vector<std::pair<std::string, double>> params = { { "sections", numSections }, { "poles", numPoles },
+					{ "mixed", mixed ? 1.0 : 0.0 } };
+
+				bench::Timing plain = bench::measure([&]()
+				{
+					Skin skin(curves, 3);
+					skin.skin();
+				});
+
+				SkinOptions options;
+				bench::Timing miss = bench::measure([&]()
+				{
+					std::filesystem::remove_all(directory);
+					options.cache = std::make_shared<util::SkinCache>(directory.string());
+					Skin skin(curves, 3, options);
+					skin.skin();
+				});
+
+				bool hit = true;
+				bench::Timing load = bench::measure([&]()
+				{
+					Skin skin(curves, 3, options);
+					skin.skin();
+					hit = hit && skin.isCacheHit();
+				});
+
+				reporter.add("skin.cache", params, load, { { "uncached_ms", plain.best }, { "miss_ms", miss.best },
+					{ "speedup", plain.best / load.best }, { "all_hits", hit ? 1.0 : 0.0 } });
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+	}
+
+	// interpolation against least-squares fits at v direction, with the cost of writing the surface downstream
+	void benchApproximation(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 1000, 10000 } : std::vector<int>{ 1000 };
+		int numPoles = 64;
+		std::filesystem::path output = std::filesystem::temp_directory_path() / "skin_bench_approximation.stp";
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+
+			struct Mode
+			{
+				std::string name;
+				int poles;
+				double tolerance;
+			};
+			std::vector<Mode> modes = { { "interpolation", 0, 0.0 }, { "poles", numSections / 4, 0.0 },
+				{ "poles", numSections / 10, 0.0 }, { "tolerance", 0, 1e-3 }, { "tolerance", 0, 1e-2 } };
+
+			for (const Mode& mode : modes)
+			{
+				SkinOptions options;
+				options.approximationPoles = mode.poles;
+				options.approximationTolerance = mode.tolerance;
+
+				Handle(Geom_BSplineSurface) surface;
+				double deviation = 0.0;
+				bench::Timing timing = bench::measure([&]()
+				{
+					Skin skin(curves, 3, options);
+					skin.skin();
+					surface = skin.getSurface();
+					deviation = skin.getMaxDeviation();
+				}, 1);
+				if (surface.IsNull())
+				{
+					continue;
+				}
+
+				batch::Job job;
+				job.output = output.string();
+				std::string error;
+				auto start = Clock::now();
+				bool written = batch::writeSurface(job, surface, error);
+				double writeMs = elapsedMs(start);
+				std::error_code sizeError;
+				double fileKb = written ? std::filesystem::file_size(output, sizeError) / 1024.0 : 0.0;
+
+				reporter.add("skin.approximation." + mode.name, { { "sections", numSections }, { "poles", numPoles },
+					{ "target_poles", mode.poles }, { "tolerance", mode.tolerance } }, timing,
+					{ { "poles_v", surface->NbVPoles() }, { "max_deviation", deviation }, { "write_ms", writeMs }, { "file_kb", fileKb } });
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::remove(output, error);
+	}
+
+	// knot removal after skinning sections whose knot vectors differ, so the merged knots are more than the shape needs
+	void benchKnotRemoval(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000 } : std::vector<int>{ 100 };
+		int numPoles = 64;
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+			std::vector<Handle(Geom_BSplineCurve)> others = bench::makeSections(numSections, numPoles - 5, 3);
+			for (int j = 1; j < numSections; j += 2)
+			{
+				curves[j] = others[j];
+			}
+
+			bench::Timing plain = bench::measure([&]()
+			{
+				Skin skin(curves, 3);
+				skin.skin();
+			}, 1);
+
+			for (double tolerance : { 1e-6, 1e-4, 1e-2 })
+			{
+				for (int numThreads : { 1, reporter.config().maxThreads })
+				{
+					SkinOptions options;
+					options.knotRemovalTolerance = tolerance;
+					options.numThreads = numThreads;
+
+					KnotRemovalReport report;
+					bench::Timing timing = bench::measure([&]()
+					{
+						Skin skin(curves, 3, options);
+						skin.skin();
+						report = skin.getKnotRemovalReport();
+					}, 1);
+
+					reporter.add("skin.knotRemoval", { { "sections", numSections }, { "poles", numPoles }, { "tolerance", tolerance },
+						{ "threads", numThreads } }, timing, { { "without_removal_ms", plain.best },
+						{ "poles_u_before", report.numPolesUBefore }, { "poles_u", report.numPolesU },
+						{ "poles_v_before", report.numPolesVBefore }, { "poles_v", report.numPolesV }, { "max_deviation", report.maxDeviation } });
+
+					if (numThreads == reporter.config().maxThreads)
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// the compatibility stage as it was done before: every section is copied and mutated by OCC curve by curve
+	void legacyCompatibilize(const std::vector<Handle(Geom_BSplineCurve)>& curves, double tolerance)
+	{
+		std::vector<Handle(Geom_BSplineCurve)> sections = bench::copyCurves(curves);
+		int maxDegree = 0;
+		for (const auto& section : sections)
+		{
+			maxDegree = std::max(maxDegree, section->Degree());
+		}
+		for (const auto& section : sections)
+		{
+			section->IncreaseDegree(maxDegree);
+		}
+
+		std::vector<const TColStd_Array1OfReal*> knots;
+		std::vector<const TColStd_Array1OfInteger*> mults;
+		for (const auto& section : sections)
+		{
+			knots.push_back(&section->Knots());
+			mults.push_back(&section->Multiplicities());
+		}
+		TColStd_Array1OfReal mergedKnots(1, 1);
+		TColStd_Array1OfInteger mergedMults(1, 1);
+		nurbs::KnotMergeReport report;
+		nurbs::mergeKnots(knots, mults, tolerance, mergedKnots, mergedMults, report);
+
+		for (const auto& section : sections)
+		{
+			section->InsertKnots(mergedKnots, mergedMults, tolerance, Standard_False);
+		}
+	}
+
+	// compatibility of sections of degrees 1 to 5, whose knot vectors differ with the degree
+	void benchCompatibility(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		int numPoles = 32;
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<std::vector<Handle(Geom_BSplineCurve)>> families;
+			for (int degree = 1; degree <= 5; ++degree)
+			{
+				families.push_back(bench::makeSections(numSections, numPoles, degree));
+			}
+			std::vector<Handle(Geom_BSplineCurve)> curves;
+			for (int j = 0; j < numSections; ++j)
+			{
+				curves.push_back(families[j % 5][j]);
+			}
+
+			long long allocations = bench::allocationCount();
+			bench::Timing legacy = bench::measure([&]() { legacyCompatibilize(curves, Precision::PConfusion()); }, 1);
+			double legacyAllocations = static_cast<double>(bench::allocationCount() - allocations) / legacy.repeats;
+
+			for (int numThreads : { 1, reporter.config().maxThreads })
+			{
+				SkinOptions options;
+				options.numThreads = numThreads;
+				int mergedKnots = 0;
+
+				allocations = bench::allocationCount();
+				bench::Timing timing = bench::measure([&]()
+				{
+					Skin skin(curves, 3, options);
+					mergedKnots = skin.getKnotMergeReport().numMergedKnots;
+				}, 1);
+				double batchedAllocations = static_cast<double>(bench::allocationCount() - allocations) / timing.repeats;
+
+				// operator new allocations only, the OCCT arrays of both paths go through Standard::Allocate
+				reporter.add("skin.compatibility", { { "sections", numSections }, { "poles", numPoles }, { "threads", numThreads } }, timing,
+					{ { "per_curve_ms", legacy.best }, { "speedup", legacy.best / timing.best }, { "merged_knots", mergedKnots },
+					{ "allocations", batchedAllocations }, { "per_curve_allocations", legacyAllocations } });
+
+				if (numThreads == reporter.config().maxThreads)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	// cost of collecting the metrics, with the phase breakdown of sections of degrees 1 to 5
+	void benchMetrics(bench::Reporter& reporter)
+	{
+		std::vector<int> sectionCounts = reporter.config().full ? std::vector<int>{ 100, 1000, 10000 } : std::vector<int>{ 100, 1000 };
+		int numPoles = 64;
+
+		for (int numSections : sectionCounts)
+		{
+			std::vector<std::vector<Handle(Geom_BSplineCurve)>> families;
+			for (int degree = 1; degree <= 5; ++degree)
+			{
+				families.push_back(bench::makeSections(numSections, numPoles, degree));
+			}
+			std::vector<Handle(Geom_BSplineCurve)> curves;
+			for (int j = 0; j < numSections; ++j)
+			{
+				curves.push_back(families[j % 5][j]);
+			}
+
+			SkinOptions options;
+			bench::Timing disabled = bench::measure([&]()
+			{
+				Skin skin(curves, 3, options);
+				skin.skin();
+			});
+
+			options.collectMetrics = true;
+			SkinMetrics metrics;
+			bench::Timing enabled = bench::measure([&]()
+			{
+				Skin skin(curves, 3, options);
+				skin.skin();
+				metrics = skin.getMetrics();
+			});
+
+			reporter.add("skin.metrics", { { "sections", numSections }, { "poles", numPoles } }, enabled,
+				{ { "disabled_ms", disabled.best }, { "overhead", enabled.best / disabled.best - 1.0 },
+				{ "merge_knots_ms", metrics.mergeKnotsMs }, { "compatible_ms", metrics.compatibleMs },
+				{ "control_net_ms", metrics.controlNetMs }, { "parameterization_ms", metrics.parameterizationMs },
+				{ "solve_ms", metrics.solveMs }, { "surface_ms", metrics.surfaceMs }, { "inserted_knots", static_cast<double>(metrics.numInsertedKnots) },
+				{ "degree_elevation", metrics.degreeElevation }, { "poles_u", metrics.numPolesU }, { "poles_v", metrics.numPolesV } });
+		}
+	}
+
+	// peak memory of one skin() keeping the sections for edits and solving them in place, against the size of the net
+	void benchMemory(bench::Reporter& reporter)
+	{
+		int numSections = reporter.config().full ? 4000 : 1000;
+		int numPoles = 512;
+		std::vector<Handle(Geom_BSplineCurve)> curves = bench::makeSections(numSections, numPoles, 3);
+		double netMB = 3.0 * sizeof(double) * numSections * numPoles / (1024.0 * 1024.0);
+
+		std::vector<double> peaks;
+		for (bool keepSections : { true, false })
+		{
+			SkinOptions options;
+			options.keepSections = keepSections;
+			bool reset = bench::resetPeakMemory();
+			double start = bench::residentMemoryMB();
+			{
+				Skin skin(curves, 3, options);
+				skin.skin();
+			}
+			peaks.push_back(reset ? bench::peakMemoryMB() - start : NAN);
+		}
+
+		reporter.add({ "skin.memory", { { "sections", numSections }, { "poles", numPoles } },
+			{ { "net_mb", netMB }, { "keep_peak_mb", peaks[0] }, { "in_place_peak_mb", peaks[1] },
+			{ "keep_nets", peaks[0] / netMB }, { "in_place_nets", peaks[1] / netMB } } });
+	}
+
+	// many independent lofts of uneven sizes, skinned one after the other and by batch::skinAll
+	void benchBatch(bench::Reporter& reporter)
+	{
+		int numSets = reporter.config().full ? 512 : 128;
+		std::mt19937 random(7);
+		std::uniform_int_distribution<int> sectionCount(8, 64);
+		std::uniform_int_distribution<int> poleCount(16, 128);
+
+		// one set in sixteen is ten times larger than the others
+		std::vector<batch::SectionSet> sets(numSets);
+		long long totalPoles = 0;
+		for (int i = 0; i < numSets; ++i)
+		{
+			int scale = i % 16 == 0 ? 10 : 1;
+			int numSections = sectionCount(random);
+			int numPoles = poleCount(random) * scale;
+			sets[i].sections = bench::makeSections(numSections, numPoles, 3);
+			sets[i].degreeV = 3;
+			totalPoles += static_cast<long long>(numSections) * numPoles;
+		}
+
+		std::vector<Handle(Geom_BSplineSurface)> reference(numSets);
+		bench::Timing serial = bench::measure([&]()
+		{
+			for (int i = 0; i < numSets; ++i)
+			{
+				Skin skin(sets[i].sections, sets[i].degreeV);
+				skin.skin();
+				reference[i] = skin.getSurface();
+			}
+		}, 1);
+		reporter.add("skin.batch.serial", { { "sets", numSets }, { "poles", static_cast<double>(totalPoles) }, { "threads", 1 } }, serial,
+			{ { "sets_per_s", numSets * 1000.0 / serial.best } });
+
+		// 1, 2, 4, ... and maxThreads
+		std::vector<int> threadCounts;
+		for (int numThreads = 1; numThreads < reporter.config().maxThreads; numThreads *= 2)
+		{
+			threadCounts.push_back(numThreads);
+		}
+		threadCounts.push_back(reporter.config().maxThreads);
+
+		for (int numThreads : threadCounts)
+		{
+			SkinOptions options;
+			options.pool = std::make_shared<util::ThreadPool>(numThreads);
+			std::vector<batch::SkinResult> results;
+			bench::Timing timing = bench::measure([&]()
+			{
+				results = batch::skinAll(sets, options);
+			}, 1);
+
+			bool identical = true;
+			int numFailed = 0;
+			for (int i = 0; i < numSets; ++i)
+			{
+				numFailed += results[i].success ? 0 : 1;
+				identical = identical && isIdentical(reference[i], results[i].surface);
+			}
+
+			reporter.add("skin.batch.skinAll", { { "sets", numSets }, { "poles", static_cast<double>(totalPoles) }, { "threads", numThreads } }, timing,
+				{ { "sets_per_s", numSets * 1000.0 / timing.best }, { "speedup", serial.best / timing.best },
+				{ "failed", numFailed }, { "identical", identical ? 1.0 : 0.0 } });
+		}
+	}
+}
+
+std::vector<bench::Group> bench::skinBenchmarks()
+{
+	return {
+		{ "skin.synthetic", benchSyntheticFamilies },
+		{ "skin.curves1", benchShippedModel },
+		{ "skin.threadScaling", benchThreadScaling },
+		{ "skin.knotMerge", benchKnotMerge },
+		{ "skin.incremental", benchIncremental },
+		{ "skin.cache", benchCache },
+		{ "skin.approximation", benchApproximation },
+		{ "skin.knotRemoval", benchKnotRemoval },
+		{ "skin.compatibility", benchCompatibility },
+		{ "skin.metrics", benchMetrics },
+		{ "skin.batch", benchBatch },
+		{ "skin.memory", benchMemory },
+	};
+}
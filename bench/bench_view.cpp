@@ -0,0 +1,141 @@
+#include "benchmark.h"
+#include "display.h"
+#include "meshcache.h"
+
+#include <chrono>
+#include <thread>
+#include <Aspect_DisplayConnection.hxx>
+#include <OpenGl_GraphicDriver.hxx>
+#include <V3d_Viewer.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <Precision.hxx>
+#include <Standard_Failure.hxx>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// AIS context without any view, presentations are computed on Display and never drawn
+	Handle(AIS_InteractiveContext) makeContext()
+	{
+		Handle(Aspect_DisplayConnection) displayConnection = new Aspect_DisplayConnection();
+		Handle(OpenGl_GraphicDriver) driver = new OpenGl_GraphicDriver(displayConnection, false);
+		Handle(V3d_Viewer) viewer = new V3d_Viewer(driver);
+		return new AIS_InteractiveContext(viewer);
+	}
+
+	// distinct faces on translated copies of one skinned surface, so none shares the mesh of another
+	std::vector<TopoDS_Shape> makeFaces(int count)
+	{
+		Skin skin(bench::makeSections(8, 16, 3), 3);
+		skin.skin();
+		Handle(Geom_BSplineSurface) surface = skin.getSurface();
+
+		std::vector<TopoDS_Shape> faces;
+		for (int k = 0; k < count; ++k)
+		{
+			Handle(Geom_BSplineSurface) copy = Handle(Geom_BSplineSurface)::DownCast(surface->Translated(gp_Vec(20.0 * (k % 100), 20.0 * (k / 100), 0.0)));
+			faces.emplace_back(BRepBuilderAPI_MakeFace(copy, Precision::Confusion()).Face());
+		}
+		return faces;
+	}
+
+	// latency of adding one face to a scene, displayed incrementally and rebuilt as Viewer::updateView did before
+	void benchDisplay(bench::Reporter& reporter)
+	{
+		Handle(AIS_InteractiveContext) context;
+		try
+		{
+			context = makeContext();
+		}
+		catch (Standard_Failure& failure)
+		{
+			std::cerr << "view.display skipped: " << failure.GetMessageString() << std::endl;
+			return;
+		}
+
+		int numShapes = reporter.config().full ? 10000 : 2000;
+		const int window = 100;	// adds averaged at the start and at the end
+		std::vector<TopoDS_Shape> faces = makeFaces(numShapes);
+
+		// incremental, one sync per added face
+		util::DisplayList displayList(context);
+		std::vector<TopoDS_Shape> shapes;
+		double firstMs = 0.0, lastMs = 0.0;
+		for (int k = 0; k < numShapes; ++k)
+		{
+			shapes.push_back(faces[k]);
+			auto start = Clock::now();
+			displayList.sync(shapes);
+			double elapsed = elapsedMs(start);
+			firstMs += k < window ? elapsed / window : 0.0;
+			lastMs += k >= numShapes - window ? elapsed / window : 0.0;
+		}
+		displayList.clear();
+
+		// rebuild, every presentation made again for one added face, timed on the last adds only
+		std::vector<TopoDS_Shape> rebuildFaces = makeFaces(numShapes);
+		int numRebuilds = 3;
+		double rebuildMs = 0.0;
+		for (int r = 0; r < numRebuilds; ++r)
+		{
+			auto start = Clock::now();
+			context->RemoveAll(Standard_False);
+			for (int k = 0; k < numShapes - numRebuilds + r + 1; ++k)
+			{
+				Handle(AIS_Shape) shape = new AIS_Shape(rebuildFaces[k]);
+				context->SetDisplayMode(shape, AIS_Shaded, Standard_False);
+				context->Display(shape, Standard_False);
+			}
+			rebuildMs += elapsedMs(start) / numRebuilds;
+		}
+		context->RemoveAll(Standard_False);
+
+		reporter.add({ "view.display", { { "shapes", numShapes } },
+			{ { "first_add_ms", firstMs }, { "last_add_ms", lastMs }, { "growth", lastMs / firstMs },
+			{ "rebuild_add_ms", rebuildMs }, { "speedup", rebuildMs / lastMs } } });
+	}
+
+	// meshing of many faces before display on one thread and on all cores, then found in the cache
+	void benchMesh(bench::Reporter& reporter)
+	{
+		int numShapes = reporter.config().full ? 2000 : 500;
+
+		util::MeshOptions options;
+		options.parallel = false;
+		util::MeshCache serialCache(options);
+		std::vector<TopoDS_Shape> serialFaces = makeFaces(numShapes);
+		auto start = Clock::now();
+		serialCache.mesh(serialFaces);
+		double serialMs = elapsedMs(start);
+
+		options.parallel = true;
+		util::MeshCache cache(options);
+		std::vector<TopoDS_Shape> faces = makeFaces(numShapes);
+		start = Clock::now();
+		cache.mesh(faces);
+		double parallelMs = elapsedMs(start);
+
+		// a redisplay of the same shapes, nothing is meshed
+		start = Clock::now();
+		int remeshed = cache.mesh(faces);
+		double cachedMs = elapsedMs(start);
+
+		reporter.add({ "view.mesh", { { "shapes", numShapes }, { "threads", static_cast<int>(std::thread::hardware_concurrency()) } },
+			{ { "serial_ms", serialMs }, { "parallel_ms", parallelMs }, { "speedup", serialMs / parallelMs },
+			{ "cached_ms", cachedMs }, { "remeshed", remeshed }, { "cache_mb", cache.memoryBytes() / (1024.0 * 1024.0) } } });
+	}
+}
+
+std::vector<bench::Group> bench::viewBenchmarks()
+{
+	return {
+		{ "view.display", benchDisplay },
+		{ "view.mesh", benchMesh },
+	};
+}
@@ -0,0 +1,270 @@
+#include "benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <string>
+
+namespace
+{
+	std::atomic<long long> allocations{ 0 };
+
+	// field of /proc/self/status in megabytes, such as "VmRSS"
+	double processStatusMB(const std::string& field)
+	{
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, field.size() + 1, field + ":") == 0)
+			{
+				return std::stod(line.substr(field.size() + 1)) / 1024.0;
+			}
+		}
+		return NAN;
+	}
+}
+
+// count every heap allocation of the benchmark executable
+void* operator new(std::size_t size)
+{
+	++allocations;
+	if (void* pointer = std::malloc(size == 0 ? 1 : size))
+	{
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+// the aligned planes of nurbs::ControlNet come through these
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	++allocations;
+	std::size_t bytes = static_cast<std::size_t>(alignment);
+	std::size_t rounded = (size + bytes - 1) / bytes * bytes;
+#ifdef _WIN32
+	void* pointer = _aligned_malloc(rounded == 0 ? bytes : rounded, bytes);
+#else
+	void* pointer = std::aligned_alloc(bytes, rounded == 0 ? bytes : rounded);
+#endif
+	if (pointer)
+	{
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+long long bench::allocationCount()
+{
+	return allocations.load();
+}
+
+double bench::residentMemoryMB()
+{
+	return processStatusMB("VmRSS");
+}
+
+double bench::peakMemoryMB()
+{
+	return processStatusMB("VmHWM");
+}
+
+bool bench::resetPeakMemory()
+{
+#ifdef __linux__
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+	return static_cast<bool>(clearRefs.flush());
+#else
+	return false;
+#endif
+}
+
+bench::Timing bench::measure(const std::function<void()>& func, int minRepeats, double minSeconds)
+{
+	using Clock = std::chrono::steady_clock;
+
+	Timing timing;
+	double total = 0.0;
+	auto begin = Clock::now();
+	while (timing.repeats < minRepeats || std::chrono::duration<double>(Clock::now() - begin).count() < minSeconds)
+	{
+		auto start = Clock::now();
+		func();
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		timing.best = timing.repeats == 0 ? elapsed : std::min(timing.best, elapsed);
+		total += elapsed;
+		++timing.repeats;
+	}
+	timing.mean = total / timing.repeats;
+
+	return timing;
+}
+
+bench::Reporter::Reporter(const Config& config)
+	: m_config{ config }
+{
+}
+
+const bench::Config& bench::Reporter::config() const
+{
+	return m_config;
+}
+
+void bench::Reporter::add(const Record& record)
+{
+	std::ostream& stream = m_config.linesToStderr ? std::cerr : std::cout;
+	stream << std::left << std::setw(36) << record.name << std::right;
+	for (const auto& [key, value] : record.params)
+	{
+		stream << " " << key << "=" << value;
+	}
+	stream << " |";
+	for (const auto& [key, value] : record.values)
+	{
+		stream << " " << key << "=" << value;
+	}
+	stream << std::endl;
+
+	m_records.push_back(record);
+}
+
+void bench::Reporter::add(const std::string& name, const std::vector<std::pair<std::string, double>>& params, const Timing& timing,
+	const std::vector<std::pair<std::string, double>>& values)
+{
+	Record record{ name, params, { { "best_ms", timing.best }, { "mean_ms", timing.mean }, { "repeats", timing.repeats } } };
+	record.values.insert(record.values.end(), values.begin(), values.end());
+	add(record);
+}
+
+void bench::Reporter::writeJson(std::ostream& stream) const
+{
+	auto writeObject = [&stream](const std::vector<std::pair<std::string, double>>& entries)
+	{
+		stream << "{";
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			stream << (i == 0 ? "" : ", ") << "\"" << entries[i].first << "\": ";
+			if (std::isfinite(entries[i].second))
+			{
+				stream << std::setprecision(9) << entries[i].second;
+			}
+			else
+			{
+				stream << "null";
+			}
+		}
+		stream << "}";
+	};
+
+	stream << "{\n  \"suite\": \"skin_bench\",\n  \"full\": " << (m_config.full ? "true" : "false")
+		<< ",\n  \"max_threads\": " << m_config.maxThreads << ",\n  \"results\": [\n";
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		stream << "    {\"name\": \"" << m_records[i].name << "\", \"params\": ";
+		writeObject(m_records[i].params);
+		stream << ", \"values\": ";
+		writeObject(m_records[i].values);
+		stream << "}" << (i + 1 < m_records.size() ? "," : "") << "\n";
+	}
+	stream << "  ]\n}\n";
+}
+
+std::vector<Handle(Geom_BSplineCurve)> bench::makeSections(int numSections, int numPoles, int degree)
+{
+	int numKnots = numPoles - degree + 1;
+	TColStd_Array1OfReal knots(1, numKnots);
+	TColStd_Array1OfInteger mults(1, numKnots);
+	for (int i = 1; i <= numKnots; ++i)
+	{
+		knots.SetValue(i, static_cast<double>(i - 1) / (numKnots - 1));
+		mults.SetValue(i, 1);
+	}
+	mults.SetValue(1, degree + 1);
+	mults.SetValue(numKnots, degree + 1);
+
+	std::vector<Handle(Geom_BSplineCurve)> curves;
+	for (int j = 0; j < numSections; ++j)
+	{
+		TColgp_Array1OfPnt poles(1, numPoles);
+		for (int i = 1; i <= numPoles; ++i)
+		{
+			double x = static_cast<double>(i - 1) / (numPoles - 1) * 10.0;
+			double y = std::sin(0.7 * x + 0.3 * j) * (1.0 + 0.1 * std::sin(0.05 * j));
+			poles.SetValue(i, gp_Pnt(x, y, static_cast<double>(j)));
+		}
+		curves.emplace_back(new Geom_BSplineCurve(poles, knots, mults, degree));
+	}
+
+	return curves;
+}
+
+std::vector<Handle(Geom_BSplineCurve)> bench::copyCurves(const std::vector<Handle(Geom_BSplineCurve)>& curves)
+{
+	std::vector<Handle(Geom_BSplineCurve)> copies;
+	copies.reserve(curves.size());
+	for (const auto& curve : curves)
+	{
+		copies.emplace_back(Handle(Geom_BSplineCurve)::DownCast(curve->Copy()));
+	}
+	return copies;
+}
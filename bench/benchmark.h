@@ -0,0 +1,90 @@
+#pragma once
+
+#include "skin.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace bench
+{
+	// Sizes swept by the benchmarks
+	struct Config
+	{
+		bool full = false;	// sweep up to 10k sections instead of the quick set
+		std::string filter;	// run only the benchmarks whose name contains the filter
+		std::string dataDir;	// directory of the shipped models
+		int maxThreads = 1;	// largest number of threads of scaling benchmarks
+		bool linesToStderr = false;	// print the records on stderr, when stdout receives the JSON document
+	};
+
+	// One measured case, written as one JSON object
+	struct Record
+	{
+		std::string name;
+		std::vector<std::pair<std::string, double>> params;	// size of the case
+		std::vector<std::pair<std::string, double>> values;	// measurements, times in milliseconds
+	};
+
+	// Timing of repeated calls
+	struct Timing
+	{
+		double best = 0.0;	// fastest call in milliseconds
+		double mean = 0.0;	// average call in milliseconds
+		int repeats = 0;
+	};
+
+	// number of heap allocations made through operator new, aligned ones included, since the start of the program,
+	// the arrays of OCCT allocated by Standard::Allocate are not counted
+	long long allocationCount();
+
+	// resident memory of the process in megabytes, and its peak since the last resetPeakMemory, NaN where unknown
+	double residentMemoryMB();
+	double peakMemoryMB();
+
+	// restart the peak of resident memory from the current size, false where the platform cannot (only Linux can)
+	bool resetPeakMemory();
+
+	// call func at least minRepeats times and until minSeconds have passed
+	Timing measure(const std::function<void()>& func, int minRepeats = 3, double minSeconds = 0.2);
+
+	// Collects records and prints them
+	class Reporter
+	{
+	public:
+		explicit Reporter(const Config& config);
+
+		const Config& config() const;
+
+		// print a record as one line and keep it for the JSON report
+		void add(const Record& record);
+
+		// add a record holding the timing and extra values
+		void add(const std::string& name, const std::vector<std::pair<std::string, double>>& params, const Timing& timing,
+			const std::vector<std::pair<std::string, double>>& values = {});
+
+		void writeJson(std::ostream& stream) const;
+
+	private:
+		const Config& m_config;
+		std::vector<Record> m_records;
+	};
+
+	// Benchmarks grouped by file, each group is run when its name matches the filter
+	struct Group
+	{
+		std::string name;
+		std::function<void(Reporter&)> run;
+	};
+
+	std::vector<Group> nurbsBenchmarks();
+	std::vector<Group> skinBenchmarks();
+	std::vector<Group> ioBenchmarks();
+	std::vector<Group> viewBenchmarks();
+
+	// section curves of a wavy surface, the j-th curve lies in the plane z = j
+	std::vector<Handle(Geom_BSplineCurve)> makeSections(int numSections, int numPoles, int degree);
+
+	// deep copies of the curves
+	std::vector<Handle(Geom_BSplineCurve)> copyCurves(const std::vector<Handle(Geom_BSplineCurve)>& curves);
+};
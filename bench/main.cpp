@@ -0,0 +1,129 @@
+#include "benchmark.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifndef SKIN_DATA_DIR
+#define SKIN_DATA_DIR "data"
+#endif
+
+namespace
+{
+	// the whole text as a number, std::invalid_argument or std::out_of_range otherwise
+	int toInt(const std::string& text)
+	{
+		size_t end = 0;
+		int value = std::stoi(text, &end);
+		if (end != text.size())
+		{
+			throw std::invalid_argument(text);
+		}
+		return value;
+	}
+
+	void printUsage()
+	{
+		std::cout << "usage: skin_bench [--full] [--filter NAME] [--json FILE] [--threads N] [--data DIR]" << std::endl
+			<< "  --full        sweep up to 10k sections instead of the quick set" << std::endl
+			<< "  --filter S    run only the benchmarks whose name contains S" << std::endl
+			<< "  --json F      write the results as JSON to F, \"-\" writes to stdout and the lines to stderr" << std::endl
+			<< "  --threads N   largest thread count of scaling benchmarks (default all cores)" << std::endl
+			<< "  --data D      directory of the shipped models" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bench::Config config;
+	config.dataDir = SKIN_DATA_DIR;
+	config.maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	std::string jsonName;
+
+#ifdef __GLIBC__
+	// blocks of 1 MB and more go back to the system when freed, so the peaks of resident memory count live data only
+	mallopt(M_MMAP_THRESHOLD, 1 << 20);
+#endif
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--full")
+		{
+			config.full = true;
+		}
+		else if (arg == "--filter" && i + 1 < argc)
+		{
+			config.filter = argv[++i];
+		}
+		else if (arg == "--json" && i + 1 < argc)
+		{
+			jsonName = argv[++i];
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			try
+			{
+				config.maxThreads = std::max(1, toInt(argv[++i]));
+			}
+			catch (const std::exception&)
+			{
+				std::cerr << "invalid value " << argv[i] << " of --threads" << std::endl;
+				printUsage();
+				return 2;
+			}
+		}
+		else if (arg == "--data" && i + 1 < argc)
+		{
+			config.dataDir = argv[++i];
+		}
+		else
+		{
+			printUsage();
+			return arg == "-h" || arg == "--help" ? 0 : 2;
+		}
+	}
+
+	// stdout holds nothing but the JSON document
+	config.linesToStderr = jsonName == "-";
+
+	std::vector<bench::Group> groups = bench::nurbsBenchmarks();
+	for (auto& group : bench::skinBenchmarks())
+	{
+		groups.push_back(group);
+	}
+	for (auto& group : bench::ioBenchmarks())
+	{
+		groups.push_back(group);
+	}
+	for (auto& group : bench::viewBenchmarks())
+	{
+		groups.push_back(group);
+	}
+
+	bench::Reporter reporter(config);
+	for (const auto& group : groups)
+	{
+		if (group.name.find(config.filter) != std::string::npos)
+		{
+			group.run(reporter);
+		}
+	}
+
+	if (jsonName == "-")
+	{
+		reporter.writeJson(std::cout);
+	}
+	else if (!jsonName.empty())
+	{
+		std::ofstream json(jsonName);
+		reporter.writeJson(json);
+	}
+
+	return 0;
+}
@@ -0,0 +1,390 @@
+#include "batch.h"
+#include "stepwriter.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// the whole text as a number, std::invalid_argument or std::out_of_range otherwise
+	int toInt(const std::string& text)
+	{
+		size_t end = 0;
+		int value = std::stoi(text, &end);
+		if (end != text.size())
+		{
+			throw std::invalid_argument(text);
+		}
+		return value;
+	}
+
+	double toDouble(const std::string& text)
+	{
+		size_t end = 0;
+		double value = std::stod(text, &end);
+		if (end != text.size())
+		{
+			throw std::invalid_argument(text);
+		}
+		return value;
+	}
+
+	// quoted CSV field, the quotes inside are doubled
+	std::string csvField(const std::string& text)
+	{
+		std::string field = "\"";
+		for (char c : text)
+		{
+			if (c == '"')
+			{
+				field += '"';
+			}
+			field += c;
+		}
+		return field + "\"";
+	}
+
+	void printUsage()
+	{
+		std::cout << "usage: skin_cli [--threads N] [--report file.csv] [--cache dir] [--cache-size MB] [--export file.step] [--shard-size MB]"
+			" [--metrics file.json] [--trace file.json] [--pipeline] [--queue-depth N] [--skin-workers N] manifest..." << std::endl
+			<< "  each manifest line is: <input> <selection> <degreeV> <output>" << std::endl
+			<< "  --threads N   threads reading STEP and IGES files and solving the columns of each job, 0 uses all cores (default 1)" << std::endl
+			<< "  --report F    write per-job timings to the CSV file F" << std::endl
+			<< "  --cache D     reuse the surfaces skinned before from the directory D" << std::endl
+			<< "  --cache-size M  bound the cache directory to M megabytes (default 1024)" << std::endl
+			<< "  --export F    also stream every skinned surface into the STEP file F as the jobs finish" << std::endl
+			<< "  --shard-size M  split the export into files of about M megabytes named F_1, F_2, ..." << std::endl
+			<< "  --metrics F   write the phase durations and counters of every skinning as JSON to F" << std::endl
+			<< "  --trace F     record a Chrome trace of reading, skinning and writing into F, SKIN_TRACE=F does the same" << std::endl
+			<< "  --pipeline    read, skin and write the jobs concurrently in three stages, the jobs may finish out of order" << std::endl
+			<< "  --queue-depth N  jobs waiting between two stages of the pipeline (default 4)" << std::endl
+			<< "  --skin-workers N  threads of the skin stage of the pipeline (default 1)" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	SkinOptions options;
+	std::string reportName;
+	std::string cacheDirectory;
+	double cacheMegabytes = 1024.0;
+	std::string exportName;
+	double shardMegabytes = 0.0;
+	std::string metricsName;
+	std::string traceName;
+	bool pipeline = false;
+	int queueDepth = 4;
+	int skinWorkers = 1;
+	std::vector<std::string> manifests;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		try
+		{
+			if (arg == "--threads" && i + 1 < argc)
+			{
+				options.numThreads = toInt(argv[++i]);
+			}
+			else if (arg == "--report" && i + 1 < argc)
+			{
+				reportName = argv[++i];
+			}
+			else if (arg == "--cache" && i + 1 < argc)
+			{
+				cacheDirectory = argv[++i];
+			}
+			else if (arg == "--cache-size" && i + 1 < argc)
+			{
+				cacheMegabytes = toDouble(argv[++i]);
+			}
+			else if (arg == "--export" && i + 1 < argc)
+			{
+				exportName = argv[++i];
+			}
+			else if (arg == "--shard-size" && i + 1 < argc)
+			{
+				shardMegabytes = toDouble(argv[++i]);
+			}
+			else if (arg == "--metrics" && i + 1 < argc)
+			{
+				metricsName = argv[++i];
+			}
+			else if (arg == "--trace" && i + 1 < argc)
+			{
+				traceName = argv[++i];
+			}
+			else if (arg == "--pipeline")
+			{
+				pipeline = true;
+			}
+			else if (arg == "--queue-depth" && i + 1 < argc)
+			{
+				queueDepth = toInt(argv[++i]);
+			}
+			else if (arg == "--skin-workers" && i + 1 < argc)
+			{
+				skinWorkers = toInt(argv[++i]);
+			}
+			else if (arg == "-h" || arg == "--help")
+			{
+				printUsage();
+				return 0;
+			}
+			else if (arg.compare(0, 2, "--") == 0)
+			{
+				// a misspelled flag, or a flag missing its value, would be read as a manifest otherwise
+				static const std::vector<std::string> valueFlags = { "--threads", "--report", "--cache", "--cache-size", "--export",
+					"--shard-size", "--metrics", "--trace", "--queue-depth", "--skin-workers" };
+				bool isValueFlag = std::find(valueFlags.begin(), valueFlags.end(), arg) != valueFlags.end();
+				std::cerr << (isValueFlag ? "missing value of " : "unknown argument ") << arg << std::endl;
+				printUsage();
+				return 2;
+			}
+			else
+			{
+				manifests.emplace_back(arg);
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cerr << "invalid value " << argv[i] << " of " << arg << std::endl;
+			printUsage();
+			return 2;
+		}
+	}
+
+	if (queueDepth < 1 || skinWorkers < 1 || cacheMegabytes < 0.0 || shardMegabytes < 0.0)
+	{
+		std::cerr << "--queue-depth and --skin-workers must be at least 1, the sizes must not be negative" << std::endl;
+		printUsage();
+		return 2;
+	}
+
+	if (manifests.empty())
+	{
+		printUsage();
+		return 2;
+	}
+
+	// the flag overrides the environment
+	util::trace::setThreadName("main");
+	if (!traceName.empty())
+	{
+		util::trace::start(traceName);
+	}
+	else
+	{
+		util::trace::startFromEnvironment();
+	}
+
+	if (!cacheDirectory.empty())
+	{
+		options.cache = std::make_shared<util::SkinCache>(cacheDirectory, static_cast<uintmax_t>(cacheMegabytes * 1024.0 * 1024.0));
+	}
+
+	std::vector<batch::Job> jobs;
+	for (const auto& manifest : manifests)
+	{
+		std::string error;
+		if (!batch::readManifest(manifest, jobs, error))
+		{
+			std::cerr << error << std::endl;
+			return 2;
+		}
+	}
+
+	std::ofstream report;
+	if (!reportName.empty())
+	{
+		report.open(reportName);
+		report << "job,input,output,status,read_ms,skin_ms,write_ms,total_ms,message" << std::endl;
+	}
+
+	// one object per skinned job, written as the jobs finish
+	std::ofstream metricsFile;
+	if (!metricsName.empty())
+	{
+		metricsFile.open(metricsName);
+		metricsFile << "{\n  \"jobs\": [";
+	}
+	bool firstMetrics = true;
+
+	// the export holds no model, each surface is written out when its job finishes
+	io::StepStreamOptions exportOptions;
+	exportOptions.maxShardBytes = static_cast<uint64_t>(shardMegabytes * 1024.0 * 1024.0);
+	io::StepStreamWriter exporter(exportOptions);
+	if (!exportName.empty())
+	{
+		std::string error;
+		if (!exporter.open(exportName, error))
+		{
+			std::cerr << error << std::endl;
+			return 2;
+		}
+	}
+
+	int numFailed = 0;
+	auto batchStart = Clock::now();
+	std::cout << std::fixed << std::setprecision(2);
+
+	// export, metrics, progress and report of a finished job, called by one thread at a time
+	auto finishJob = [&](batch::JobResult& result)
+	{
+		const batch::Job& job = jobs[result.index];
+		if (result.success && !exportName.empty())
+		{
+			auto start = Clock::now();
+			result.success = exporter.add(result.surface, result.error);
+			result.writeMs += elapsedMs(start);
+		}
+
+		// only the jobs which reached skinning have metrics
+		if (metricsFile.is_open() && result.skinMs > 0.0)
+		{
+			metricsFile << (firstMetrics ? "\n" : ",\n") << "    {\"job\": " << result.index + 1 << ", \"line\": " << job.line << ", \"metrics\": "
+				<< result.metrics.toJson() << "}";
+			firstMetrics = false;
+		}
+
+		double totalMs = result.readMs + result.skinMs + result.writeMs;
+		numFailed += result.success ? 0 : 1;
+
+		std::cout << "job " << result.index + 1 << "/" << jobs.size() << " " << (result.success ? "ok    " : "FAILED")
+			<< " read " << result.readMs << " ms, skin " << result.skinMs << " ms, write " << result.writeMs << " ms, total " << totalMs << " ms: "
+			<< job.output;
+		if (!result.success)
+		{
+			std::cout << " (line " << job.line << ": " << result.error << ")";
+		}
+		std::cout << std::endl;
+
+		if (report.is_open())
+		{
+			report << result.index + 1 << "," << csvField(job.input) << "," << csvField(job.output) << "," << (result.success ? "ok" : "failed") << ","
+				<< result.readMs << "," << result.skinMs << "," << result.writeMs << "," << totalMs << "," << csvField(result.error) << std::endl;
+		}
+	};
+
+	if (pipeline)
+	{
+		// reading, skinning and writing overlap, at most queueDepth jobs wait between two of them
+		batch::PipelineOptions pipelineOptions;
+		pipelineOptions.queueDepth = static_cast<size_t>(queueDepth);
+		pipelineOptions.numSkinWorkers = skinWorkers;
+		pipelineOptions.collectMetrics = metricsFile.is_open();
+		batch::runPipeline(jobs, options, pipelineOptions, finishJob);
+	}
+	else
+	{
+		// jobs of a manifest are usually grouped by input, so the curves of the last input are kept
+		std::string loadedInput;
+		std::vector<Handle(Geom_BSplineCurve)> curves;
+		std::string loadError;
+
+		for (size_t n = 0; n < jobs.size(); ++n)
+		{
+			const batch::Job& job = jobs[n];
+			util::TraceScope jobTrace("job", "batch", job.output);
+			batch::JobResult result;
+			result.index = n;
+
+			// read
+			std::vector<Handle(Geom_BSplineCurve)> sections;
+			{
+				util::TraceScope trace("read", "batch", job.input);
+				auto start = Clock::now();
+				if (job.input != loadedInput)
+				{
+					loadedInput = job.input;
+					loadError.clear();
+					if (!batch::loadCurves(job.input, curves, loadError, options.numThreads))
+					{
+						curves.clear();
+					}
+				}
+				if (!loadError.empty())
+				{
+					result.error = loadError;
+				}
+				else
+				{
+					result.success = batch::selectCurves(job, curves, sections, result.error);
+				}
+				result.readMs = elapsedMs(start);
+			}
+
+			// skin
+			if (result.success)
+			{
+				util::TraceScope trace("skin", "batch");
+				auto start = Clock::now();
+				result.success = batch::skinSections(job, sections, options, result.surface, result.error,
+					metricsFile.is_open() ? &result.metrics : nullptr);
+				result.skinMs = elapsedMs(start);
+			}
+
+			// write
+			if (result.success)
+			{
+				util::TraceScope trace("write", "batch", job.output);
+				auto start = Clock::now();
+				result.success = batch::writeSurface(job, result.surface, result.error);
+				result.writeMs = elapsedMs(start);
+			}
+
+			finishJob(result);
+		}
+	}
+
+	if (metricsFile.is_open())
+	{
+		metricsFile << "\n  ]\n}\n";
+	}
+
+	bool exported = true;
+	if (!exportName.empty())
+	{
+		std::string error;
+		exported = exporter.close(error);
+		if (!exported)
+		{
+			std::cerr << error << std::endl;
+		}
+		std::cout << "export: " << exporter.numItems() << " surfaces, " << exporter.bytesWritten() / 1048576.0 << " MB in "
+			<< exporter.files().size() << " files" << std::endl;
+	}
+
+	std::cout << jobs.size() - numFailed << " of " << jobs.size() << " jobs succeeded in " << elapsedMs(batchStart) / 1000.0 << " s" << std::endl;
+	if (options.cache)
+	{
+		std::cout << "cache: " << options.cache->hits() << " hits, " << options.cache->misses() << " misses, "
+			<< options.cache->evictions() << " evictions" << std::endl;
+	}
+
+	bool traced = true;
+	if (util::trace::enabled())
+	{
+		std::string error;
+		traced = util::trace::stop(error);
+		if (!traced)
+		{
+			std::cerr << error << std::endl;
+		}
+	}
+
+	return numFailed == 0 && exported && traced ? 0 : 1;
+}
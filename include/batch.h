@@ -0,0 +1,99 @@
+#pragma once
+
+#include "skin.h"
+
+#include <functional>
+#include <string>
+
+namespace batch
+{
+	// One skinning job of a manifest
+	struct Job
+	{
+		std::string input;	// STEP/IGES file holding the section curves
+		std::vector<int> selection;	// 1-based indices of the section curves in skinning order, empty selects all curves
+		int degreeV = 3;	// degree of the skinned surface at direction v
+		std::string output;	// STEP file receiving the skinned face
+		int line = 0;	// line of the job in its manifest
+	};
+
+	/*
+	 * read jobs from a manifest, one job per line:
+	 *   <input> <selection> <degreeV> <output>
+	 * where selection is "all" or a comma separated list of indices and ranges such as "1,3,5-9" or "9-5".
+	 * Fields holding spaces are double quoted, lines starting with '#' are comments, and relative paths
+	 * are resolved against the directory of the manifest.
+	 **/
+	bool readManifest(const std::string& filename, std::vector<Job>& jobs, std::string& error);
+
+	// read all B-spline curves of a model file, "numThreads" threads parse STEP and IGES files and 0 uses all cores
+	bool loadCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error,
+		int numThreads = 1);
+
+	// the curves selected by the job, shared with "curves" since Skin only reads its input
+	bool selectCurves(const Job& job, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+		std::vector<Handle(Geom_BSplineCurve)>& sections, std::string& error);
+
+	// skin the sections of a job, the metrics of the Skin are copied to "metrics" when it is given
+	bool skinSections(const Job& job, const std::vector<Handle(Geom_BSplineCurve)>& sections, const SkinOptions& options,
+		Handle(Geom_BSplineSurface)& surface, std::string& error, SkinMetrics* metrics = nullptr);
+
+	// One set of section curves skinned by skinAll
+	struct SectionSet
+	{
+		std::vector<Handle(Geom_BSplineCurve)> sections;	// read by Skin only, so they may be shared with the caller
+		int degreeV = 3;
+	};
+
+	// Surface of one section set, or the reason it failed
+	struct SkinResult
+	{
+		bool success = false;
+		Handle(Geom_BSplineSurface) surface;
+		std::string error;
+		double milliseconds = 0.0;	// time of the Skin construction and skin()
+	};
+
+	/*
+	 * skin independent section sets concurrently on the work-stealing pool of the options, or on a pool of
+	 * options.numThreads threads made for the call. Every set is one task and the largest sets start first; the
+	 * columns and sections of a set are split across the workers other sets left idle, so a few large sets do not
+	 * hold back the end of the batch. The results are in the order of the sets, a failed set keeps its error and
+	 * the others go on.
+	 **/
+	std::vector<SkinResult> skinAll(const std::vector<SectionSet>& sets, const SkinOptions& options);
+
+	// build a face on the surface and save it to the output of the job
+	bool writeSurface(const Job& job, const Handle(Geom_BSplineSurface)& surface, std::string& error);
+
+	// Options of runPipeline
+	struct PipelineOptions
+	{
+		size_t queueDepth = 4;	// jobs waiting between two stages, bounds the section sets and surfaces held in memory
+		int numSkinWorkers = 1;	// threads of the skin stage, more than one finishes the jobs out of order
+		bool collectMetrics = false;	// copy the metrics of every Skin into its result
+	};
+
+	// Outcome of one job of runPipeline
+	struct JobResult
+	{
+		size_t index = 0;	// position of the job in the list
+		bool success = false;
+		std::string error;
+		Handle(Geom_BSplineSurface) surface;
+		SkinMetrics metrics;
+		double readMs = 0.0;	// loading the input, shared by the jobs of the same input, and selecting the sections
+		double skinMs = 0.0;
+		double writeMs = 0.0;
+	};
+
+	/*
+	 * run the jobs through three concurrent stages joined by bounded queues: a reader thread loading the inputs
+	 * and selecting the sections, the skin workers, and the calling thread writing the outputs and calling
+	 * "finished" on every result. A full queue stops the stage feeding it, so whatever the number of jobs at most
+	 * queueDepth section sets and queueDepth surfaces wait between the stages. The input of consecutive jobs is
+	 * loaded once, as by a sequential loop, and so the jobs should be grouped by input.
+	 **/
+	void runPipeline(const std::vector<Job>& jobs, const SkinOptions& options, const PipelineOptions& pipelineOptions,
+		const std::function<void(JobResult&)>& finished);
+};
@@ -1,27 +1,163 @@
 #pragma once
 
 #include "utils.h"
+#include "cache.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include <Geom_BSplineCurve.hxx>
 #include <Geom_BSplineSurface.hxx>
+#include <Precision.hxx>
+
+// phases of skinning reported to SkinOptions::progress
+enum class SkinPhase
+{
+	Compatibility,	// raising the degrees of the sections and inserting the merged knots
+	Parameterization,	// parameters and knot vector at v direction
+	Solve,	// interpolation or least-squares fit of the control points
+	Surface	// building the surface and removing its knots
+};
+
+// name of a phase for messages, e.g. "solve"
+const char* skinPhaseName(SkinPhase phase);
+
+// options of skinning
+struct SkinOptions
+{
+	int numThreads = 1;	// threads solving the columns of control points, 1 runs serially and 0 uses all cores
+	double knotTolerance = Precision::PConfusion();	// knots of the sections closer than this are merged into one, 0 merges equal knots only
+	std::shared_ptr<util::SkinCache> cache;	// cache of skinned surfaces shared by Skin objects, none by default
+	int approximationPoles = 0;	// control points at v direction fitted to the sections by least squares, 0 interpolates the sections
+	double approximationTolerance = 0.0;	// fit the fewest control points at v direction keeping the sections within this distance, 0 interpolates
+	double knotRemovalTolerance = 0.0;	// remove the knots of the surface at u and v direction moving it less than this distance, 0 keeps all knots
+	nurbs::Parameterization parameterization = nurbs::Parameterization::ChordLength;	// scheme of the parameters of the sections at v direction
+	bool collectMetrics = false;	// time the phases and count the work of skinning into SkinMetrics, no clock is read otherwise
+	std::function<bool(SkinPhase phase, double fraction)> progress;	// called with the fraction done of the phases by the threads doing the work, one call at a time, returning false cancels skin()
+	std::shared_ptr<util::ThreadPool> pool;	// pool shared by Skin objects for every parallel phase instead of numThreads threads, none by default
+	bool keepSections = true;	// keep the compatible sections for cheap edits after skin(), false solves them in place and an edit recomputes them all
+};
+
+// result of removing knots from the skinned surface
+struct KnotRemovalReport
+{
+	int numPolesUBefore = 0, numPolesVBefore = 0;	// numbers of control points before the removal
+	int numPolesU = 0, numPolesV = 0;	// numbers of control points after the removal
+	double maxDeviation = 0.0;	// bound of the distance between the surfaces before and after the removal
+};
+
+// durations and counters of the work of a Skin, collected when SkinOptions::collectMetrics is set
+struct SkinMetrics
+{
+	// milliseconds spent in each phase, added up since the construction or the last resetMetrics()
+	double cacheMs = 0.0;	// hashing the curves, reading and storing the cache
+	double mergeKnotsMs = 0.0;	// merging the knots of the sections at u direction
+	double compatibleMs = 0.0;	// raising the degrees of the sections and inserting the merged knots
+	double controlNetMs = 0.0;	// copying the compatible sections into the control net
+	double parameterizationMs = 0.0;	// parameters and knot vector at v direction
+	double solveMs = 0.0;	// interpolation or least-squares fit of the control points
+	double surfaceMs = 0.0;	// building the OCC surface on the control points
+	double knotRemovalMs = 0.0;	// removing knots from the surface
+	double totalMs = 0.0;	// constructor, skin() and section edits, phases included
+
+	// work done in those phases
+	int numCompatibleSections = 0;	// sections made compatible, again after edits
+	int numElevatedSections = 0;	// sections whose degree was raised
+	int degreeElevation = 0;	// degrees added to the sections in total
+	long long numInsertedKnots = 0;	// knots inserted into the sections, counted with their multiplicities
+	int numFits = 0;	// least-squares fits, several when searching the fewest control points
+	int numSurfaces = 0;	// surfaces constructed
+	int numCacheHits = 0;
+
+	// the last surface
+	int degreeU = 0, degreeV = 0;
+	int numPolesU = 0, numPolesV = 0;
+	int numKnotsU = 0, numKnotsV = 0;	// distinct knots
+
+	// one JSON object holding every field
+	std::string toJson() const;
+};
 
 class Skin
 {
 public:
-	Skin(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree = 3);	// "degree" is the degree of B-spline at direction v
+	Skin(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree = 3, const SkinOptions& options = SkinOptions());	// "degree" is the degree of B-spline at direction v
 	
-	// skin operation
+	// skin operation, the surface is constructed by the first call only
 	void skin();
 
+	// set the number of threads solving the columns, the result is identical whatever the number
+	void setNumThreads(int numThreads);
+
+	// insert a section curve before the index-th one, -1 appends it, the surface is constructed again by the next skin()
+	void addSection(const Handle(Geom_BSplineCurve)& curve, int index = -1);
+
+	// replace the index-th section curve
+	void replaceSection(int index, const Handle(Geom_BSplineCurve)& curve);
+
+	// remove the index-th section curve
+	void removeSection(int index);
+
+	// get the number of section curves
+	int getNumSections() const;
+
 	// get generated surface
 	const Handle(Geom_BSplineSurface) getSurface() const;
 
+	// get the statistics of merging the knots of the sections at u direction
+	const nurbs::KnotMergeReport& getKnotMergeReport() const;
+
+	// check whether the surface was read from the cache
+	bool isCacheHit() const;
+
+	// get the largest distance between the control points of the sections and the surface at their parameters, 0 when interpolating
+	double getMaxDeviation() const;
+
+	// get the result of removing knots from the surface
+	const KnotRemovalReport& getKnotRemovalReport() const;
+
+	// start or stop collecting metrics, the collected ones are kept
+	void setCollectMetrics(bool collect);
+
+	// check whether the progress callback cancelled the last skin(), the surface is null then and the next skin() starts again
+	bool isCancelled() const;
+
+	// get the metrics collected so far, all zero unless SkinOptions::collectMetrics is set
+	const SkinMetrics& getMetrics() const;
+
+	// clear the metrics, for instance before timing the next skin() alone
+	void resetMetrics();
+
 private:
-	// increase the degrees of all curves to the same
-	void increaseDegree(std::vector<Handle(Geom_BSplineCurve)>& curves);
+	// merge the knots of curves as if their degrees were increased to "degree"
+	void mergeKnots(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree, TColStd_Array1OfReal& knots, TColStd_Array1OfInteger& mults);
+
+	// make all sections compatible again from the input curves, false if their poles could not be computed
+	bool compatibilize();
+
+	// make the sections compatible after the index-th input curve replaced "previous", -1 if "previous" was removed
+	void recompatibilize(int index, const Handle(Geom_BSplineCurve)& previous);
+
+	// multiplicities of the knots of a curve after increasing its degree to the one of the sections
+	TColStd_Array1OfInteger elevatedMults(const Handle(Geom_BSplineCurve)& curve, int degree) const;
+
+	// compute the poles of the index-th section from its input curve
+	bool compatibleSection(int index);
+
+	// report an index out of the range of the sections
+	bool checkIndex(int index, int last) const;
+
+	// add the degree elevation and the knot insertion of the index-th section to the metrics
+	void countSectionWork(int index);
 
-	// refine the knots of all curves to the same
-	void refineKnots(std::vector<Handle(Geom_BSplineCurve)>& curves);
+	// hash of the input curves, the degree at v direction and the options changing the surface
+	std::string cacheKey() const;
+
+	// read the surface of the current curves from the cache
+	bool loadFromCache();
 
 	// calculate parameters and knot vector at v direction
 	void calculate();
@@ -29,18 +165,57 @@ private:
 	// construct generated B-spline skin surface																				// create generated B-spline skin surface
 	void constructSurface();
 
+	// solve the control points interpolating the sections in place
+	bool interpolateSections();
+
+	// fit numPolesV rows of control points to the sections by least squares
+	bool approximateSections(int numPolesV, nurbs::ControlNet& net, std::vector<double>& knots, double& maxDeviation);
+
+	// remove the knots of the surface within knotRemovalTolerance at u and then v direction
+	void removeSurfaceKnots();
+
+	// report the fraction done of a phase to the progress callback, false once skinning is cancelled
+	bool reportProgress(SkinPhase phase, double fraction);
+
+	// call func(first, last) on ranges of the blocks of columns of the control net, in parallel if requested
+	void forEachBlock(const std::function<void(int, int)>& func);
+
+	// call func(first, last) on ranges of the sections, in parallel if requested
+	void forEachSection(const std::function<void(int, int)>& func);
+
+	// pool of the parallel phases: the shared one, else one of numThreads threads made on first use and kept, null when serial
+	util::ThreadPool* threadPool();
+
 private:
+	SkinOptions m_options;
+
 	int m_degreeU, m_degreeV;	// degrees of B-spline in derection of u and v
 	int m_numCurves;	// number of section curves
 	int m_numControlPointsU;	// number of control points on each section curve
 
-	TColStd_Array1OfReal m_knotsU;	// knot vectors at u direction
-	TColStd_Array1OfInteger m_multsU;	// multiplicities at u direction
+	TColStd_Array1OfReal m_knotsU;	// merged knots of the input curves at u direction, the sections have all of them
+	TColStd_Array1OfInteger m_multsU;	// maximum multiplicities of the merged knots
+	nurbs::KnotMergeReport m_knotMergeReport;	// statistics of merging the knots at u direction
+
+	std::vector<Handle(Geom_BSplineCurve)> m_curves;	// input curves, only read so they are shared with the caller
+	nurbs::ControlNet m_sections;	// poles of the input curves with the same degree and knots, row j holds the j-th curve
+	bool m_compatible;	// false until the sections are made compatible, a cache hit skips it
+
+	std::string m_cacheKey;	// key of the current curves, empty until it is computed
+	bool m_cacheHit;	// the surface was read from the cache
 
 	std::vector<double> m_knotsV;	// knot vectors at v direction
 	std::vector<double> m_paramsV;	// parameters at v direction
 
-	std::vector<TColgp_Array1OfPnt> m_ControlPointsV;	// control points of section curves arranged in v direction
+	nurbs::ControlNet m_controlNet;	// control points of section curves, row j holds the j-th curve
+
+	double m_maxDeviation;	// largest distance of the sections to the approximating surface
+	KnotRemovalReport m_knotRemovalReport;	// result of removing knots from the surface
+	SkinMetrics m_metrics;	// collected when m_options.collectMetrics is set
+	std::mutex m_progressMutex;	// serializes the progress calls of the threads
+	std::atomic<bool> m_cancelled;	// the progress callback cancelled skin()
+	int m_solveFit, m_numSolveFits;	// fit running and number of fits of the Solve phase, which shares its progress
+	std::unique_ptr<util::ThreadPool> m_ownPool;	// threads of this Skin when no pool is shared
 
 	Handle(Geom_BSplineSurface) m_bsplineSurface;	// skinned surface
 };
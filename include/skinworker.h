@@ -0,0 +1,51 @@
+#pragma once
+
+#include "skin.h"
+
+#include <atomic>
+#include <thread>
+#include <TopoDS_Shape.hxx>
+
+#include <QObject>
+#include <QString>
+
+/*
+ * Skins section curves and builds the face on a worker thread, so the GUI thread only displays the result.
+ * The progress of the Skin phases and the outcome are signalled in the thread owning the worker, and signals
+ * still queued when the worker is destroyed are dropped. Only Qt Core is used, so it runs under any platform
+ * plugin, offscreen included.
+ **/
+class SkinWorker : public QObject
+{
+	Q_OBJECT
+public:
+	explicit SkinWorker(QObject* parent = nullptr);
+	~SkinWorker();	// cancels the running skinning and waits for it
+
+	// start skinning the curves, false while a skinning is running, the curves are only read
+	bool start(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree, const SkinOptions& options = SkinOptions());
+
+	// ask the running skinning to stop at its next progress report, cancelled() is signalled when it did
+	void cancel();
+
+	// true from start() until finished(), failed() or cancelled() is signalled
+	bool isRunning() const;
+
+	// wait for the worker thread, the signals are still delivered by the event loop of the owning thread
+	void wait();
+
+signals:
+	void progress(const QString& phase, int percent);
+	void finished(const TopoDS_Shape& face);
+	void failed(const QString& message);
+	void cancelled();
+
+private:
+	// body of the worker thread
+	void run(std::vector<Handle(Geom_BSplineCurve)> curves, int degree, SkinOptions options);
+
+private:
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_cancel;
+};
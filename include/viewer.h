@@ -1,7 +1,11 @@
 #pragma once
 
 #include "skin.h"
+#include "skinworker.h"
+#include "display.h"
+#include "meshcache.h"
 
+#include <memory>
 #include <AIS_SequenceOfInteractive.hxx>
 #include <TopoDS_Shape.hxx>
 #include <AIS_ViewController.hxx>
@@ -40,17 +44,26 @@ public slots:
 
 	// Edit
 	void clear();	// clear all models
+	void setMeshDeflection();	// ask the deflection of the meshes, then mesh the shapes again
 
 	// Surface
-	void skin();
+	void skin();	// skin the selected curves on a worker thread
+	void cancelSkin();	// stop the running skinning
 
 	void fitView();
 	void shadingView();	// shading pattern
 	void wireframeView(); // wireframe pattern
 
+private slots:
+	// results of the skin worker, in the GUI thread
+	void onSkinProgress(const QString& phase, int percent);
+	void onSkinFinished(const TopoDS_Shape& face);
+	void onSkinFailed(const QString& message);
+	void onSkinCancelled();
+
 private:
 	void init();	// initialize
-	void updateView();
+	void updateView();	// display the shapes added since the last update, keep the others
 	TopoDS_Shape getShape();	// detect the currently chosen shape
 	void operator<<(const TopoDS_Shape& shape);
 	void showMessage(const QString& message); // show message at status bar
@@ -62,7 +75,10 @@ private:
 	Handle(V3d_Viewer) m_viewer;
 	Handle(V3d_View) m_view;
 	Handle(AIS_InteractiveContext) m_context;
+	std::unique_ptr<util::DisplayList> m_displayList;	// one presentation per shape of m_shapes
+	util::MeshCache m_meshCache;	// the meshes of the presentations, computed before display
 	Handle(WNT_Window) m_wntWindow;
 
 	QStatusBar* m_statusBar;
+	SkinWorker* m_skinWorker;	// skinning off the GUI thread
 };
@@ -0,0 +1,504 @@
+#include "batch.h"
+#include "trace.h"
+#include "boundedqueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <Standard_Failure.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <Precision.hxx>
+
+namespace
+{
+	// split a manifest line into whitespace separated fields, double quotes group fields holding spaces
+	std::vector<std::string> splitFields(const std::string& line)
+	{
+		std::vector<std::string> fields;
+		size_t i = 0;
+		while (i < line.size())
+		{
+			while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i])))
+			{
+				++i;
+			}
+			if (i == line.size())
+			{
+				break;
+			}
+
+			std::string field;
+			if (line[i] == '"')
+			{
+				size_t end = line.find('"', i + 1);
+				end = end == std::string::npos ? line.size() : end;
+				field = line.substr(i + 1, end - i - 1);
+				i = end + 1;
+			}
+			else
+			{
+				size_t end = i;
+				while (end < line.size() && !std::isspace(static_cast<unsigned char>(line[end])))
+				{
+					++end;
+				}
+				field = line.substr(i, end - i);
+				i = end;
+			}
+			fields.emplace_back(field);
+		}
+		return fields;
+	}
+
+	// parse "all" or "1,3,5-9" into indices, ranges may run backwards
+	bool parseSelection(const std::string& text, std::vector<int>& selection)
+	{
+		selection.clear();
+		if (text == "all")
+		{
+			return true;
+		}
+
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			try
+			{
+				size_t dash = item.find('-', 1);
+				if (dash == std::string::npos)
+				{
+					selection.push_back(std::stoi(item));
+					continue;
+				}
+
+				int first = std::stoi(item.substr(0, dash));
+				int last = std::stoi(item.substr(dash + 1));
+				int step = first <= last ? 1 : -1;
+				for (int index = first; index != last + step; index += step)
+				{
+					selection.push_back(index);
+				}
+			}
+			catch (const std::exception&)
+			{
+				return false;
+			}
+		}
+		return !selection.empty();
+	}
+
+	// Job moving through the stages of runPipeline
+	struct PipelineItem
+	{
+		batch::JobResult result;
+		std::vector<Handle(Geom_BSplineCurve)> sections;
+	};
+
+	double elapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string resolvePath(const std::filesystem::path& directory, const std::string& path)
+	{
+		std::filesystem::path filePath(path);
+		return filePath.is_relative() ? (directory / filePath).string() : path;
+	}
+}
+
+bool batch::readManifest(const std::string& filename, std::vector<Job>& jobs, std::string& error)
+{
+	std::ifstream manifest(filename);
+	if (!manifest)
+	{
+		error = "cannot open manifest " + filename;
+		return false;
+	}
+
+	std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(manifest, line))
+	{
+		++lineNumber;
+		std::vector<std::string> fields = splitFields(line);
+		if (fields.empty() || fields[0][0] == '#')
+		{
+			continue;
+		}
+
+		Job job;
+		job.line = lineNumber;
+		if (fields.size() != 4 || !parseSelection(fields[1], job.selection))
+		{
+			error = filename + ":" + std::to_string(lineNumber) + ": expected <input> <selection> <degreeV> <output>";
+			return false;
+		}
+		try
+		{
+			job.degreeV = std::stoi(fields[2]);
+		}
+		catch (const std::exception&)
+		{
+			error = filename + ":" + std::to_string(lineNumber) + ": invalid degree " + fields[2];
+			return false;
+		}
+		job.input = resolvePath(directory, fields[0]);
+		job.output = resolvePath(directory, fields[3]);
+		jobs.emplace_back(job);
+	}
+
+	return true;
+}
+
+bool batch::loadCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error, int numThreads)
+{
+	// wireframe STEP models and IGES curve files are read by the fast paths, the others by a full transfer
+	std::string extension = std::filesystem::path(filename).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == ".nrb")
+	{
+		std::vector<Handle(Geom_BSplineSurface)> surfaces;
+		if (!io::readNative(filename, curves, surfaces, error))
+		{
+			return false;
+		}
+		if (curves.empty())
+		{
+			error = "no B-spline curve read from " + filename;
+			return false;
+		}
+		return true;
+	}
+
+	std::string fastError;
+	if ((extension == ".step" || extension == ".stp") && io::readStepCurves(filename, curves, fastError, numThreads) && !curves.empty())
+	{
+		return true;
+	}
+	if ((extension == ".iges" || extension == ".igs") && io::readIgesCurves(filename, curves, fastError, numThreads) && !curves.empty())
+	{
+		return true;
+	}
+
+	Handle(TopTools_HSequenceOfShape) hSequenceOfShape = new TopTools_HSequenceOfShape();
+	io::readModel(filename.c_str(), hSequenceOfShape);
+	util::collectBSplineCurves(hSequenceOfShape, curves);
+
+	if (curves.empty())
+	{
+		error = "no B-spline curve read from " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool batch::selectCurves(const Job& job, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+	std::vector<Handle(Geom_BSplineCurve)>& sections, std::string& error)
+{
+	sections.clear();
+
+	if (job.selection.empty())
+	{
+		sections = curves;
+		return true;
+	}
+
+	for (int index : job.selection)
+	{
+		if (index < 1 || index > static_cast<int>(curves.size()))
+		{
+			error = "curve " + std::to_string(index) + " out of range 1-" + std::to_string(curves.size());
+			return false;
+		}
+		sections.emplace_back(curves[index - 1]);
+	}
+	return true;
+}
+
+bool batch::skinSections(const Job& job, const std::vector<Handle(Geom_BSplineCurve)>& sections, const SkinOptions& options,
+	Handle(Geom_BSplineSurface)& surface, std::string& error, SkinMetrics* metrics)
+{
+	if (job.degreeV < 1 || job.degreeV >= static_cast<int>(sections.size()))
+	{
+		error = "degreeV " + std::to_string(job.degreeV) + " needs at least " + std::to_string(job.degreeV + 1) + " sections";
+		return false;
+	}
+
+	try
+	{
+		SkinOptions skinOptions = options;
+		skinOptions.collectMetrics = options.collectMetrics || metrics != nullptr;
+		skinOptions.keepSections = false;	// never edited
+		Skin skin(sections, job.degreeV, skinOptions);
+		skin.skin();
+		surface = skin.getSurface();
+		if (metrics)
+		{
+			*metrics = skin.getMetrics();
+		}
+	}
+	catch (Standard_Failure& failure)
+	{
+		error = failure.GetMessageString();
+		return false;
+	}
+
+	if (surface.IsNull())
+	{
+		error = "skinning failed";
+		return false;
+	}
+	return true;
+}
+
+std::vector<batch::SkinResult> batch::skinAll(const std::vector<SectionSet>& sets, const SkinOptions& options)
+{
+	std::vector<SkinResult> results(sets.size());
+
+	// the Skin objects split their loops on the same pool, nothing else runs threads
+	SkinOptions skinOptions = options;
+	if (!skinOptions.pool)
+	{
+		skinOptions.pool = std::make_shared<util::ThreadPool>(options.numThreads);
+	}
+	skinOptions.numThreads = 1;
+
+	// largest sets first, counted by their poles, so the small ones fill the gaps at the end
+	std::vector<long long> sizes(sets.size(), 0);
+	for (size_t i = 0; i < sets.size(); ++i)
+	{
+		for (const auto& curve : sets[i].sections)
+		{
+			sizes[i] += curve.IsNull() ? 0 : curve->NbPoles();
+		}
+	}
+	std::vector<int> order(sets.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sizes](int a, int b) { return sizes[a] > sizes[b]; });
+
+	skinOptions.pool->parallelFor(0, static_cast<int>(sets.size()), 1, [&](int first, int last)
+	{
+		for (int n = first; n < last; ++n)
+		{
+			const SectionSet& set = sets[order[n]];
+			SkinResult& result = results[order[n]];
+			util::TraceScope trace("skin set", "batch");
+			auto start = std::chrono::steady_clock::now();
+
+			Job job;
+			job.degreeV = set.degreeV;
+			try
+			{
+				result.success = skinSections(job, set.sections, skinOptions, result.surface, result.error);
+			}
+			catch (const std::exception& failure)
+			{
+				result.success = false;
+				result.error = failure.what();
+			}
+			result.milliseconds = elapsedMs(start);
+		}
+	});
+
+	return results;
+}
+
+bool batch::writeSurface(const Job& job, const Handle(Geom_BSplineSurface)& surface, std::string& error)
+{
+	try
+	{
+		std::filesystem::path directory = std::filesystem::path(job.output).parent_path();
+		if (!directory.empty())
+		{
+			std::filesystem::create_directories(directory);
+		}
+		std::filesystem::remove(job.output);
+
+		// native outputs hold the surface itself, the others a face translated to STEP
+		std::string extension = std::filesystem::path(job.output).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".nrb")
+		{
+			if (!io::saveNative(job.output, {}, { surface }, error))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			TopoDS_Shape face;
+			{
+				util::TraceScope trace("BRepBuilderAPI_MakeFace", "geometry");
+				face = BRepBuilderAPI_MakeFace(surface, Precision::Confusion());
+			}
+			Handle(TopTools_HSequenceOfShape) hSequenceOfShape = new TopTools_HSequenceOfShape();
+			hSequenceOfShape->Append(face);
+			io::saveStep(job.output.c_str(), hSequenceOfShape, STEPControl_AsIs);
+		}
+	}
+	catch (Standard_Failure& failure)
+	{
+		error = failure.GetMessageString();
+		return false;
+	}
+	catch (const std::filesystem::filesystem_error& failure)
+	{
+		error = failure.what();
+		return false;
+	}
+
+	if (!std::filesystem::exists(job.output))
+	{
+		error = "cannot write " + job.output;
+		return false;
+	}
+	return true;
+}
+
+void batch::runPipeline(const std::vector<Job>& jobs, const SkinOptions& options, const PipelineOptions& pipelineOptions,
+	const std::function<void(JobResult&)>& finished)
+{
+	util::BoundedQueue<PipelineItem> sectionQueue(pipelineOptions.queueDepth);
+	util::BoundedQueue<PipelineItem> surfaceQueue(pipelineOptions.queueDepth);
+
+	// reader, the curves of the last input are kept for the next jobs
+	std::thread reader([&]()
+	{
+		util::trace::setThreadName("reader");
+		std::string loadedInput;
+		std::vector<Handle(Geom_BSplineCurve)> curves;
+		std::string loadError;
+		bool loaded = false;
+
+		for (size_t n = 0; n < jobs.size(); ++n)
+		{
+			const Job& job = jobs[n];
+			util::TraceScope trace("read", "batch", job.input);
+			auto start = std::chrono::steady_clock::now();
+			PipelineItem item;
+			item.result.index = n;
+			try
+			{
+				if (!loaded || job.input != loadedInput)
+				{
+					loaded = true;
+					loadedInput = job.input;
+					loadError.clear();
+					if (!loadCurves(job.input, curves, loadError, options.numThreads))
+					{
+						curves.clear();
+					}
+				}
+				if (!loadError.empty())
+				{
+					item.result.error = loadError;
+				}
+				else
+				{
+					item.result.success = selectCurves(job, curves, item.sections, item.result.error);
+				}
+			}
+			catch (Standard_Failure& failure)
+			{
+				item.result.success = false;
+				item.result.error = failure.GetMessageString();
+			}
+			catch (const std::exception& failure)
+			{
+				item.result.success = false;
+				item.result.error = failure.what();
+			}
+			item.result.readMs = elapsedMs(start);
+
+			if (!sectionQueue.push(std::move(item)))
+			{
+				break;
+			}
+		}
+		sectionQueue.close();
+	});
+
+	// skin workers, the last one out closes the queue of the writer
+	int numSkinWorkers = std::max(1, pipelineOptions.numSkinWorkers);
+	std::atomic<int> activeSkinWorkers{ numSkinWorkers };
+	std::vector<std::thread> skinWorkers;
+	for (int w = 0; w < numSkinWorkers; ++w)
+	{
+		skinWorkers.emplace_back([&]()
+		{
+			util::trace::setThreadName("skin");
+			PipelineItem item;
+			while (sectionQueue.pop(item))
+			{
+				if (item.result.success)
+				{
+					util::TraceScope trace("skin", "batch");
+					auto start = std::chrono::steady_clock::now();
+					try
+					{
+						item.result.success = skinSections(jobs[item.result.index], item.sections, options, item.result.surface, item.result.error,
+							pipelineOptions.collectMetrics ? &item.result.metrics : nullptr);
+					}
+					catch (const std::exception& failure)
+					{
+						item.result.success = false;
+						item.result.error = failure.what();
+					}
+					item.result.skinMs = elapsedMs(start);
+				}
+				item.sections.clear();
+
+				if (!surfaceQueue.push(std::move(item)))
+				{
+					break;
+				}
+			}
+			if (--activeSkinWorkers == 0)
+			{
+				surfaceQueue.close();
+			}
+		});
+	}
+
+	// writer, a failing callback stops the other stages before its exception leaves
+	try
+	{
+		PipelineItem item;
+		while (surfaceQueue.pop(item))
+		{
+			if (item.result.success)
+			{
+				util::TraceScope trace("write", "batch", jobs[item.result.index].output);
+				auto start = std::chrono::steady_clock::now();
+				item.result.success = writeSurface(jobs[item.result.index], item.result.surface, item.result.error);
+				item.result.writeMs = elapsedMs(start);
+			}
+			finished(item.result);
+		}
+	}
+	catch (...)
+	{
+		sectionQueue.close();
+		surfaceQueue.close();
+		reader.join();
+		for (auto& worker : skinWorkers)
+		{
+			worker.join();
+		}
+		throw;
+	}
+
+	reader.join();
+	for (auto& worker : skinWorkers)
+	{
+		worker.join();
+	}
+}
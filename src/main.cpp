@@ -1,4 +1,5 @@
 #include "window.h"
+#include "trace.h"
 #include <QtWidgets/QApplication>
 
 int main(int argc, char* argv[])
@@ -40,6 +41,10 @@ int main(int argc, char* argv[])
     Handle(Geom_BSplineSurface) surface = skin.getSurface();*/
 
 
+    // SKIN_TRACE=file.json records a timeline of loading, skinning and redraws, written at exit
+    util::trace::setThreadName("GUI");
+    util::trace::startFromEnvironment();
+
     QApplication app(argc, argv);
     Window window;
     window.show();
@@ -1,13 +1,101 @@
 #include "skin.h"
+#include "threadpool.h"
+#include "trace.h"
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <BSplCLib.hxx>
 #include <Standard_Failure.hxx>
+#include <Standard_OutOfRange.hxx>
 
-Skin::Skin(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree)
-	: m_degreeV{degree}, m_numCurves{ static_cast<int>(curves.size())},
+namespace
+{
+	// Columns of the control net are solved in blocks of this width whatever the number of threads,
+	// so every coefficient is computed by exactly the same operations in serial and parallel mode.
+	const int columnBlock = 32;
+
+	// Sections made compatible by one task, enough work to amortize scheduling
+	const int sectionBlock = 16;
+
+	// Adds the duration of its scope to a metric, no clock is read when the metrics are not collected
+	class PhaseTimer
+	{
+	public:
+		PhaseTimer(bool enabled, double& milliseconds)
+			: m_milliseconds{ enabled ? &milliseconds : nullptr }
+		{
+			if (m_milliseconds)
+			{
+				m_start = std::chrono::steady_clock::now();
+			}
+		}
+
+		~PhaseTimer()
+		{
+			if (m_milliseconds)
+			{
+				*m_milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+			}
+		}
+
+	private:
+		double* m_milliseconds;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	int sumOf(const TColStd_Array1OfInteger& values)
+	{
+		int sum = 0;
+		for (int i = values.Lower(); i <= values.Upper(); ++i)
+		{
+			sum += values.Value(i);
+		}
+		return sum;
+	}
+}
+
+const char* skinPhaseName(SkinPhase phase)
+{
+	switch (phase)
+	{
+	case SkinPhase::Compatibility:
+		return "compatibility";
+	case SkinPhase::Parameterization:
+		return "parameterization";
+	case SkinPhase::Solve:
+		return "solve";
+	case SkinPhase::Surface:
+		return "surface";
+	}
+	return "";
+}
+
+std::string SkinMetrics::toJson() const
+{
+	std::ostringstream json;
+	json << "{\"cache_ms\": " << cacheMs << ", \"merge_knots_ms\": " << mergeKnotsMs << ", \"compatible_ms\": " << compatibleMs
+		<< ", \"control_net_ms\": " << controlNetMs << ", \"parameterization_ms\": " << parameterizationMs << ", \"solve_ms\": " << solveMs
+		<< ", \"surface_ms\": " << surfaceMs << ", \"knot_removal_ms\": " << knotRemovalMs << ", \"total_ms\": " << totalMs
+		<< ", \"compatible_sections\": " << numCompatibleSections << ", \"elevated_sections\": " << numElevatedSections
+		<< ", \"degree_elevation\": " << degreeElevation << ", \"inserted_knots\": " << numInsertedKnots << ", \"fits\": " << numFits
+		<< ", \"surfaces\": " << numSurfaces << ", \"cache_hits\": " << numCacheHits << ", \"degree_u\": " << degreeU
+		<< ", \"degree_v\": " << degreeV << ", \"poles_u\": " << numPolesU << ", \"poles_v\": " << numPolesV
+		<< ", \"knots_u\": " << numKnotsU << ", \"knots_v\": " << numKnotsV << "}";
+	return json.str();
+}
+
+Skin::Skin(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree, const SkinOptions& options)
+	: m_options{ options }, m_degreeU{ 0 }, m_degreeV{degree}, m_numCurves{ static_cast<int>(curves.size())}, m_numControlPointsU{ 0 },
 	m_knotsU{ 1, curves.empty() ? 1 : curves[0]->Knots().Length() }, // Initialize m_knotsU with appropriate size
-	m_multsU{ 1, curves.empty() ? 1 : curves[0]->Multiplicities().Length() } // Initialize m_multsU with appropriate size
+	m_multsU{ 1, curves.empty() ? 1 : curves[0]->Multiplicities().Length() }, // Initialize m_multsU with appropriate size
+	m_compatible{ false }, m_cacheHit{ false }, m_maxDeviation{ 0.0 }, m_cancelled{ false },
+	m_solveFit{ 0 }, m_numSolveFits{ 1 }
 {
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.totalMs);
+
 	if (curves.empty()) {
 		try 
 		{
@@ -31,116 +119,512 @@ Skin::Skin(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree)
 		}
 	}
 
-	// Increase Degree
-	std::vector<Handle(Geom_BSplineCurve)> newCurves = curves;
-	increaseDegree(newCurves);
+	// The input curves are only read by the compatibility stage, so they are kept without copying
+	m_curves = curves;
 
-	// Knot refinements
-	refineKnots(newCurves);
+	// A surface skinned before from the same curves needs no compatibility
+	if (loadFromCache())
+	{
+		return;
+	}
 
 	// Now the degrees and knot sequences of different curves are the same
-	m_degreeU = newCurves[0]->Degree();
-	m_knotsU = newCurves[0]->Knots();
-	m_multsU = newCurves[0]->Multiplicities();
-	m_numControlPointsU = newCurves[0]->NbPoles();
+	compatibilize();
+}
+
+void Skin::skin()
+{
+	// the surface is constructed once until the sections change
+	if (!m_bsplineSurface.IsNull() || m_curves.empty())
+	{
+		return;
+	}
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.totalMs);
+	util::TraceScope trace("Skin::skin", "skin");
+	m_cancelled = false;
+
+	// the sections may have been edited into curves skinned before
+	if (m_cacheKey.empty() && loadFromCache())
+	{
+		return;
+	}
 
-	std::vector<TColgp_Array1OfPnt> controlPointsU(m_numCurves, TColgp_Array1OfPnt(1, m_numControlPointsU));
-	for (int i = 0; i < m_numCurves; ++i)
+	if (!m_compatible && !compatibilize())
 	{
-		controlPointsU[i] = newCurves[i]->Poles();
+		return;
 	}
 
-	m_ControlPointsV.resize(m_numControlPointsU, TColgp_Array1OfPnt(1, m_numCurves));
-	for (int i = 0; i < m_numControlPointsU; ++i)
+	// Row j of the control net holds the control points of the j-th curve, it is solved in place
 	{
-		for (int j = 0; j < m_numCurves; ++j)
+		PhaseTimer copyTimer(m_options.collectMetrics, m_metrics.controlNetMs);
+		if (m_options.keepSections)
+		{
+			m_controlNet = m_sections;
+		}
+		else
 		{
-			m_ControlPointsV[i][j + 1] = controlPointsU[j].Value(i + 1);
+			// no copy of the sections, the next edit or skin() makes them compatible again
+			m_controlNet = std::move(m_sections);
+			m_sections.clear();
+			m_compatible = false;
 		}
 	}
-}
 
-void Skin::skin()
-{
 	// calculate parameters and knot vector at v direction
 	calculate();
+	if (!reportProgress(SkinPhase::Parameterization, 1.0))
+	{
+		return;
+	}
 
-	// construct generated B-spline skin surface
+	// construct generated B-spline skin surface, the net is not needed afterwards whatever the outcome
 	constructSurface();
+	m_controlNet.clear();
+	if (m_cancelled)
+	{
+		m_bsplineSurface.Nullify();
+		return;
+	}
+
+	if (m_options.cache && !m_bsplineSurface.IsNull())
+	{
+		PhaseTimer cacheTimer(m_options.collectMetrics, m_metrics.cacheMs);
+		const KnotRemovalReport& report = m_knotRemovalReport;
+		m_options.cache->store(m_cacheKey, m_bsplineSurface, { m_maxDeviation, static_cast<double>(report.numPolesUBefore),
+			static_cast<double>(report.numPolesVBefore), static_cast<double>(report.numPolesU), static_cast<double>(report.numPolesV),
+			report.maxDeviation });
+	}
 }
 
-void Skin::increaseDegree(std::vector<Handle(Geom_BSplineCurve)>& curves)
+void Skin::setNumThreads(int numThreads)
 {
-	Standard_Integer maxDegree = 0;
-	for (auto curve : curves)
+	m_options.numThreads = numThreads;
+	m_ownPool.reset();
+}
+
+void Skin::setCollectMetrics(bool collect)
+{
+	m_options.collectMetrics = collect;
+}
+
+const SkinMetrics& Skin::getMetrics() const
+{
+	return m_metrics;
+}
+
+void Skin::resetMetrics()
+{
+	m_metrics = SkinMetrics();
+}
+
+void Skin::addSection(const Handle(Geom_BSplineCurve)& curve, int index)
+{
+	int numCurves = static_cast<int>(m_curves.size());
+	index = index < 0 ? numCurves : index;
+	if (!checkIndex(index, numCurves))
+	{
+		return;
+	}
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.totalMs);
+
+	m_curves.insert(m_curves.begin() + index, curve);
+	if (m_compatible)
+	{
+		m_sections.insertRow(index);
+	}
+	recompatibilize(index, Handle(Geom_BSplineCurve)());
+}
+
+void Skin::replaceSection(int index, const Handle(Geom_BSplineCurve)& curve)
+{
+	if (!checkIndex(index, static_cast<int>(m_curves.size()) - 1))
+	{
+		return;
+	}
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.totalMs);
+
+	Handle(Geom_BSplineCurve) previous = m_curves[index];
+	m_curves[index] = curve;
+	recompatibilize(index, previous);
+}
+
+void Skin::removeSection(int index)
+{
+	if (!checkIndex(index, static_cast<int>(m_curves.size()) - 1))
+	{
+		return;
+	}
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.totalMs);
+
+	Handle(Geom_BSplineCurve) previous = m_curves[index];
+	m_curves.erase(m_curves.begin() + index);
+	if (m_compatible)
 	{
-		maxDegree = maxDegree < curve->Degree() ? curve->Degree() : maxDegree;
+		m_sections.removeRow(index);
 	}
+	recompatibilize(-1, previous);
 
-	for (auto curve : curves)
+	if (m_degreeV >= m_numCurves)
 	{
-		curve->IncreaseDegree(maxDegree);
+		try
+		{
+			throw Standard_Failure("Invalid argument m_degreeV!");
+		}
+		catch (Standard_Failure& failure)
+		{
+			std::cerr << "Caught error: " << failure.GetMessageString() << std::endl;
+		}
 	}
 }
 
-void Skin::refineKnots(std::vector<Handle(Geom_BSplineCurve)>& curves)
+int Skin::getNumSections() const
+{
+	return m_numCurves;
+}
+
+bool Skin::checkIndex(int index, int last) const
 {
+	if (index < 0 || index > last)
+	{
+		try
+		{
+			throw Standard_OutOfRange("Section index out of range!");
+		}
+		catch (Standard_Failure& failure)
+		{
+			std::cerr << "Caught error: " << failure.GetMessageString() << std::endl;
+		}
+		return false;
+	}
+	return true;
+}
+
+std::string Skin::cacheKey() const
+{
+	util::Hasher hasher;
+	hasher.add(1);	// version of the key, changed with the skinning algorithm
+	hasher.add(m_degreeV);
+	hasher.add(m_options.knotTolerance);
+	hasher.add(m_options.approximationPoles);
+	hasher.add(m_options.approximationTolerance);
+	hasher.add(m_options.knotRemovalTolerance);
+	hasher.add(static_cast<int>(m_options.parameterization));
+	hasher.add(static_cast<int>(m_curves.size()));
+
+	for (const auto& curve : m_curves)
+	{
+		hasher.add(curve->Degree());
+		hasher.add(curve->IsPeriodic() ? 1 : 0);
+
+		const TColStd_Array1OfReal& knots = curve->Knots();
+		const TColStd_Array1OfInteger& mults = curve->Multiplicities();
+		hasher.add(knots.Length());
+		for (int i = knots.Lower(); i <= knots.Upper(); ++i)
+		{
+			hasher.add(knots.Value(i));
+			hasher.add(mults.Value(i));
+		}
+
+		const TColgp_Array1OfPnt& poles = curve->Poles();
+		hasher.add(poles.Length());
+		for (int i = poles.Lower(); i <= poles.Upper(); ++i)
+		{
+			hasher.add(poles.Value(i).X());
+			hasher.add(poles.Value(i).Y());
+			hasher.add(poles.Value(i).Z());
+		}
+
+		const TColStd_Array1OfReal* weights = curve->Weights();
+		hasher.add(weights != nullptr ? weights->Length() : 0);
+		if (weights != nullptr)
+		{
+			for (int i = weights->Lower(); i <= weights->Upper(); ++i)
+			{
+				hasher.add(weights->Value(i));
+			}
+		}
+	}
+
+	return hasher.hex();
+}
+
+bool Skin::loadFromCache()
+{
+	if (!m_options.cache)
+	{
+		return false;
+	}
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.cacheMs);
+
+	m_cacheKey = cacheKey();
+	Handle(Geom_BSplineSurface) surface;
+	std::vector<double> values;
+	m_cacheHit = m_options.cache->load(m_cacheKey, surface, values) && values.size() == 6;
+	if (m_cacheHit)
+	{
+		// the surface comes back with what skinning it measured
+		m_bsplineSurface = surface;
+		m_maxDeviation = values[0];
+		m_knotRemovalReport.numPolesUBefore = static_cast<int>(values[1]);
+		m_knotRemovalReport.numPolesVBefore = static_cast<int>(values[2]);
+		m_knotRemovalReport.numPolesU = static_cast<int>(values[3]);
+		m_knotRemovalReport.numPolesV = static_cast<int>(values[4]);
+		m_knotRemovalReport.maxDeviation = values[5];
+		m_metrics.numCacheHits += m_options.collectMetrics ? 1 : 0;
+	}
+	return m_cacheHit;
+}
+
+bool Skin::compatibilize()
+{
+	m_numCurves = static_cast<int>(m_curves.size());
+	m_degreeU = 0;
+	for (const auto& curve : m_curves)
+	{
+		m_degreeU = std::max(m_degreeU, curve->Degree());
+	}
+
+	if (m_curves.empty())
+	{
+		m_numControlPointsU = 0;
+		m_sections.clear();
+		m_compatible = true;
+		return true;
+	}
+
 	// Suppose each curve is defined in the same knot interval, such as [0,1].
-	
-	// Merge knots of all curves to obtain a common knot sequence and mult sequence.
-	// Store knots and corresponding maximum mutiplicities with map.
-	std::map<Standard_Real, Standard_Integer> knotMap;
+	// The knots are merged as if all degrees were increased, then every curve is raised to the common degree
+	// and refined with the merged knots in one pass, writing its poles straight into its row of the sections.
+	mergeKnots(m_curves, m_degreeU, m_knotsU, m_multsU);
+	m_numControlPointsU = BSplCLib::NbPoles(m_degreeU, Standard_False, m_multsU);
+	m_sections.resize(m_numCurves, m_numControlPointsU);
 
-	for (auto& curve : curves)
+	std::atomic<bool> failed{ false };
+	{
+		PhaseTimer timer(m_options.collectMetrics, m_metrics.compatibleMs);
+		util::TraceScope trace("compatibilize", "skin");
+		forEachSection([&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				if (!compatibleSection(k))
+				{
+					failed = true;
+				}
+			}
+		});
+	}
+	if (m_cancelled)
 	{
-		// Obtain the knots and multiplicities.
-		TColStd_Array1OfReal curveKnots = curve->Knots();
-		TColStd_Array1OfInteger curveMults = curve->Multiplicities();
+		m_compatible = false;
+		return false;
+	}
+	for (int k = 0; k < m_numCurves && m_options.collectMetrics; ++k)
+	{
+		countSectionWork(k);
+	}
 
-		for (Standard_Integer i = curveKnots.Lower(); i <= curveKnots.Upper(); ++i)
+	m_compatible = !failed;
+	if (failed)
+	{
+		try
+		{
+			throw Standard_Failure("Sections cannot be made compatible!");
+		}
+		catch (Standard_Failure& failure)
 		{
-			Standard_Real knot = curveKnots.Value(i);
-			Standard_Integer mult = curveMults.Value(i);
+			std::cerr << "Caught error: " << failure.GetMessageString() << std::endl;
+		}
+	}
+	return m_compatible;
+}
 
-			// If knot is existent, update its maximum mult.
-			if (knotMap.find(knot) != knotMap.end())
+void Skin::recompatibilize(int index, const Handle(Geom_BSplineCurve)& previous)
+{
+	m_bsplineSurface.Nullify();
+	m_cacheKey.clear();
+	m_cacheHit = false;
+	m_numCurves = static_cast<int>(m_curves.size());
+	m_cancelled = false;
+
+	// sections never made compatible, as after a cache hit, are computed by the next skin()
+	if (!m_compatible)
+	{
+		return;
+	}
+
+	// A lower maximum degree needs all sections again
+	Standard_Integer maxDegree = 0;
+	for (const auto& curve : m_curves)
+	{
+		maxDegree = std::max(maxDegree, curve->Degree());
+	}
+	if (m_curves.size() <= 1 || maxDegree != m_degreeU)
+	{
+		compatibilize();
+		return;
+	}
+
+	// If the new curve has no other knots than the sections and the replaced curve has no other knots than
+	// the new one, the merged knots stay the same and only the new section is made compatible.
+	double tolerance = m_options.knotTolerance;
+	if (index >= 0)
+	{
+		const Handle(Geom_BSplineCurve)& curve = m_curves[index];
+		TColStd_Array1OfInteger curveMults = elevatedMults(curve, m_degreeU);
+		if (nurbs::containsKnots(m_knotsU, m_multsU, curve->Knots(), curveMults, tolerance) && (previous.IsNull() ||
+			nurbs::containsKnots(curve->Knots(), curveMults, previous->Knots(), elevatedMults(previous, m_degreeU), tolerance)))
+		{
+			if (!compatibleSection(index))
 			{
-				knotMap[knot] = std::max(knotMap[knot], mult);
+				compatibilize();
 			}
-			else
+			else if (m_options.collectMetrics)
 			{
-				// The knot is not in map, insert it and its mult.
-				knotMap[knot] = mult;
+				countSectionWork(index);
 			}
+			return;
 		}
 	}
 
-	// Now knotMap stores all emerging knots and their maximum mults.
-	// Note that map sort automatically according to key values, i.e. knot values here.
-	Standard_Integer nbKnots = static_cast<Standard_Integer>(knotMap.size());
-	TColStd_Array1OfReal knots = TColStd_Array1OfReal(1, nbKnots);
-	TColStd_Array1OfInteger mults = TColStd_Array1OfInteger(1, nbKnots);
+	TColStd_Array1OfReal knots(1, 1);
+	TColStd_Array1OfInteger mults(1, 1);
+	mergeKnots(m_curves, m_degreeU, knots, mults);
 
-	// Copy the values in knotMap into knots and mults.
-	Standard_Integer index = 1;
-	for (const auto& [knot, mult] : knotMap)
+	// Knots cannot be removed from the sections, so they are made compatible again if a knot disappeared
+	if (!nurbs::containsKnots(knots, mults, m_knotsU, m_multsU, tolerance))
 	{
-		knots.SetValue(index, knot);
-		mults.SetValue(index, mult);
-		++index;
+		compatibilize();
+		return;
 	}
 
-	// Refinement for all curves.
-	for (auto& curve : curves)
+	// New knots are inserted into the other sections, they keep their poles otherwise
+	if (!nurbs::containsKnots(m_knotsU, m_multsU, knots, mults, tolerance))
 	{
-		curve->InsertKnots(knots, mults);
+		// the sections keep no weights, rational curves are refined from their input again
+		bool rational = std::any_of(m_curves.begin(), m_curves.end(), [](const Handle(Geom_BSplineCurve)& curve) { return curve->IsRational(); });
+		if (rational)
+		{
+			compatibilize();
+			return;
+		}
+
+		int numPoles = BSplCLib::NbPoles(m_degreeU, Standard_False, mults);
+		nurbs::ControlNet refined(m_numCurves, numPoles);
+		std::atomic<bool> failed{ false };
+		{
+			PhaseTimer timer(m_options.collectMetrics, m_metrics.compatibleMs);
+			forEachSection([&](int first, int last)
+			{
+				for (int k = first; k < last; ++k)
+				{
+					if (k != index && !nurbs::refinePoles(m_sections, k, m_degreeU, m_knotsU, m_multsU, knots, mults, tolerance, refined))
+					{
+						failed = true;
+					}
+				}
+			});
+		}
+		if (m_cancelled)
+		{
+			m_compatible = false;	// made compatible by the next skin()
+			return;
+		}
+		if (failed)
+		{
+			compatibilize();
+			return;
+		}
+		if (m_options.collectMetrics)
+		{
+			// every refined section receives the same new knots
+			long long numRefined = m_numCurves - (index >= 0 ? 1 : 0);
+			m_metrics.numInsertedKnots += numRefined * (sumOf(mults) - sumOf(m_multsU));
+		}
+
+		m_sections = std::move(refined);
+		m_knotsU = knots;
+		m_multsU = mults;
+		m_numControlPointsU = numPoles;
+	}
+
+	if (index >= 0 && !compatibleSection(index))
+	{
+		compatibilize();
+	}
+	else if (index >= 0 && m_options.collectMetrics)
+	{
+		countSectionWork(index);
 	}
 }
 
+TColStd_Array1OfInteger Skin::elevatedMults(const Handle(Geom_BSplineCurve)& curve, int degree) const
+{
+	// Increasing the degree by d keeps the knots and adds d to every multiplicity
+	TColStd_Array1OfInteger mults = curve->Multiplicities();
+	int increase = degree - curve->Degree();
+	for (int i = mults.Lower(); i <= mults.Upper() && increase > 0; ++i)
+	{
+		mults.SetValue(i, mults.Value(i) + increase);
+	}
+	return mults;
+}
+
+bool Skin::compatibleSection(int index)
+{
+	return nurbs::compatiblePoles(m_curves[index], m_degreeU, m_knotsU, m_multsU, m_options.knotTolerance, m_sections, index);
+}
+
+void Skin::countSectionWork(int index)
+{
+	// the raised curve has "increase" more multiplicity at each of its knots, the rest of the merged multiplicities is inserted
+	const Handle(Geom_BSplineCurve)& curve = m_curves[index];
+	int increase = m_degreeU - curve->Degree();
+	++m_metrics.numCompatibleSections;
+	m_metrics.numElevatedSections += increase > 0 ? 1 : 0;
+	m_metrics.degreeElevation += increase;
+	m_metrics.numInsertedKnots += sumOf(m_multsU) - sumOf(curve->Multiplicities()) - increase * curve->NbKnots();
+}
+
+void Skin::mergeKnots(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree, TColStd_Array1OfReal& knots,
+	TColStd_Array1OfInteger& mults)
+{
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.mergeKnotsMs);
+
+	// Merge the sorted knot sequences of all curves at once to obtain a common knot sequence and mult sequence.
+	// Knots which only differ by round-off are snapped together, otherwise each of them would add poles.
+	// The knots of the curves are read in place, only the multiplicities of elevated curves are copied.
+	std::vector<TColStd_Array1OfInteger> curveMults;
+	curveMults.reserve(std::count_if(curves.begin(), curves.end(), [degree](const Handle(Geom_BSplineCurve)& curve) { return curve->Degree() < degree; }));
+
+	std::vector<const TColStd_Array1OfReal*> knotPointers;
+	std::vector<const TColStd_Array1OfInteger*> multPointers;
+	knotPointers.reserve(curves.size());
+	multPointers.reserve(curves.size());
+	for (const auto& curve : curves)
+	{
+		knotPointers.push_back(&curve->Knots());
+		if (curve->Degree() < degree)
+		{
+			curveMults.push_back(elevatedMults(curve, degree));
+			multPointers.push_back(&curveMults.back());
+		}
+		else
+		{
+			multPointers.push_back(&curve->Multiplicities());
+		}
+	}
+
+	nurbs::mergeKnots(knotPointers, multPointers, m_options.knotTolerance, knots, mults, m_knotMergeReport);
+}
+
 void Skin::calculate()
 {
-	// calculate parameters at v direction with chord length parameterization method
-	nurbs::getChordParameterization(m_ControlPointsV, m_paramsV);
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.parameterizationMs);
+	util::TraceScope trace("parameterization", "skin");
+
+	// calculate parameters at v direction by the scheme of the options, chord length by default
+	nurbs::getParameterization(m_controlNet, m_options.parameterization, m_paramsV, m_options.numThreads, threadPool());
 
 	// calculate knot vector at v direction
 	nurbs::averageKnotVector(m_degreeV, m_paramsV, m_knotsV);
@@ -148,27 +632,456 @@ void Skin::calculate()
 
 void Skin::constructSurface()
 {
-	// calculate control points of B-spline surface
-	TColgp_Array2OfPnt poles(1, m_numControlPointsU, 1, m_numCurves);
-	
-	for (int i = 1; i <= m_numControlPointsU; ++i)
+	m_maxDeviation = 0.0;
+
+	// number of control points at v direction, the sections are interpolated unless fewer are requested
+	int numPolesV = m_numCurves;
+	nurbs::ControlNet approximation;
+	std::vector<double> knots;
+	double deviation = 0.0;
+	m_solveFit = 0;
+	m_numSolveFits = 1;
+
+	// with too few sections for the degree nothing is approximated, the interpolation fails on them
+	bool approximable = m_degreeV + 1 <= m_numCurves;
+	if (approximable && m_options.approximationPoles > 0)
+	{
+		numPolesV = std::clamp(m_options.approximationPoles, m_degreeV + 1, m_numCurves);
+		if (numPolesV < m_numCurves && !approximateSections(numPolesV, approximation, knots, deviation))
+		{
+			return;
+		}
+	}
+	else if (approximable && m_options.approximationTolerance > 0.0)
+	{
+		// bisection on the number of control points, the interpolation meets any tolerance
+		int lower = m_degreeV + 1, upper = m_numCurves;
+		nurbs::ControlNet trial;
+		std::vector<double> trialKnots;
+		double trialDeviation = 0.0;
+
+		// each fit takes a share of the Solve progress, at most one per halving and the interpolation may follow
+		for (int range = upper - lower; range > 0; range /= 2)
+		{
+			++m_numSolveFits;
+		}
+		while (lower < upper && !m_cancelled)
+		{
+			int middle = (lower + upper) / 2;
+			if (approximateSections(middle, trial, trialKnots, trialDeviation) && trialDeviation <= m_options.approximationTolerance)
+			{
+				upper = middle;
+				std::swap(approximation, trial);
+				std::swap(knots, trialKnots);
+				deviation = trialDeviation;
+			}
+			else
+			{
+				lower = middle + 1;
+			}
+			m_solveFit = std::min(m_solveFit + 1, m_numSolveFits - 1);
+		}
+		numPolesV = upper;
+	}
+
+	if (m_cancelled)
+	{
+		return;
+	}
+	if (numPolesV < m_numCurves)
+	{
+		m_controlNet = std::move(approximation);
+		m_knotsV = knots;
+		m_maxDeviation = deviation;
+	}
+	else
+	{
+		m_solveFit = m_numSolveFits - 1;
+		if (!interpolateSections() || m_cancelled)
+		{
+			return;
+		}
+	}
+
+	{
+		PhaseTimer timer(m_options.collectMetrics, m_metrics.surfaceMs);
+
+		// calculate control points of B-spline surface, the net is released before OCC copies them
+		TColgp_Array2OfPnt poles(1, m_numControlPointsU, 1, numPolesV);
+		m_controlNet.toArray2(poles);
+		m_controlNet.clear();
+
+		// convert m_knotsV to OCC form
+		TColStd_Array1OfReal geom_knotsV;
+		TColStd_Array1OfInteger geom_multsV;
+		util::convertKnots(m_knotsV, geom_knotsV, geom_multsV);
+
+		// construct skinning surface
+		m_bsplineSurface = new Geom_BSplineSurface(poles, m_knotsU, geom_knotsV, m_multsU, geom_multsV, m_degreeU, m_degreeV);
+	}
+
+	m_knotRemovalReport = KnotRemovalReport();
+	if (m_options.knotRemovalTolerance > 0.0)
+	{
+		PhaseTimer timer(m_options.collectMetrics, m_metrics.knotRemovalMs);
+		removeSurfaceKnots();
+	}
+
+	if (m_options.collectMetrics)
+	{
+		++m_metrics.numSurfaces;
+		m_metrics.degreeU = m_bsplineSurface->UDegree();
+		m_metrics.degreeV = m_bsplineSurface->VDegree();
+		m_metrics.numPolesU = m_bsplineSurface->NbUPoles();
+		m_metrics.numPolesV = m_bsplineSurface->NbVPoles();
+		m_metrics.numKnotsU = m_bsplineSurface->NbUKnots();
+		m_metrics.numKnotsV = m_bsplineSurface->NbVKnots();
+	}
+	reportProgress(SkinPhase::Surface, 1.0);
+}
+
+void Skin::removeSurfaceKnots()
+{
+	util::TraceScope trace("knot removal", "skin");
+	int numPolesU = m_bsplineSurface->NbUPoles();
+	int numPolesV = m_bsplineSurface->NbVPoles();
+	m_knotRemovalReport.numPolesUBefore = numPolesU;
+	m_knotRemovalReport.numPolesVBefore = numPolesV;
+
+	// flat knot vectors
+	auto flatKnots = [](const TColStd_Array1OfReal& knots, const TColStd_Array1OfInteger& mults)
+	{
+		std::vector<double> flat;
+		for (int i = knots.Lower(); i <= knots.Upper(); ++i)
+		{
+			flat.insert(flat.end(), mults.Value(i), knots.Value(i));
+		}
+		return flat;
+	};
+	std::vector<double> knotsU = flatKnots(m_bsplineSurface->UKnots(), m_bsplineSurface->UMultiplicities());
+	std::vector<double> knotsV = flatKnots(m_bsplineSurface->VKnots(), m_bsplineSurface->VMultiplicities());
+
+	// At u direction every row of the net at v is a curve, row i of the planes holds the i-th control points of all of them.
+	// Half of the tolerance is given to u direction so both directions can lose knots.
+	const TColgp_Array2OfPnt& surfacePoles = m_bsplineSurface->Poles();
+	nurbs::RowMatrix planes[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		planes[c].resize(numPolesU, numPolesV);
+	}
+	for (int i = 0; i < numPolesU; ++i)
+	{
+		for (int j = 0; j < numPolesV; ++j)
+		{
+			const gp_Pnt& point = surfacePoles.Value(surfacePoles.LowerRow() + i, surfacePoles.LowerCol() + j);
+			planes[0](i, j) = point.X();
+			planes[1](i, j) = point.Y();
+			planes[2](i, j) = point.Z();
+		}
+	}
+
+	std::vector<double> errorsU;
+	nurbs::removeKnots(m_degreeU, knotsU, planes, 0.5 * m_options.knotRemovalTolerance, errorsU, m_options.numThreads, threadPool());
+	double deviationU = errorsU.empty() ? 0.0 : *std::max_element(errorsU.begin(), errorsU.end());
+
+	// At v direction the columns are the curves, they may use the tolerance left by u direction
+	for (auto& plane : planes)
+	{
+		plane = nurbs::RowMatrix(plane.transpose());
+	}
+	std::vector<double> errorsV;
+	nurbs::removeKnots(m_degreeV, knotsV, planes, m_options.knotRemovalTolerance - deviationU, errorsV, m_options.numThreads, threadPool());
+	double deviationV = errorsV.empty() ? 0.0 : *std::max_element(errorsV.begin(), errorsV.end());
+
+	numPolesV = static_cast<int>(planes[0].rows());
+	numPolesU = static_cast<int>(planes[0].cols());
+	TColgp_Array2OfPnt poles(1, numPolesU, 1, numPolesV);
+	for (int i = 0; i < numPolesU; ++i)
+	{
+		for (int j = 0; j < numPolesV; ++j)
+		{
+			poles.SetValue(i + 1, j + 1, gp_Pnt(planes[0](j, i), planes[1](j, i), planes[2](j, i)));
+		}
+	}
+
+	TColStd_Array1OfReal geom_knotsU, geom_knotsV;
+	TColStd_Array1OfInteger geom_multsU, geom_multsV;
+	util::convertKnots(knotsU, geom_knotsU, geom_multsU);
+	util::convertKnots(knotsV, geom_knotsV, geom_multsV);
+	m_bsplineSurface = new Geom_BSplineSurface(poles, geom_knotsU, geom_knotsV, geom_multsU, geom_multsV, m_degreeU, m_degreeV);
+
+	m_knotRemovalReport.numPolesU = numPolesU;
+	m_knotRemovalReport.numPolesV = numPolesV;
+	m_knotRemovalReport.maxDeviation = deviationU + deviationV;
+}
+
+bool Skin::interpolateSections()
+{
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.solveMs);
+	util::TraceScope trace("interpolate sections", "skin");
+
+	// The coefficient matrix only depends on the parameters and knots at v direction, so it is factorized once
+	// and the coordinates of all columns of control points are solved together as right-hand sides.
+	nurbs::BandedMatrix coefficients;
+	nurbs::buildInterpolationMatrix(m_degreeV, m_paramsV, m_knotsV, coefficients);
+	if (!nurbs::factorBanded(coefficients))
+	{
+		try
+		{
+			throw Standard_Failure("Singular interpolation matrix!");
+		}
+		catch (Standard_Failure& failure)
+		{
+			std::cerr << "Caught error: " << failure.GetMessageString() << std::endl;
+		}
+		return false;
+	}
+
+	// The columns of the control net are the right-hand sides, they are replaced by the solution in place.
+	int numColumns = m_numControlPointsU;
+	Eigen::Map<nurbs::RowMatrix> planes[3] =
+	{
+		Eigen::Map<nurbs::RowMatrix>(m_controlNet.plane(0), m_numCurves, numColumns),
+		Eigen::Map<nurbs::RowMatrix>(m_controlNet.plane(1), m_numCurves, numColumns),
+		Eigen::Map<nurbs::RowMatrix>(m_controlNet.plane(2), m_numCurves, numColumns)
+	};
+
+	// solve x, y and z of the column blocks [first, last)
+	forEachBlock([&](int first, int last)
+	{
+		for (int block = first; block < last; ++block)
+		{
+			int firstCol = block * columnBlock;
+			int numCols = std::min(columnBlock, numColumns - firstCol);
+			for (auto& plane : planes)
+			{
+				nurbs::solveBanded(coefficients, plane, firstCol, numCols);
+			}
+		}
+	});
+
+	return true;
+}
+
+bool Skin::approximateSections(int numPolesV, nurbs::ControlNet& net, std::vector<double>& knots, double& maxDeviation)
+{
+	PhaseTimer timer(m_options.collectMetrics, m_metrics.solveMs);
+	util::TraceScope trace("approximate sections", "skin");
+	m_metrics.numFits += m_options.collectMetrics ? 1 : 0;
+
+	// NURBS book 9.4.1: the first and last control points interpolate the end sections and the inner ones
+	// minimize the squared distances to the inner sections, (N^T N) P = N^T R.
+	int m = m_numCurves - 1;
+	int n = numPolesV - 1;
+	int degree = m_degreeV;
+
+	nurbs::approximationKnotVector(degree, numPolesV, m_paramsV, knots);
+	nurbs::BandedMatrix normal;
+	nurbs::buildNormalMatrix(degree, numPolesV, m_paramsV, knots, normal);
+	if (!nurbs::factorBanded(normal))
+	{
+		try
+		{
+			throw Standard_Failure("Singular least-squares matrix!");
+		}
+		catch (Standard_Failure& failure)
+		{
+			std::cerr << "Caught error: " << failure.GetMessageString() << std::endl;
+		}
+		return false;
+	}
+
+	// basis functions at all parameters, row k holds the ones of the span of the k-th parameter
+	std::vector<int> spans(m + 1);
+	std::vector<double> basis(static_cast<size_t>(m + 1) * (degree + 1));
+	for (int k = 0; k <= m; ++k)
+	{
+		spans[k] = nurbs::findSpan(degree, knots, m_paramsV[k]);
+		nurbs::calcBasisFunctions(spans[k], degree, knots.data(), m_paramsV[k], &basis[static_cast<size_t>(k) * (degree + 1)]);
+	}
+
+	int numColumns = m_numControlPointsU;
+	net.resize(numPolesV, numColumns);
+	Eigen::Map<const nurbs::RowMatrix> points[3] =
 	{
-		TColgp_Array1OfPnt controlPoints(1, m_numCurves);
-		nurbs::curveInterpolation(m_paramsV, m_knotsV, m_ControlPointsV[i - 1], controlPoints);
+		Eigen::Map<const nurbs::RowMatrix>(m_controlNet.plane(0), m_numCurves, numColumns),
+		Eigen::Map<const nurbs::RowMatrix>(m_controlNet.plane(1), m_numCurves, numColumns),
+		Eigen::Map<const nurbs::RowMatrix>(m_controlNet.plane(2), m_numCurves, numColumns)
+	};
+	Eigen::Map<nurbs::RowMatrix> poles[3] =
+	{
+		Eigen::Map<nurbs::RowMatrix>(net.plane(0), numPolesV, numColumns),
+		Eigen::Map<nurbs::RowMatrix>(net.plane(1), numPolesV, numColumns),
+		Eigen::Map<nurbs::RowMatrix>(net.plane(2), numPolesV, numColumns)
+	};
 
-		for (int j = 1; j <= m_numCurves; ++j)
+	// fit x, y and z of the column blocks [first, last), the deviation of each block is kept apart
+	// so the maximum is the same whatever the number of threads
+	int numBlocks = (numColumns + columnBlock - 1) / columnBlock;
+	std::vector<double> deviations(numBlocks, 0.0);
+	forEachBlock([&](int first, int last)
+	{
+		for (int block = first; block < last; ++block)
 		{
-			poles.SetValue(i, j, controlPoints.Value(j));
+			int firstCol = block * columnBlock;
+			int numCols = std::min(columnBlock, numColumns - firstCol);
+
+			for (int c = 0; c < 3; ++c)
+			{
+				auto Q = points[c].middleCols(firstCol, numCols);
+				auto P = poles[c].middleCols(firstCol, numCols);
+				P.row(0) = Q.row(0);
+				P.row(n) = Q.row(m);
+
+				// R_k = Q_k - N_0(v_k) Q_0 - N_n(v_k) Q_m is distributed to the rows of N^T R
+				nurbs::RowMatrix rhs = nurbs::RowMatrix::Zero(n - 1, numCols);
+				Eigen::RowVectorXd residual(numCols);
+				for (int k = 1; k < m; ++k)
+				{
+					const double* values = &basis[static_cast<size_t>(k) * (degree + 1)];
+					int firstPole = spans[k] - degree;
+					residual = Q.row(k);
+					if (firstPole == 0)
+					{
+						residual -= values[0] * Q.row(0);
+					}
+					if (spans[k] == n)
+					{
+						residual -= values[degree] * Q.row(m);
+					}
+					for (int a = 0; a <= degree; ++a)
+					{
+						int i = firstPole + a;
+						if (i >= 1 && i <= n - 1)
+						{
+							rhs.row(i - 1) += values[a] * residual;
+						}
+					}
+				}
+
+				nurbs::solveBanded(normal, rhs);
+				P.middleRows(1, n - 1) = rhs;
+			}
+
+			// distance between the sections and the fitted columns at the parameters
+			Eigen::RowVectorXd distance(numCols), coordinate(numCols);
+			for (int k = 0; k <= m; ++k)
+			{
+				const double* values = &basis[static_cast<size_t>(k) * (degree + 1)];
+				int firstPole = spans[k] - degree;
+				distance.setZero();
+				for (int c = 0; c < 3; ++c)
+				{
+					coordinate = -points[c].row(k).segment(firstCol, numCols);
+					for (int a = 0; a <= degree; ++a)
+					{
+						coordinate += values[a] * poles[c].row(firstPole + a).segment(firstCol, numCols);
+					}
+					distance += coordinate.cwiseAbs2();
+				}
+				deviations[block] = std::max(deviations[block], std::sqrt(distance.maxCoeff()));
+			}
 		}
+	});
+
+	maxDeviation = deviations.empty() ? 0.0 : *std::max_element(deviations.begin(), deviations.end());
+	return true;
+}
+
+bool Skin::isCancelled() const
+{
+	return m_cancelled;
+}
+
+bool Skin::reportProgress(SkinPhase phase, double fraction)
+{
+	if (!m_options.progress || m_cancelled)
+	{
+		return !m_cancelled;
 	}
 
-	// convert m_knotsV to OCC form
-	TColStd_Array1OfReal geom_knotsV;
-	TColStd_Array1OfInteger geom_multsV;
-	util::convertKnots(m_knotsV, geom_knotsV, geom_multsV);
+	std::lock_guard<std::mutex> lock(m_progressMutex);
+	if (!m_cancelled && !m_options.progress(phase, fraction))
+	{
+		m_cancelled = true;
+	}
+	return !m_cancelled;
+}
 
-	// construct skinning surface
-	m_bsplineSurface = new Geom_BSplineSurface(poles, m_knotsU, geom_knotsV, m_multsU, geom_multsV, m_degreeU, m_degreeV);
+void Skin::forEachBlock(const std::function<void(int, int)>& func)
+{
+	int numBlocks = (m_numControlPointsU + columnBlock - 1) / columnBlock;
+	std::atomic<int> numDone{ 0 };
+	auto tracedFunc = [&](int first, int last)
+	{
+		if (m_cancelled)
+		{
+			return;
+		}
+		util::TraceScope trace("column blocks", "skin");
+		func(first, last);
+		numDone += last - first;
+		reportProgress(SkinPhase::Solve, (m_solveFit + static_cast<double>(numDone) / numBlocks) / m_numSolveFits);
+	};
+	if (util::ThreadPool* pool = threadPool())
+	{
+		pool->parallelFor(0, numBlocks, 1, tracedFunc);
+	}
+	else
+	{
+		// block by block so the progress advances and a cancellation stops in the middle
+		for (int block = 0; block < numBlocks; ++block)
+		{
+			tracedFunc(block, block + 1);
+		}
+	}
+}
+
+void Skin::forEachSection(const std::function<void(int, int)>& func)
+{
+	std::atomic<int> numDone{ 0 };
+	auto tracedFunc = [&](int first, int last)
+	{
+		if (m_cancelled)
+		{
+			return;
+		}
+		util::TraceScope trace("section blocks", "skin");
+		func(first, last);
+		numDone += last - first;
+		reportProgress(SkinPhase::Compatibility, static_cast<double>(numDone) / m_numCurves);
+	};
+	util::ThreadPool* pool = m_numCurves < 2 * sectionBlock ? nullptr : threadPool();
+	if (pool)
+	{
+		pool->parallelFor(0, m_numCurves, sectionBlock, tracedFunc);
+	}
+	else
+	{
+		for (int first = 0; first < m_numCurves; first += sectionBlock)
+		{
+			tracedFunc(first, std::min(m_numCurves, first + sectionBlock));
+		}
+	}
+}
+
+util::ThreadPool* Skin::threadPool()
+{
+	if (m_options.pool)
+	{
+		return m_options.pool.get();
+	}
+	if (m_options.numThreads == 1)
+	{
+		return nullptr;
+	}
+
+	// the threads are started once per Skin rather than once per phase
+	if (!m_ownPool)
+	{
+		m_ownPool = std::make_unique<util::ThreadPool>(m_options.numThreads);
+	}
+	return m_ownPool.get();
 }
 
 const Handle(Geom_BSplineSurface) Skin::getSurface() const
@@ -177,3 +1090,23 @@ const Handle(Geom_BSplineSurface) Skin::getSurface() const
 }
 
 
+
+const nurbs::KnotMergeReport& Skin::getKnotMergeReport() const
+{
+	return m_knotMergeReport;
+}
+
+bool Skin::isCacheHit() const
+{
+	return m_cacheHit;
+}
+
+double Skin::getMaxDeviation() const
+{
+	return m_maxDeviation;
+}
+
+const KnotRemovalReport& Skin::getKnotRemovalReport() const
+{
+	return m_knotRemovalReport;
+}
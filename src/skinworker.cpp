@@ -0,0 +1,123 @@
+#include "skinworker.h"
+#include "trace.h"
+
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <Standard_Failure.hxx>
+
+SkinWorker::SkinWorker(QObject* parent)
+	: QObject{ parent }, m_running{ false }, m_cancel{ false }
+{
+}
+
+SkinWorker::~SkinWorker()
+{
+	cancel();
+	wait();
+}
+
+bool SkinWorker::start(const std::vector<Handle(Geom_BSplineCurve)>& curves, int degree, const SkinOptions& options)
+{
+	if (m_running)
+	{
+		return false;
+	}
+
+	// the thread of the last skinning has posted its result already
+	wait();
+	m_cancel = false;
+	m_running = true;
+	m_thread = std::thread(&SkinWorker::run, this, curves, degree, options);
+	return true;
+}
+
+void SkinWorker::cancel()
+{
+	m_cancel = true;
+}
+
+bool SkinWorker::isRunning() const
+{
+	return m_running;
+}
+
+void SkinWorker::wait()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void SkinWorker::run(std::vector<Handle(Geom_BSplineCurve)> curves, int degree, SkinOptions options)
+{
+	util::trace::setThreadName("skin worker");
+	options.keepSections = false;	// the Skin is never edited
+
+	// a report is posted when the percentage changes, the Skin serializes the calls
+	int lastPhase = -1;
+	int lastPercent = -1;
+	options.progress = [&](SkinPhase phase, double fraction)
+	{
+		int percent = static_cast<int>(fraction * 100.0);
+		if (static_cast<int>(phase) != lastPhase || percent != lastPercent)
+		{
+			lastPhase = static_cast<int>(phase);
+			lastPercent = percent;
+			QString name = QString::fromLatin1(skinPhaseName(phase));
+			QMetaObject::invokeMethod(this, [this, name, percent]() { emit progress(name, percent); }, Qt::QueuedConnection);
+		}
+		return !m_cancel;
+	};
+
+	TopoDS_Shape face;
+	QString error;
+	bool wasCancelled = false;
+	try
+	{
+		Handle(Geom_BSplineSurface) surface;
+		{
+			util::TraceScope trace("Viewer::skin", "skin");
+			Skin skin(curves, degree, options);
+			skin.skin();
+			surface = skin.getSurface();
+			wasCancelled = skin.isCancelled();
+		}
+
+		if (!wasCancelled && surface.IsNull())
+		{
+			error = "Skinning failed!";
+		}
+		else if (!wasCancelled)
+		{
+			util::TraceScope trace("BRepBuilderAPI_MakeFace", "geometry");
+			face = BRepBuilderAPI_MakeFace(surface, Precision::Confusion());
+		}
+		wasCancelled = wasCancelled || m_cancel;
+	}
+	catch (Standard_Failure& failure)
+	{
+		error = failure.GetMessageString();
+	}
+	catch (const std::exception& failure)
+	{
+		error = failure.what();
+	}
+
+	// only the owning thread touches the face from now on, a cancel() made while the result waited in the queue wins
+	QMetaObject::invokeMethod(this, [this, face, error, wasCancelled]()
+	{
+		m_running = false;
+		if (wasCancelled || m_cancel)
+		{
+			emit cancelled();
+		}
+		else if (!error.isEmpty())
+		{
+			emit failed(error);
+		}
+		else
+		{
+			emit finished(face);
+		}
+	}, Qt::QueuedConnection);
+}
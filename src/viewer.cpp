@@ -1,4 +1,5 @@
 #include "viewer.h"
+#include "trace.h"
 
 #include <Aspect_DisplayConnection.hxx>
 #include <OpenGl_GraphicDriver.hxx>
@@ -9,9 +10,9 @@
 #include <AIS_Triangulation.hxx>
 #include <Aspect_ScrollDelta.hxx>
 #include <Aspect_VKeyFlags.hxx>
-#include <BRepBuilderAPI_MakeFace.hxx>
 
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QPaintEvent>
 #include <QResizeEvent>
@@ -150,6 +151,13 @@ Viewer::Viewer(QWidget* parent)
     this->setAttribute(Qt::WA_NoSystemBackground, true);
     this->setAttribute(Qt::WA_PaintOnScreen, true);
 
+    // the worker signals in the GUI thread, so the slots may display
+    m_skinWorker = new SkinWorker(this);
+    connect(m_skinWorker, &SkinWorker::progress, this, &Viewer::onSkinProgress);
+    connect(m_skinWorker, &SkinWorker::finished, this, &Viewer::onSkinFinished);
+    connect(m_skinWorker, &SkinWorker::failed, this, &Viewer::onSkinFailed);
+    connect(m_skinWorker, &SkinWorker::cancelled, this, &Viewer::onSkinCancelled);
+
     init();
 }
 
@@ -176,6 +184,7 @@ void Viewer::init()
 
     // AIS context
     m_context = new AIS_InteractiveContext(m_viewer);
+    m_displayList = std::make_unique<util::DisplayList>(m_context);
 
     // Configure some global props
     const Handle(Prs3d_Drawer)& contextDrawer = m_context->DefaultDrawer();
@@ -189,6 +198,9 @@ void Viewer::init()
 
         // Fix for infinite lines has been reduced to 1000 from its default value 500000.
         contextDrawer->SetMaximalParameterValue(1000);
+
+        // the presentations use the meshes of m_meshCache and never mesh by themselves
+        contextDrawer->SetAutoTriangulation(false);
     }
 
     // Main view creation
@@ -227,6 +239,7 @@ void Viewer::paintEvent(QPaintEvent* event)
     // Very Necessary!!!
     if (!m_view.IsNull())
     {
+        util::TraceScope trace("Viewer::paintEvent", "viewer");
         m_view->Invalidate();
         FlushViewEvents(m_context, m_view, true);
     }
@@ -379,7 +392,7 @@ QPaintEngine* Viewer::paintEngine() const
 void Viewer::open()
 {
     QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "", 
-        tr("All Files (*);;Step Files (*.stp *.step);;Iges Files(*.igs *.iges)"));
+        tr("All Files (*);;Step Files (*.stp *.step);;Iges Files(*.igs *.iges);;Native Files (*.nrb)"));
     if (fileName.isEmpty())
     {
         return;
@@ -424,11 +437,32 @@ void Viewer::save()
 
 void Viewer::clear()
 {
+    cancelSkin();   // its face would come back otherwise
     m_bsplineCurves.clear();
     m_shapes.clear();
+    m_displayList->clear();
+    m_meshCache.clear();
     m_context->RemoveAll(Standard_True);    // remove visualization objects
 }
 
+void Viewer::setMeshDeflection()
+{
+    util::MeshOptions options = m_meshCache.options();
+    bool ok = false;
+    double deflection = QInputDialog::getDouble(this, "Mesh Deflection", "Deflection relative to the size of each face:",
+        options.linearDeflection, 1.0e-5, 0.1, 5, &ok);
+    if (!ok || deflection == options.linearDeflection)
+    {
+        return;
+    }
+
+    // every shape is meshed again and gets a new presentation with its new mesh
+    options.linearDeflection = deflection;
+    m_meshCache.setOptions(options);
+    m_displayList->clear();
+    updateView();
+}
+
 void Viewer::skin()
 {
     if (m_bsplineCurves.empty())
@@ -437,39 +471,71 @@ void Viewer::skin()
         return;
     }
 
-    // skin
-    int degree = 3;
-    Skin skin(m_bsplineCurves, degree);
-    skin.skin();
-    Handle(Geom_BSplineSurface) surface = skin.getSurface();
-    if (!surface.IsNull())
+    if (m_skinWorker->isRunning())
     {
-        std::cout << "successful!" << std::endl;
+        showMessage("Skinning is running, cancel it first");
+        return;
     }
-    else
+
+    // skin on the worker, the face is displayed by onSkinFinished
+    int degree = 3;
+    m_skinWorker->start(m_bsplineCurves, degree);
+    showMessage("Skinning...");
+}
+
+void Viewer::cancelSkin()
+{
+    if (m_skinWorker->isRunning())
     {
-        std::cout << "failed!" << std::endl;
+        m_skinWorker->cancel();
+        showMessage("Cancelling skinning...");
     }
-    TopoDS_Shape face = BRepBuilderAPI_MakeFace(surface, Precision::Confusion());
+}
+
+void Viewer::onSkinProgress(const QString& phase, int percent)
+{
+    showMessage(QString("Skinning: %1 %2%").arg(phase).arg(percent));
+}
+
+void Viewer::onSkinFinished(const TopoDS_Shape& face)
+{
+    std::cout << "successful!" << std::endl;
+    showMessage("Skinning finished");
 
     this->operator<<(face);
 
     updateView();
 }
 
+void Viewer::onSkinFailed(const QString& message)
+{
+    std::cout << "failed!" << std::endl;
+    showMessage(message);
+}
+
+void Viewer::onSkinCancelled()
+{
+    showMessage("Skinning cancelled");
+}
+
 void Viewer::updateView()
 {
-    m_context->RemoveAll(Standard_True);
-    for (auto& sh : m_shapes)
-    {
-        Handle(AIS_Shape) shape = new AIS_Shape(sh);
-        m_context->SetDisplayMode(shape, AIS_Shaded, Standard_True);
-        m_context->Display(shape, Standard_True);
-    }
+    util::TraceScope trace("Viewer::updateView", "viewer");
+
+    // the new shapes are meshed together on all cores, then only they are displayed and the viewer is redrawn once
+    int numMeshed = m_meshCache.mesh(m_shapes);
+    m_displayList->sync(m_shapes, AIS_Shaded);
+    m_context->UpdateCurrentViewer();
 
     fitView();
     m_view->MustBeResized();
     ::AdjustSelectionStyle(m_context);
+
+    if (numMeshed > 0)
+    {
+        showMessage(QString("Meshed %1 shapes, mesh cache: %2 shapes, %3 MB").arg(numMeshed).arg(m_meshCache.size())
+            .arg(m_meshCache.memoryBytes() / (1024.0 * 1024.0), 0, 'f', 2));
+    }
 }
 
 TopoDS_Shape Viewer::getShape()
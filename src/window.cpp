@@ -36,9 +36,9 @@ void Window::init()
 	std::vector<QString> file_actionNames =
 	{"Open", "Save"};
 	std::vector<QString> edit_actionNames =
-	{"Clear"};
+	{"Clear", "Mesh Deflection"};
 	std::vector<QString> surface_actionNames =
-	{"Skin"};
+	{"Skin", "Cancel"};
 	
 	process(file_actionNames, m_fileActions, m_fileMenu);
 	process(edit_actionNames, m_editActions, m_editMenu);
@@ -48,7 +48,9 @@ void Window::init()
 	connect(m_fileActions[0], &QAction::triggered, m_viewer, &Viewer::open);
 	connect(m_fileActions[1], &QAction::triggered, m_viewer, &Viewer::save);
 	connect(m_editActions[0], &QAction::triggered, m_viewer, &Viewer::clear);
+	connect(m_editActions[1], &QAction::triggered, m_viewer, &Viewer::setMeshDeflection);
 	connect(m_surfaceActions[0], &QAction::triggered, m_viewer, &Viewer::skin);
+	connect(m_surfaceActions[1], &QAction::triggered, m_viewer, &Viewer::cancelSkin);
 }
 
 
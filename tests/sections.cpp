@@ -0,0 +1,34 @@
+#include "sections.h"
+
+#include <cmath>
+#include <TColgp_Array1OfPnt.hxx>
+#include <TColStd_Array1OfReal.hxx>
+#include <TColStd_Array1OfInteger.hxx>
+
+std::vector<Handle(Geom_BSplineCurve)> test::makeSections(int numSections, int numPoles, int degree)
+{
+	int numKnots = numPoles - degree + 1;
+	TColStd_Array1OfReal knots(1, numKnots);
+	TColStd_Array1OfInteger mults(1, numKnots);
+	for (int i = 1; i <= numKnots; ++i)
+	{
+		knots.SetValue(i, static_cast<double>(i - 1) / (numKnots - 1));
+		mults.SetValue(i, 1);
+	}
+	mults.SetValue(1, degree + 1);
+	mults.SetValue(numKnots, degree + 1);
+
+	std::vector<Handle(Geom_BSplineCurve)> curves;
+	for (int j = 0; j < numSections; ++j)
+	{
+		TColgp_Array1OfPnt poles(1, numPoles);
+		for (int i = 1; i <= numPoles; ++i)
+		{
+			double x = static_cast<double>(i - 1) / (numPoles - 1) * 10.0;
+			double y = std::sin(0.7 * x + 0.3 * j);
+			poles.SetValue(i, gp_Pnt(x, y, static_cast<double>(j)));
+		}
+		curves.emplace_back(new Geom_BSplineCurve(poles, knots, mults, degree));
+	}
+	return curves;
+}
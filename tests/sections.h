@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector>
+#include <Geom_BSplineCurve.hxx>
+
+namespace test
+{
+	// numSections wavy sections of numPoles poles and the same knots, stacked along z
+	std::vector<Handle(Geom_BSplineCurve)> makeSections(int numSections, int numPoles, int degree);
+};
@@ -0,0 +1,72 @@
+#include "skinworker.h"
+#include "sections.h"
+
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QTimer>
+
+namespace
+{
+	// Outcome of one skinning, filled by the signals of the worker
+	struct Outcome
+	{
+		bool finished = false;
+		bool failed = false;
+		bool cancelled = false;
+		bool timedOut = false;
+		int numProgress = 0;
+		TopoDS_Shape face;
+		QString message;
+	};
+
+	// start a skinning, cancel it right away if asked, and run the event loop until the worker signals its end
+	Outcome run(QCoreApplication& app, bool cancel)
+	{
+		Outcome outcome;
+		SkinWorker worker;
+		QObject::connect(&worker, &SkinWorker::progress, [&](const QString&, int) { ++outcome.numProgress; });
+		QObject::connect(&worker, &SkinWorker::finished, [&](const TopoDS_Shape& face) { outcome.finished = true; outcome.face = face; app.quit(); });
+		QObject::connect(&worker, &SkinWorker::failed, [&](const QString& message) { outcome.failed = true; outcome.message = message; app.quit(); });
+		QObject::connect(&worker, &SkinWorker::cancelled, [&]() { outcome.cancelled = true; app.quit(); });
+
+		QTimer timeout;
+		timeout.setSingleShot(true);
+		QObject::connect(&timeout, &QTimer::timeout, [&]() { outcome.timedOut = true; app.quit(); });
+		timeout.start(30000);
+
+		worker.start(test::makeSections(32, 256, 3), 3);
+		if (cancel)
+		{
+			worker.cancel();
+		}
+		app.exec();
+		return outcome;
+	}
+
+	bool check(bool condition, const char* what)
+	{
+		std::cout << (condition ? "ok     " : "FAILED ") << what << std::endl;
+		return condition;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// the worker only needs Qt Core, the offscreen platform keeps the test headless wherever it runs
+	qputenv("QT_QPA_PLATFORM", "offscreen");
+	QCoreApplication app(argc, argv);
+
+	bool passed = true;
+
+	Outcome skinned = run(app, false);
+	passed = check(skinned.finished && !skinned.face.IsNull(), "finished with a face") && passed;
+	passed = check(skinned.numProgress > 0, "progress reported") && passed;
+	passed = check(!skinned.failed && !skinned.cancelled && !skinned.timedOut, "no other signal") && passed;
+
+	Outcome cancelled = run(app, true);
+	passed = check(cancelled.cancelled, "cancelled after an immediate cancel()") && passed;
+	passed = check(!cancelled.finished && !cancelled.failed && !cancelled.timedOut, "no other signal") && passed;
+
+	return passed ? 0 : 1;
+}
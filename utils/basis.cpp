@@ -0,0 +1,76 @@
+#include "utils.h"
+#include "basis.h"
+#include "lanes.h"
+
+namespace
+{
+	// Algorithm A2.2 of The NURBS Book on Lanes::width parameters at once, each lane follows exactly the scalar operations
+	template <class Lanes>
+	void basisFunctionsLanes(int degree, const double* knots, const double* params, const int* spans, int count, double* basisFuns)
+	{
+		using Real = typename Lanes::Real;
+		Real left[nurbs::maxBasisDegree + 1], right[nurbs::maxBasisDegree + 1], values[nurbs::maxBasisDegree + 1];
+
+		Real u = Lanes::load(params);
+		values[0] = Lanes::set1(1.0);
+
+		for (int j = 1; j <= degree; j++)
+		{
+			left[j] = Lanes::sub(u, Lanes::gather(knots, spans, 1 - j));
+			right[j] = Lanes::sub(Lanes::gather(knots, spans, j), u);
+			Real saved = Lanes::set1(0.0);
+			for (int r = 0; r < j; r++)
+			{
+				Real temp = Lanes::div(values[r], Lanes::add(right[r + 1], left[j - r]));
+				values[r] = Lanes::add(saved, Lanes::mul(right[r + 1], temp));
+				saved = Lanes::mul(left[j - r], temp);
+			}
+			values[j] = saved;
+		}
+
+		for (int k = 0; k <= degree; ++k)
+		{
+			Lanes::store(basisFuns + static_cast<size_t>(k) * count, values[k]);
+		}
+	}
+}
+
+void nurbs::calcBasisFunctionsBatch(int degree, const std::vector<double>& knots, const double* params, int count,
+	int* spans, double* basisFuns)
+{
+	if (degree > maxBasisDegree)
+	{
+		throw Standard_OutOfRange("Degree of basis functions out of range!");
+	}
+
+	// dense samples are usually sorted, so the span of the previous parameter is tried before searching
+	const double* knotData = knots.data();
+	int numKnots = static_cast<int>(knots.size());
+	int n = numKnots - degree - 2;
+	int span = -1;
+	for (int i = 0; i < count; ++i)
+	{
+		double u = params[i];
+		if (span < degree || span >= n || u < knotData[span] || u >= knotData[span + 1])
+		{
+			span = findSpan(degree, knotData, numKnots, u);
+		}
+		spans[i] = span;
+	}
+
+	// full vector lanes, then the remaining parameters one by one
+	int i = 0;
+	for (; i + VectorLanes::width <= count; i += VectorLanes::width)
+	{
+		basisFunctionsLanes<VectorLanes>(degree, knotData, params + i, spans + i, count, basisFuns + i);
+	}
+	for (; i < count; ++i)
+	{
+		basisFunctionsLanes<ScalarLanes>(degree, knotData, params + i, spans + i, count, basisFuns + i);
+	}
+}
+
+int nurbs::batchLaneWidth()
+{
+	return VectorLanes::width;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <Standard_OutOfRange.hxx>
+
+namespace nurbs
+{
+	// largest degree handled with stack storage, the maximum degree of OCC B-splines
+	constexpr int maxBasisDegree = 25;
+
+	// Find the span of u in the complete knot vector of numKnots knots
+	inline int findSpan(int degree, const double* knots, int numKnots, double u)
+	{
+		int n = numKnots - degree - 2;
+
+		if (u == knots[n + 1])
+		{
+			return n;
+		}
+
+		return static_cast<int>(std::upper_bound(knots + degree, knots + n + 1, u) - knots) - 1;
+	}
+
+	// Nonvanishing basis functions of a degree known at compile time, the loops are fully unrolled
+	template <int Degree>
+	inline void basisFunctions(int span, const double* knots, double u, double* basisFuns)
+	{
+		double left[Degree + 1], right[Degree + 1];
+		basisFuns[0] = 1.0;
+
+		for (int j = 1; j <= Degree; j++)
+		{
+			left[j] = u - knots[span + 1 - j];
+			right[j] = knots[span + j] - u;
+			double saved = 0.0;
+			for (int r = 0; r < j; r++)
+			{
+				double temp = basisFuns[r] / (right[r + 1] + left[j - r]);
+				basisFuns[r] = saved + right[r + 1] * temp;
+				saved = left[j - r] * temp;
+			}
+			basisFuns[j] = saved;
+		}
+	}
+
+	// Nonvanishing basis functions of any degree up to maxBasisDegree, with stack storage
+	inline void basisFunctionsAnyDegree(int span, int degree, const double* knots, double u, double* basisFuns)
+	{
+		if (degree > maxBasisDegree)
+		{
+			throw Standard_OutOfRange("Degree of basis functions out of range!");
+		}
+
+		double left[maxBasisDegree + 1], right[maxBasisDegree + 1];
+		basisFuns[0] = 1.0;
+
+		for (int j = 1; j <= degree; j++)
+		{
+			left[j] = u - knots[span + 1 - j];
+			right[j] = knots[span + j] - u;
+			double saved = 0.0;
+			for (int r = 0; r < j; r++)
+			{
+				double temp = basisFuns[r] / (right[r + 1] + left[j - r]);
+				basisFuns[r] = saved + right[r + 1] * temp;
+				saved = left[j - r] * temp;
+			}
+			basisFuns[j] = saved;
+		}
+	}
+
+	// Dispatch to the kernel specialized on degree, degrees above 7 use the generic kernel
+	inline void basisFunctions(int span, int degree, const double* knots, double u, double* basisFuns)
+	{
+		switch (degree)
+		{
+		case 0: basisFunctions<0>(span, knots, u, basisFuns); break;
+		case 1: basisFunctions<1>(span, knots, u, basisFuns); break;
+		case 2: basisFunctions<2>(span, knots, u, basisFuns); break;
+		case 3: basisFunctions<3>(span, knots, u, basisFuns); break;
+		case 4: basisFunctions<4>(span, knots, u, basisFuns); break;
+		case 5: basisFunctions<5>(span, knots, u, basisFuns); break;
+		case 6: basisFunctions<6>(span, knots, u, basisFuns); break;
+		case 7: basisFunctions<7>(span, knots, u, basisFuns); break;
+		default: basisFunctionsAnyDegree(span, degree, knots, u, basisFuns); break;
+		}
+	}
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace util
+{
+	// Queue of at most "capacity" items between threads, push waits while it is full and pop while it is empty.
+	// Once closed, push fails and pop returns the items left, then fails.
+	template <typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(size_t capacity)
+			: m_capacity{ capacity > 0 ? capacity : 1 }, m_closed{ false }
+		{
+		}
+
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		// false if the queue was closed, the item is then dropped
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_notFull.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+			if (m_closed)
+			{
+				return false;
+			}
+			m_items.emplace_back(std::move(item));
+			lock.unlock();
+			m_notEmpty.notify_one();
+			return true;
+		}
+
+		// false once the queue is closed and empty
+		bool pop(T& item)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_notEmpty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+			if (m_items.empty())
+			{
+				return false;
+			}
+			item = std::move(m_items.front());
+			m_items.pop_front();
+			lock.unlock();
+			m_notFull.notify_one();
+			return true;
+		}
+
+		// wake every waiting thread, no item is accepted afterwards
+		void close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_closed = true;
+			}
+			m_notFull.notify_all();
+			m_notEmpty.notify_all();
+		}
+
+		size_t capacity() const
+		{
+			return m_capacity;
+		}
+
+	private:
+		size_t m_capacity;
+		bool m_closed;
+		std::deque<T> m_items;
+		std::mutex m_mutex;
+		std::condition_variable m_notFull;
+		std::condition_variable m_notEmpty;
+	};
+};
@@ -0,0 +1,334 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <GeomTools.hxx>
+
+namespace
+{
+	const char* cacheHeader = "SkinCache 2";
+	const char* cacheExtension = ".geom";
+
+	inline uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t fmix(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	// little-endian word whatever the byte order of the machine
+	inline uint64_t readWord(const unsigned char* bytes, size_t size)
+	{
+		uint64_t word = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			word |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+		}
+		return word;
+	}
+
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+}
+
+util::Hasher::Hasher()
+	: m_h1{ 0 }, m_h2{ 0 }, m_length{ 0 }, m_buffered{ 0 }
+{
+}
+
+void util::Hasher::add(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_length += size;
+
+	// complete the pending block first
+	if (m_buffered > 0)
+	{
+		size_t count = std::min(size, 16 - m_buffered);
+		std::memcpy(m_buffer + m_buffered, bytes, count);
+		m_buffered += count;
+		bytes += count;
+		size -= count;
+		if (m_buffered < 16)
+		{
+			return;
+		}
+		addBlock(m_buffer);
+		m_buffered = 0;
+	}
+
+	for (; size >= 16; bytes += 16, size -= 16)
+	{
+		addBlock(bytes);
+	}
+
+	std::memcpy(m_buffer, bytes, size);
+	m_buffered = size;
+}
+
+void util::Hasher::add(int value)
+{
+	unsigned char bytes[4];
+	uint32_t bits = static_cast<uint32_t>(value);
+	for (int i = 0; i < 4; ++i)
+	{
+		bytes[i] = static_cast<unsigned char>(bits >> (8 * i));
+	}
+	add(bytes, 4);
+}
+
+void util::Hasher::add(double value)
+{
+	value = value == 0.0 ? 0.0 : value;
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	unsigned char bytes[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		bytes[i] = static_cast<unsigned char>(bits >> (8 * i));
+	}
+	add(bytes, 8);
+}
+
+void util::Hasher::addBlock(const unsigned char* block)
+{
+	uint64_t k1 = readWord(block, 8);
+	uint64_t k2 = readWord(block + 8, 8);
+
+	k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; m_h1 ^= k1;
+	m_h1 = rotl(m_h1, 27); m_h1 += m_h2; m_h1 = m_h1 * 5 + 0x52dce729;
+
+	k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; m_h2 ^= k2;
+	m_h2 = rotl(m_h2, 31); m_h2 += m_h1; m_h2 = m_h2 * 5 + 0x38495ab5;
+}
+
+std::string util::Hasher::hex() const
+{
+	uint64_t h1 = m_h1, h2 = m_h2;
+
+	// tail of less than 16 bytes
+	if (m_buffered > 8)
+	{
+		uint64_t k2 = readWord(m_buffer + 8, m_buffered - 8);
+		k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	if (m_buffered > 0)
+	{
+		uint64_t k1 = readWord(m_buffer, std::min<size_t>(m_buffered, 8));
+		k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= m_length;
+	h2 ^= m_length;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix(h1);
+	h2 = fmix(h2);
+	h1 += h2;
+	h2 += h1;
+
+	static const char digits[] = "0123456789abcdef";
+	std::string result(32, '0');
+	for (int i = 0; i < 16; ++i)
+	{
+		result[15 - i] = digits[(h1 >> (4 * i)) & 0xf];
+		result[31 - i] = digits[(h2 >> (4 * i)) & 0xf];
+	}
+	return result;
+}
+
+util::SkinCache::SkinCache(const std::string& directory, uintmax_t maxBytes)
+	: m_directory{ directory }, m_maxBytes{ maxBytes }
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+}
+
+bool util::SkinCache::load(const std::string& key, Handle(Geom_BSplineSurface)& surface, std::vector<double>& values)
+{
+	std::ifstream stream(path(key));
+	std::string header;
+	if (!stream || !std::getline(stream, header) || header != cacheHeader)
+	{
+		++m_misses;
+		return false;
+	}
+
+	Handle(Geom_Surface) geometry;
+	try
+	{
+		GeomTools::Read(geometry, stream);
+	}
+	catch (Standard_Failure&)
+	{
+		geometry.Nullify();
+	}
+
+	surface = Handle(Geom_BSplineSurface)::DownCast(geometry);
+
+	// the values follow the surface as their number and the values
+	size_t numValues = 0;
+	values.clear();
+	if (!surface.IsNull() && stream >> numValues && numValues <= 1024)
+	{
+		values.resize(numValues);
+		for (auto& value : values)
+		{
+			stream >> value;
+		}
+	}
+	if (surface.IsNull() || !stream || values.size() != numValues)
+	{
+		surface.Nullify();
+		values.clear();
+		++m_misses;
+		return false;
+	}
+
+	// the modification time orders the entries for eviction
+	std::error_code error;
+	std::filesystem::last_write_time(path(key), std::filesystem::file_time_type::clock::now(), error);
+	++m_hits;
+	return true;
+}
+
+bool util::SkinCache::store(const std::string& key, const Handle(Geom_BSplineSurface)& surface, const std::vector<double>& values)
+{
+	if (surface.IsNull())
+	{
+		return false;
+	}
+
+	// a name no other thread or process writes to, renamed over the entry once complete
+	std::random_device device;
+	std::ostringstream suffix;
+	suffix << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id()) << "_" << device();
+	std::string temporary = path(key) + suffix.str();
+
+	{
+		std::ofstream stream(temporary);
+		stream.precision(17);
+		stream << cacheHeader << "\n";
+		GeomTools::Write(Handle(Geom_Surface)(surface), stream);
+		stream << "\n" << values.size();
+		for (double value : values)
+		{
+			stream << " " << value;
+		}
+		stream << "\n";
+		if (!stream.flush())
+		{
+			stream.close();
+			std::error_code error;
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path(key), error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	++m_stores;
+	evict();
+	return true;
+}
+
+const std::string& util::SkinCache::directory() const
+{
+	return m_directory;
+}
+
+long long util::SkinCache::hits() const
+{
+	return m_hits;
+}
+
+long long util::SkinCache::misses() const
+{
+	return m_misses;
+}
+
+long long util::SkinCache::stores() const
+{
+	return m_stores;
+}
+
+long long util::SkinCache::evictions() const
+{
+	return m_evictions;
+}
+
+std::string util::SkinCache::path(const std::string& key) const
+{
+	return (std::filesystem::path(m_directory) / (key + cacheExtension)).string();
+}
+
+void util::SkinCache::evict()
+{
+	struct Entry
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type time;
+		uintmax_t size;
+	};
+	std::vector<Entry> entries;
+	uintmax_t total = 0;
+
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->path().extension() != cacheExtension)
+		{
+			continue;
+		}
+
+		// entries removed meanwhile by another process are skipped
+		std::error_code entryError;
+		uintmax_t size = it->file_size(entryError);
+		std::filesystem::file_time_type time = it->last_write_time(entryError);
+		if (!entryError)
+		{
+			entries.push_back({ it->path(), time, size });
+			total += size;
+		}
+	}
+
+	if (total <= m_maxBytes)
+	{
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+	for (const Entry& entry : entries)
+	{
+		if (total <= m_maxBytes)
+		{
+			break;
+		}
+		if (std::filesystem::remove(entry.path, error))
+		{
+			++m_evictions;
+		}
+		total -= entry.size;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Geom_BSplineSurface.hxx>
+
+namespace util
+{
+	// Streaming 128-bit MurmurHash3 of binary data, the same input gives the same digest on every run
+	class Hasher
+	{
+	public:
+		Hasher();
+
+		void add(const void* data, size_t size);
+		void add(int value);
+		void add(double value);	// -0.0 is hashed as 0.0
+
+		// digest as 32 hexadecimal digits
+		std::string hex() const;
+
+	private:
+		void addBlock(const unsigned char* block);
+
+	private:
+		uint64_t m_h1, m_h2;
+		uint64_t m_length;
+		unsigned char m_buffer[16];
+		size_t m_buffered;
+	};
+
+	// Directory of skinned surfaces named by the hash of their input, shared by threads and processes.
+	// Entries are written to a temporary file and renamed, and the least recently used ones are removed
+	// when the directory grows over maxBytes.
+	class SkinCache
+	{
+	public:
+		explicit SkinCache(const std::string& directory, uintmax_t maxBytes = uintmax_t(1) << 30);
+
+		// read the surface stored under key and the values stored with it, a hit marks the entry as recently used
+		bool load(const std::string& key, Handle(Geom_BSplineSurface)& surface, std::vector<double>& values);
+
+		// store the surface under key with values describing it, and evict old entries
+		bool store(const std::string& key, const Handle(Geom_BSplineSurface)& surface, const std::vector<double>& values = {});
+
+		const std::string& directory() const;
+
+		long long hits() const;
+		long long misses() const;
+		long long stores() const;
+		long long evictions() const;
+
+	private:
+		std::string path(const std::string& key) const;
+
+		// remove the least recently used entries until the directory fits in maxBytes
+		void evict();
+
+	private:
+		std::string m_directory;
+		uintmax_t m_maxBytes;
+
+		std::atomic<long long> m_hits{ 0 };
+		std::atomic<long long> m_misses{ 0 };
+		std::atomic<long long> m_stores{ 0 };
+		std::atomic<long long> m_evictions{ 0 };
+	};
+};
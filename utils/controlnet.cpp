@@ -0,0 +1,79 @@
+#include "controlnet.h"
+
+#include <algorithm>
+
+nurbs::ControlNet::ControlNet(int numRows, int numCols)
+{
+	resize(numRows, numCols);
+}
+
+void nurbs::ControlNet::resize(int numRows, int numCols)
+{
+	m_rows = numRows;
+	m_cols = numCols;
+	m_planeSize = (static_cast<size_t>(numRows) * numCols + 7) / 8 * 8;
+	m_data.resize(3 * m_planeSize);
+}
+
+void nurbs::ControlNet::clear()
+{
+	m_rows = 0;
+	m_cols = 0;
+	m_planeSize = 0;
+	std::vector<double, AlignedAllocator<double>>().swap(m_data);
+}
+
+void nurbs::ControlNet::insertRow(int j)
+{
+	ControlNet net(m_rows + 1, m_cols);
+	size_t before = offset(j), after = offset(m_rows) - before;
+	for (int coord = 0; coord < 3; ++coord)
+	{
+		std::copy(plane(coord), plane(coord) + before, net.plane(coord));
+		std::copy(plane(coord) + before, plane(coord) + before + after, net.plane(coord) + before + m_cols);
+	}
+	*this = std::move(net);
+}
+
+void nurbs::ControlNet::removeRow(int j)
+{
+	ControlNet net(m_rows - 1, m_cols);
+	size_t before = offset(j), after = offset(m_rows - 1) - before;
+	for (int coord = 0; coord < 3; ++coord)
+	{
+		std::copy(plane(coord), plane(coord) + before, net.plane(coord));
+		std::copy(plane(coord) + before + m_cols, plane(coord) + before + m_cols + after, net.plane(coord) + before);
+	}
+	*this = std::move(net);
+}
+
+void nurbs::ControlNet::setRow(int j, const TColgp_Array1OfPnt& points)
+{
+	double* x = plane(0) + static_cast<size_t>(j) * m_cols;
+	double* y = plane(1) + static_cast<size_t>(j) * m_cols;
+	double* z = plane(2) + static_cast<size_t>(j) * m_cols;
+
+	for (int i = 0; i < m_cols; ++i)
+	{
+		const gp_Pnt& point = points.Value(points.Lower() + i);
+		x[i] = point.X();
+		y[i] = point.Y();
+		z[i] = point.Z();
+	}
+}
+
+void nurbs::ControlNet::toArray2(TColgp_Array2OfPnt& poles) const
+{
+	const double* x = plane(0);
+	const double* y = plane(1);
+	const double* z = plane(2);
+
+	for (int i = 0; i < m_cols; ++i)
+	{
+		for (int j = 0; j < m_rows; ++j)
+		{
+			size_t k = static_cast<size_t>(j) * m_cols + i;
+			poles.SetValue(poles.LowerRow() + i, poles.LowerCol() + j, gp_Pnt(x[k], y[k], z[k]));
+		}
+	}
+}
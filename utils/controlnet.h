@@ -0,0 +1,106 @@
+#pragma once
+
+#include <new>
+#include <vector>
+#include <TColgp_Array1OfPnt.hxx>
+#include <TColgp_Array2OfPnt.hxx>
+
+namespace nurbs
+{
+	// Allocator of memory aligned to cache lines and to the widest SIMD registers
+	template <class T, size_t Alignment = 64>
+	struct AlignedAllocator
+	{
+		using value_type = T;
+
+		template <class U>
+		struct rebind
+		{
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() = default;
+		template <class U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+		T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+		void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+		template <class U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+		template <class U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+	};
+
+	/*
+	 * Control net of a skinned surface as a structure of arrays. Row j holds the control points of the j-th
+	 * section curve and column i the i-th control points of all sections. The x, y and z coordinates are
+	 * stored in three row-major planes of one contiguous buffer, each plane aligned to 64 bytes.
+	 **/
+	class ControlNet
+	{
+	public:
+		// Strided view of the points of one row or one column
+		template <class Real>
+		struct View
+		{
+			Real* x;
+			Real* y;
+			Real* z;
+			int size;
+			int stride;
+
+			gp_Pnt operator[](int k) const { return gp_Pnt(x[k * stride], y[k * stride], z[k * stride]); }
+
+			void setValue(int k, const gp_Pnt& point)
+			{
+				x[k * stride] = point.X();
+				y[k * stride] = point.Y();
+				z[k * stride] = point.Z();
+			}
+		};
+
+	public:
+		ControlNet() = default;
+		ControlNet(int numRows, int numCols);
+
+		// reallocate for numRows x numCols points, the values are undefined
+		void resize(int numRows, int numCols);
+
+		// release the memory
+		void clear();
+
+		// insert a row with undefined points before row j, the other points keep their values
+		void insertRow(int j);
+
+		// remove row j, the other points keep their values
+		void removeRow(int j);
+
+		int rows() const { return m_rows; }
+		int cols() const { return m_cols; }
+
+		// coordinate planes, coordinate 0, 1, 2 is x, y, z and point (j, i) is at j * cols() + i
+		double* plane(int coord) { return m_data.data() + coord * m_planeSize; }
+		const double* plane(int coord) const { return m_data.data() + coord * m_planeSize; }
+
+		View<double> row(int j) { return { plane(0) + offset(j), plane(1) + offset(j), plane(2) + offset(j), m_cols, 1 }; }
+		View<const double> row(int j) const { return { plane(0) + offset(j), plane(1) + offset(j), plane(2) + offset(j), m_cols, 1 }; }
+		View<double> column(int i) { return { plane(0) + i, plane(1) + i, plane(2) + i, m_rows, m_cols }; }
+		View<const double> column(int i) const { return { plane(0) + i, plane(1) + i, plane(2) + i, m_rows, m_cols }; }
+
+		// copy points into row j
+		void setRow(int j, const TColgp_Array1OfPnt& points);
+
+		// convert to OCC poles of a surface whose u direction runs along the rows, poles(i, j) is point (j - 1, i - 1)
+		void toArray2(TColgp_Array2OfPnt& poles) const;
+
+	private:
+		size_t offset(int j) const { return static_cast<size_t>(j) * m_cols; }
+
+	private:
+		int m_rows = 0;
+		int m_cols = 0;
+		size_t m_planeSize = 0;	// values per plane, padded to a multiple of 64 bytes
+		std::vector<double, AlignedAllocator<double>> m_data;
+	};
+};
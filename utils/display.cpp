@@ -0,0 +1,49 @@
+#include "display.h"
+
+util::DisplayList::DisplayList(const Handle(AIS_InteractiveContext)& context)
+	: m_context{ context }
+{
+}
+
+int util::DisplayList::sync(const std::vector<TopoDS_Shape>& shapes, AIS_DisplayMode mode)
+{
+	// shapes are appended or cleared in practice, so the common prefix is kept and the rest displayed again
+	size_t kept = 0;
+	while (kept < m_presentations.size() && kept < shapes.size() && m_presentations[kept]->Shape().IsEqual(shapes[kept]))
+	{
+		++kept;
+	}
+	for (size_t i = kept; i < m_presentations.size(); ++i)
+	{
+		m_context->Remove(m_presentations[i], Standard_False);
+	}
+	m_presentations.resize(kept);
+
+	for (size_t i = kept; i < shapes.size(); ++i)
+	{
+		Handle(AIS_Shape) presentation = new AIS_Shape(shapes[i]);
+		m_context->SetDisplayMode(presentation, mode, Standard_False);
+		m_context->Display(presentation, Standard_False);
+		m_presentations.emplace_back(presentation);
+	}
+	return static_cast<int>(shapes.size() - kept);
+}
+
+void util::DisplayList::clear()
+{
+	for (const auto& presentation : m_presentations)
+	{
+		m_context->Remove(presentation, Standard_False);
+	}
+	m_presentations.clear();
+}
+
+const Handle(AIS_Shape)& util::DisplayList::presentation(size_t i) const
+{
+	return m_presentations[i];
+}
+
+size_t util::DisplayList::size() const
+{
+	return m_presentations.size();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <AIS_InteractiveContext.hxx>
+#include <AIS_Shape.hxx>
+#include <TopoDS_Shape.hxx>
+
+namespace util
+{
+	/*
+	 * Presentations of a list of shapes in an AIS context, one AIS_Shape per shape kept as long as the shape stays
+	 * in the list. sync() compares the list with the displayed shapes, erases the presentations from the first
+	 * shape which differs and displays the shapes after it, so appending a shape creates one presentation and the
+	 * others keep theirs with their meshes, whatever the number of shapes displayed.
+	 **/
+	class DisplayList
+	{
+	public:
+		explicit DisplayList(const Handle(AIS_InteractiveContext)& context);
+
+		// bring the presentations in line with "shapes" without redrawing the viewer, returns the number displayed
+		int sync(const std::vector<TopoDS_Shape>& shapes, AIS_DisplayMode mode = AIS_Shaded);
+
+		// remove every presentation without redrawing the viewer
+		void clear();
+
+		// presentation of the i-th shape of the last sync
+		const Handle(AIS_Shape)& presentation(size_t i) const;
+
+		size_t size() const;
+
+	private:
+		Handle(AIS_InteractiveContext) m_context;
+		std::vector<Handle(AIS_Shape)> m_presentations;
+	};
+};
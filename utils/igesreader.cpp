@@ -0,0 +1,643 @@
+#include "utils.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <Standard_Failure.hxx>
+
+/*
+ * Fast reader of the section curves of an IGES file.
+ *
+ * IGES records are 80 columns wide and column 73 names their section. The lines are indexed once, then the
+ * directory entries, two lines of ten 8-column fields each, are read for the independent rational B-spline
+ * curves (type 126) and the transformation matrices (type 124) they refer to. The parameter data of every
+ * curve, columns 1 to 64 of its parameter lines, is decoded by parallel tasks straight into Geom_BSplineCurve.
+ **/
+
+namespace
+{
+	// curves decoded by one task
+	const int curveBlock = 64;
+
+	// longest chain of transformation matrices followed
+	const int maxDepth = 64;
+
+	// width of the parameter data in a parameter line
+	const int parameterColumns = 64;
+
+	// Lines of the file and the first line of each section
+	struct Lines
+	{
+		std::vector<const char*> starts;	// one more than the lines, the last one is the end of the file
+		int global = -1, directory = -1, parameter = -1, terminate = -1;
+		int numGlobal = 0, numDirectory = 0, numParameter = 0;
+
+		const char* line(int i) const { return starts[i]; }
+		int length(int i) const
+		{
+			// without the line ending
+			const char* end = starts[i + 1];
+			while (end > starts[i] && (end[-1] == '\n' || end[-1] == '\r'))
+			{
+				--end;
+			}
+			return static_cast<int>(end - starts[i]);
+		}
+	};
+
+	bool indexLines(const char* begin, const char* end, Lines& lines, std::string& error)
+	{
+		for (const char* p = begin; p < end;)
+		{
+			lines.starts.push_back(p);
+			const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			p = newline ? newline + 1 : end;
+		}
+		lines.starts.push_back(end);
+
+		int numLines = static_cast<int>(lines.starts.size()) - 1;
+		for (int i = 0; i < numLines; ++i)
+		{
+			if (lines.length(i) < 73)
+			{
+				// trailing empty lines are tolerated
+				if (lines.length(i) == 0)
+				{
+					continue;
+				}
+				error = "line " + std::to_string(i + 1) + " is shorter than 73 columns";
+				return false;
+			}
+			switch (lines.line(i)[72])
+			{
+			case 'S':
+				break;
+			case 'G':
+				lines.global = lines.global < 0 ? i : lines.global;
+				++lines.numGlobal;
+				break;
+			case 'D':
+				lines.directory = lines.directory < 0 ? i : lines.directory;
+				++lines.numDirectory;
+				break;
+			case 'P':
+				lines.parameter = lines.parameter < 0 ? i : lines.parameter;
+				++lines.numParameter;
+				break;
+			case 'T':
+				lines.terminate = i;
+				break;
+			default:
+				error = "line " + std::to_string(i + 1) + " belongs to no section, compressed files are not supported";
+				return false;
+			}
+		}
+
+		if (lines.global < 0 || lines.directory < 0 || lines.parameter < 0 || lines.numDirectory % 2 != 0)
+		{
+			error = "the global, directory or parameter section is missing";
+			return false;
+		}
+		return true;
+	}
+
+	// integer of an 8-column directory field, blank is 0
+	bool directoryField(const char* line, int field, int& value)
+	{
+		const char* begin = line + 8 * field;
+		const char* end = begin + 8;
+		while (begin < end && *begin == ' ')
+		{
+			++begin;
+		}
+		while (end > begin && end[-1] == ' ')
+		{
+			--end;
+		}
+		value = 0;
+		if (begin == end)
+		{
+			return true;
+		}
+		if (*begin == '+')
+		{
+			++begin;
+		}
+		auto result = std::from_chars(begin, end, value);
+		return result.ec == std::errc() && result.ptr == end;
+	}
+
+	// Reader of delimited parameters, spaces around a parameter are ignored
+	class Parser
+	{
+	public:
+		Parser(const char* begin, const char* end, char delimiter, char recordDelimiter)
+			: m_p(begin), m_end(end), m_delimiter(delimiter), m_recordDelimiter(recordDelimiter)
+		{
+		}
+
+		// read the next parameter as raw text, a Hollerith string "nH..." is returned without its prefix
+		bool next(std::string_view& value)
+		{
+			if (m_done)
+			{
+				return false;
+			}
+			while (m_p < m_end && *m_p == ' ')
+			{
+				++m_p;
+			}
+
+			// Hollerith string
+			const char* digits = m_p;
+			while (digits < m_end && *digits >= '0' && *digits <= '9')
+			{
+				++digits;
+			}
+			if (digits > m_p && digits < m_end && (*digits == 'H' || *digits == 'h'))
+			{
+				size_t count = 0;
+				std::from_chars(m_p, digits, count);
+				const char* begin = digits + 1;
+				m_p = std::min(begin + count, m_end);
+				value = std::string_view(begin, m_p - begin);
+				return skipDelimiter();
+			}
+
+			const char* begin = m_p;
+			while (m_p < m_end && *m_p != m_delimiter && *m_p != m_recordDelimiter)
+			{
+				++m_p;
+			}
+			const char* end = m_p;
+			while (end > begin && end[-1] == ' ')
+			{
+				--end;
+			}
+			value = std::string_view(begin, end - begin);
+			return skipDelimiter();
+		}
+
+		bool readInteger(int& value)
+		{
+			std::string_view text;
+			if (!next(text))
+			{
+				return false;
+			}
+			value = 0;
+			if (text.empty())
+			{
+				return true;
+			}
+			if (text.front() == '+')
+			{
+				text.remove_prefix(1);
+			}
+			auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+			return result.ec == std::errc() && result.ptr == text.data() + text.size();
+		}
+
+		// real with an E or D exponent, blank is 0
+		bool readReal(double& value)
+		{
+			std::string_view text;
+			if (!next(text))
+			{
+				return false;
+			}
+			value = 0.0;
+			if (text.empty())
+			{
+				return true;
+			}
+			char buffer[64];
+			if (text.size() >= sizeof(buffer))
+			{
+				return false;
+			}
+			size_t size = 0;
+			for (char c : text)
+			{
+				if (c != '+' || size > 0)
+				{
+					buffer[size++] = c == 'D' || c == 'd' ? 'E' : c;
+				}
+			}
+			auto result = std::from_chars(buffer, buffer + size, value);
+			return result.ec == std::errc() && result.ptr == buffer + size;
+		}
+
+	private:
+		bool skipDelimiter()
+		{
+			while (m_p < m_end && *m_p == ' ')
+			{
+				++m_p;
+			}
+			if (m_p < m_end && *m_p == m_delimiter)
+			{
+				++m_p;
+			}
+			else if (m_p < m_end && *m_p == m_recordDelimiter)
+			{
+				++m_p;
+				m_done = true;
+			}
+			else if (m_p >= m_end)
+			{
+				m_done = true;
+			}
+			return true;
+		}
+
+	private:
+		const char* m_p;
+		const char* m_end;
+		char m_delimiter;
+		char m_recordDelimiter;
+		bool m_done = false;
+	};
+
+	// millimetres per model unit of the global section, flag 3 names the unit
+	double unitScale(int flag, std::string_view name)
+	{
+		static const double flags[] = { 1.0, 25.4, 1.0, 1.0, 304.8, 1609344.0, 1000.0, 1e6, 0.0254, 0.001, 10.0, 2.54e-5 };
+		static const std::map<std::string, double> names = {
+			{ "IN", 25.4 }, { "INCH", 25.4 }, { "MM", 1.0 }, { "FT", 304.8 }, { "MI", 1609344.0 }, { "M", 1000.0 }, { "KM", 1e6 },
+			{ "MIL", 0.0254 }, { "UM", 0.001 }, { "CM", 10.0 }, { "UIN", 2.54e-5 } };
+
+		if (flag != 3)
+		{
+			return flag >= 1 && flag <= 11 ? flags[flag] : 1.0;
+		}
+		std::string upper(name);
+		std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+		auto it = names.find(upper);
+		return it != names.end() ? it->second : 1.0;
+	}
+
+	// Affine map of a transformation matrix entity, rows of [R | T]
+	struct Transformation
+	{
+		double m[3][4] = { { 1.0, 0.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0, 0.0 }, { 0.0, 0.0, 1.0, 0.0 } };
+
+		// this * other
+		Transformation operator*(const Transformation& other) const
+		{
+			Transformation result;
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					double value = j == 3 ? m[i][3] : 0.0;
+					for (int k = 0; k < 3; ++k)
+					{
+						value += m[i][k] * other.m[k][j];
+					}
+					result.m[i][j] = value;
+				}
+			}
+			return result;
+		}
+
+		gp_Pnt apply(double x, double y, double z) const
+		{
+			return gp_Pnt(m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3],
+				m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3],
+				m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3]);
+		}
+	};
+
+	// Directory entry fields used by the reader
+	struct DirectoryEntry
+	{
+		int type = 0;
+		int parameter = 0;	// first parameter line, 1-based
+		int transformation = 0;	// directory pointer of a transformation matrix, 0 if none
+		int subordinate = 0;	// 0 for independent entities
+		int numLines = 0;	// parameter lines
+	};
+
+	// File layout shared by the decoding tasks
+	struct IgesFile
+	{
+		Lines lines;
+		char delimiter = ',';
+		char recordDelimiter = ';';
+		double scale = 1.0;
+		std::vector<DirectoryEntry> entries;
+	};
+
+	// parameter data of an entity, columns 1 to 64 of its parameter lines
+	bool parameterData(const IgesFile& file, const DirectoryEntry& entry, std::string& data)
+	{
+		data.clear();
+		if (entry.parameter < 1 || entry.numLines < 1 || entry.parameter - 1 + entry.numLines > file.lines.numParameter)
+		{
+			return false;
+		}
+		for (int i = 0; i < entry.numLines; ++i)
+		{
+			data.append(file.lines.line(file.lines.parameter + entry.parameter - 1 + i), parameterColumns);
+		}
+		return true;
+	}
+
+	// transformation of a directory pointer, composed with the transformations it refers to
+	bool transformation(const IgesFile& file, int pointer, int depth, Transformation& result, std::string& data)
+	{
+		result = Transformation();
+		if (pointer == 0)
+		{
+			return true;
+		}
+		int index = (pointer - 1) / 2;
+		if (pointer < 0 || pointer % 2 == 0 || index >= static_cast<int>(file.entries.size()) || depth > maxDepth)
+		{
+			return false;
+		}
+
+		const DirectoryEntry& entry = file.entries[index];
+		if (entry.type != 124 || !parameterData(file, entry, data))
+		{
+			return false;
+		}
+		Parser parser(data.data(), data.data() + data.size(), file.delimiter, file.recordDelimiter);
+		Transformation own;
+		int type;
+		if (!parser.readInteger(type) || type != 124)
+		{
+			return false;
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				if (!parser.readReal(own.m[i][j]))
+				{
+					return false;
+				}
+			}
+			own.m[i][3] *= file.scale;
+		}
+
+		Transformation parent;
+		if (!transformation(file, entry.transformation, depth + 1, parent, data))
+		{
+			return false;
+		}
+		result = parent * own;
+		return true;
+	}
+
+	// Buffers of one task decoding curves
+	struct CurveData
+	{
+		std::string data;
+		std::vector<double> flatKnots;
+		std::vector<double> weights;
+	};
+
+	// decode the rational B-spline curve of a directory entry, an empty string is returned on success
+	std::string decodeCurve(const IgesFile& file, int index, CurveData& buffers, Handle(Geom_BSplineCurve)& curve)
+	{
+		const DirectoryEntry& entry = file.entries[index];
+		auto name = [&]() { return "curve at directory line " + std::to_string(2 * index + 1); };
+
+		Transformation placement;
+		if (!transformation(file, entry.transformation, 0, placement, buffers.data))
+		{
+			return name() + " refers to an invalid transformation matrix";
+		}
+		if (!parameterData(file, entry, buffers.data))
+		{
+			return name() + " has no parameter data";
+		}
+
+		// 126, K, M, planar, closed, polynomial, periodic, knots, weights, poles, V(0), V(1), normal
+		Parser parser(buffers.data.data(), buffers.data.data() + buffers.data.size(), file.delimiter, file.recordDelimiter);
+		int type, upper, degree, planar, closed, polynomial, periodic;
+		if (!parser.readInteger(type) || type != 126 || !parser.readInteger(upper) || !parser.readInteger(degree)
+			|| !parser.readInteger(planar) || !parser.readInteger(closed) || !parser.readInteger(polynomial) || !parser.readInteger(periodic)
+			|| degree < 1 || upper < degree)
+		{
+			return name() + " has an invalid header";
+		}
+
+		int numPoles = upper + 1;
+		int numFlatKnots = upper + degree + 2;
+		buffers.flatKnots.resize(numFlatKnots);
+		buffers.weights.resize(numPoles);
+		for (double& knot : buffers.flatKnots)
+		{
+			if (!parser.readReal(knot))
+			{
+				return name() + " has invalid knots";
+			}
+		}
+		for (double& weight : buffers.weights)
+		{
+			if (!parser.readReal(weight) || weight <= 0.0)
+			{
+				return name() + " has invalid weights";
+			}
+		}
+
+		TColgp_Array1OfPnt poles(1, numPoles);
+		for (int i = 1; i <= numPoles; ++i)
+		{
+			double x, y, z;
+			if (!parser.readReal(x) || !parser.readReal(y) || !parser.readReal(z))
+			{
+				return name() + " has invalid poles";
+			}
+			poles.SetValue(i, placement.apply(file.scale * x, file.scale * y, file.scale * z));
+		}
+
+		// flat knot vector to distinct knots and multiplicities
+		int numKnots = 1;
+		for (int i = 1; i < numFlatKnots; ++i)
+		{
+			numKnots += buffers.flatKnots[i] != buffers.flatKnots[i - 1] ? 1 : 0;
+		}
+		TColStd_Array1OfReal knots(1, numKnots);
+		TColStd_Array1OfInteger mults(1, numKnots);
+		int k = 1;
+		knots.SetValue(1, buffers.flatKnots[0]);
+		mults.SetValue(1, 1);
+		for (int i = 1; i < numFlatKnots; ++i)
+		{
+			if (buffers.flatKnots[i] != buffers.flatKnots[i - 1])
+			{
+				knots.SetValue(++k, buffers.flatKnots[i]);
+				mults.SetValue(k, 0);
+			}
+			mults.SetValue(k, mults.Value(k) + 1);
+		}
+
+		try
+		{
+			if (polynomial == 1)
+			{
+				curve = new Geom_BSplineCurve(poles, knots, mults, degree);
+			}
+			else
+			{
+				TColStd_Array1OfReal weights(1, numPoles);
+				for (int i = 0; i < numPoles; ++i)
+				{
+					weights.SetValue(i + 1, buffers.weights[i]);
+				}
+				curve = new Geom_BSplineCurve(poles, weights, knots, mults, degree);
+			}
+		}
+		catch (Standard_Failure& failure)
+		{
+			return name() + ": " + failure.GetMessageString();
+		}
+		return std::string();
+	}
+
+	// whether an independent entity of this type is transferred into shapes other than B-spline curves by the full reader
+	bool isUnsupportedRoot(int type)
+	{
+		if (type == 0 || type == 116 || type == 124 || type == 126)
+		{
+			return false;
+		}
+		if (type == 308 || type == 408 || type == 430)
+		{
+			return true;
+		}
+		return type < 200 || type >= 500;
+	}
+}
+
+bool io::readIgesCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error, int numThreads)
+{
+	util::TraceScope trace("io::readIgesCurves", "io", filename);
+	curves.clear();
+
+	MappedFile mapped;
+	if (!mapped.open(filename))
+	{
+		error = "cannot open " + filename;
+		return false;
+	}
+
+	IgesFile file;
+	if (!indexLines(mapped.data(), mapped.data() + mapped.size(), file.lines, error))
+	{
+		error = filename + ": " + error;
+		return false;
+	}
+
+	// global section: delimiters, unit flag and unit name
+	std::string global;
+	for (int i = 0; i < file.lines.numGlobal; ++i)
+	{
+		global.append(file.lines.line(file.lines.global + i), 72);
+	}
+	// the first two fields are the delimiters themselves as 1H strings, blank ones keep the defaults
+	size_t position = 0;
+	for (char* delimiter : { &file.delimiter, &file.recordDelimiter })
+	{
+		while (position < global.size() && global[position] == ' ')
+		{
+			++position;
+		}
+		if (global.compare(position, 2, "1H") == 0 && position + 2 < global.size())
+		{
+			*delimiter = global[position + 2];
+			position += 3;
+		}
+		position = global.find(file.delimiter, position);
+		position = position == std::string::npos ? global.size() : position + 1;
+	}
+	Parser globalParser(global.data() + position, global.data() + global.size(), file.delimiter, file.recordDelimiter);
+	std::string_view field, unitName;
+	int unitFlag = 2;
+	for (int i = 3; i <= 15 && globalParser.next(field); ++i)
+	{
+		if (i == 14 && !field.empty())
+		{
+			std::from_chars(field.data(), field.data() + field.size(), unitFlag);
+		}
+		else if (i == 15)
+		{
+			unitName = field;
+		}
+	}
+	file.scale = unitScale(unitFlag, unitName);
+
+	// directory entries
+	int numEntries = file.lines.numDirectory / 2;
+	file.entries.resize(numEntries);
+	std::vector<int> curveEntries;
+	for (int n = 0; n < numEntries; ++n)
+	{
+		const char* first = file.lines.line(file.lines.directory + 2 * n);
+		const char* second = file.lines.line(file.lines.directory + 2 * n + 1);
+		DirectoryEntry& entry = file.entries[n];
+		int status;
+		if (!directoryField(first, 0, entry.type) || !directoryField(first, 1, entry.parameter) || !directoryField(first, 6, entry.transformation)
+			|| !directoryField(first, 8, status) || !directoryField(second, 3, entry.numLines))
+		{
+			error = filename + ": directory entry at line " + std::to_string(2 * n + 1) + " cannot be parsed";
+			return false;
+		}
+		// the status digits are blank, subordinate, use and hierarchy
+		entry.subordinate = status / 10000 % 100;
+
+		if (entry.subordinate == 0 && isUnsupportedRoot(entry.type))
+		{
+			error = filename + " holds independent entities of type " + std::to_string(entry.type) + ", which are left to the full reader";
+			return false;
+		}
+		if (entry.type == 126 && entry.subordinate == 0)
+		{
+			curveEntries.push_back(n);
+		}
+	}
+
+	// decode the curves
+	int numCurves = static_cast<int>(curveEntries.size());
+	curves.resize(numCurves);
+	std::vector<std::string> errors(numCurves);
+	auto decodeCurves = [&](int first, int last)
+	{
+		CurveData buffers;
+		for (int i = first; i < last; ++i)
+		{
+			errors[i] = decodeCurve(file, curveEntries[i], buffers, curves[i]);
+		}
+	};
+	if (numThreads != 1 && numCurves > curveBlock)
+	{
+		util::ThreadPool pool(numThreads);
+		pool.parallelFor(0, numCurves, curveBlock, decodeCurves);
+	}
+	else
+	{
+		decodeCurves(0, numCurves);
+	}
+
+	for (const auto& message : errors)
+	{
+		if (!message.empty())
+		{
+			curves.clear();
+			error = filename + ": " + message;
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace nurbs
+{
+	// Scalar lane, used for the values left over by the vector lanes
+	struct ScalarLanes
+	{
+		static constexpr int width = 1;
+		using Real = double;
+
+		static Real load(const double* p) { return *p; }
+		static void store(double* p, Real a) { *p = a; }
+		static Real set1(double a) { return a; }
+		static Real gather(const double* knots, const int* indices, int offset) { return knots[indices[0] + offset]; }
+		static Real add(Real a, Real b) { return a + b; }
+		static Real sub(Real a, Real b) { return a - b; }
+		static Real mul(Real a, Real b) { return a * b; }
+		static Real div(Real a, Real b) { return a / b; }
+		static Real sqrt(Real a) { return std::sqrt(a); }
+	};
+
+#if defined(__AVX2__)
+	// Four values per AVX2 register
+	struct Avx2Lanes
+	{
+		static constexpr int width = 4;
+		using Real = __m256d;
+
+		static Real load(const double* p) { return _mm256_loadu_pd(p); }
+		static void store(double* p, Real a) { _mm256_storeu_pd(p, a); }
+		static Real set1(double a) { return _mm256_set1_pd(a); }
+		static Real gather(const double* knots, const int* indices, int offset)
+		{
+			__m128i index = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices)), _mm_set1_epi32(offset));
+			return _mm256_i32gather_pd(knots, index, 8);
+		}
+		static Real add(Real a, Real b) { return _mm256_add_pd(a, b); }
+		static Real sub(Real a, Real b) { return _mm256_sub_pd(a, b); }
+		static Real mul(Real a, Real b) { return _mm256_mul_pd(a, b); }
+		static Real div(Real a, Real b) { return _mm256_div_pd(a, b); }
+		static Real sqrt(Real a) { return _mm256_sqrt_pd(a); }
+	};
+#endif
+
+#if defined(__AVX512F__)
+	// Eight values per AVX-512 register
+	struct Avx512Lanes
+	{
+		static constexpr int width = 8;
+		using Real = __m512d;
+
+		static Real load(const double* p) { return _mm512_loadu_pd(p); }
+		static void store(double* p, Real a) { _mm512_storeu_pd(p, a); }
+		static Real set1(double a) { return _mm512_set1_pd(a); }
+		static Real gather(const double* knots, const int* indices, int offset)
+		{
+			__m256i index = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), _mm256_set1_epi32(offset));
+			return _mm512_i32gather_pd(index, knots, 8);
+		}
+		static Real add(Real a, Real b) { return _mm512_add_pd(a, b); }
+		static Real sub(Real a, Real b) { return _mm512_sub_pd(a, b); }
+		static Real mul(Real a, Real b) { return _mm512_mul_pd(a, b); }
+		static Real div(Real a, Real b) { return _mm512_div_pd(a, b); }
+		static Real sqrt(Real a) { return _mm512_sqrt_pd(a); }
+	};
+
+	// widest lanes enabled by the compiler flags
+	using VectorLanes = Avx512Lanes;
+#elif defined(__AVX2__)
+	using VectorLanes = Avx2Lanes;
+#else
+	using VectorLanes = ScalarLanes;
+#endif
+};
@@ -0,0 +1,141 @@
+#include "mappedfile.h"
+
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+io::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool io::MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view)
+		{
+			m_file = file;
+			m_mapping = mapping;
+			m_data = static_cast<const char*>(view);
+			m_size = static_cast<size_t>(size.QuadPart);
+			m_open = true;
+			m_mapped = true;
+			return true;
+		}
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (view != MAP_FAILED)
+		{
+			// the whole file is scanned from front to back
+			madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+			::close(file);
+			m_data = static_cast<const char*>(view);
+			m_size = static_cast<size_t>(status.st_size);
+			m_open = true;
+			m_mapped = true;
+			return true;
+		}
+	}
+	::close(file);
+#endif
+
+	// empty files and files that cannot be mapped are read into memory
+	std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+	if (!stream)
+	{
+		return false;
+	}
+	m_buffer.resize(static_cast<size_t>(stream.tellg()));
+	stream.seekg(0);
+	if (!m_buffer.empty() && !stream.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size())))
+	{
+		m_buffer.clear();
+		return false;
+	}
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+	m_open = true;
+	return true;
+}
+
+void io::MappedFile::close()
+{
+	if (m_mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_mapping));
+		CloseHandle(static_cast<HANDLE>(m_file));
+		m_mapping = nullptr;
+		m_file = nullptr;
+#else
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+	}
+	std::vector<char>().swap(m_buffer);
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+	m_mapped = false;
+}
+
+bool io::MappedFile::isOpen() const
+{
+	return m_open;
+}
+
+bool io::MappedFile::isMapped() const
+{
+	return m_mapped;
+}
+
+const char* io::MappedFile::data() const
+{
+	return m_data;
+}
+
+size_t io::MappedFile::size() const
+{
+	return m_size;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace io
+{
+	// Read-only view of a whole file, memory mapped where the platform allows it and read into memory otherwise
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// map the file, an empty file is opened with size 0
+		bool open(const std::string& filename);
+		void close();
+
+		bool isOpen() const;
+		bool isMapped() const;	// false if the file was read into memory
+		const char* data() const;
+		size_t size() const;
+
+	private:
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+		bool m_open = false;
+		bool m_mapped = false;
+		std::vector<char> m_buffer;	// content of a file that could not be mapped
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+};
@@ -0,0 +1,149 @@
+#include "meshcache.h"
+#include "trace.h"
+
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepTools.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+
+namespace
+{
+	// size of the triangulations of the faces of a shape, as stored by Poly_Triangulation
+	size_t triangulationBytes(const TopoDS_Shape& shape)
+	{
+		size_t bytes = 0;
+		for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next())
+		{
+			TopLoc_Location location;
+			const Handle(Poly_Triangulation)& triangulation = BRep_Tool::Triangulation(TopoDS::Face(explorer.Current()), location);
+			if (triangulation.IsNull())
+			{
+				continue;
+			}
+			size_t numNodes = static_cast<size_t>(triangulation->NbNodes());
+			bytes += sizeof(Poly_Triangulation) + numNodes * sizeof(gp_Pnt) + static_cast<size_t>(triangulation->NbTriangles()) * sizeof(Poly_Triangle);
+			bytes += triangulation->HasUVNodes() ? numNodes * sizeof(gp_Pnt2d) : 0;
+			bytes += triangulation->HasNormals() ? numNodes * 3 * sizeof(float) : 0;
+		}
+		return bytes;
+	}
+}
+
+util::MeshCache::MeshCache(const MeshOptions& options)
+	: m_options{ options }, m_generation{ 0 }, m_bytes{ 0 }, m_hits{ 0 }, m_misses{ 0 }
+{
+}
+
+void util::MeshCache::setOptions(const MeshOptions& options)
+{
+	m_options = options;
+	++m_generation;
+}
+
+const util::MeshOptions& util::MeshCache::options() const
+{
+	return m_options;
+}
+
+int util::MeshCache::mesh(const std::vector<TopoDS_Shape>& shapes)
+{
+	util::TraceScope trace("MeshCache::mesh", "viewer");
+
+	// the shapes to mesh are gathered in one compound, the mesher then spreads all their faces over the cores
+	TopoDS_Compound compound;
+	BRep_Builder builder;
+	builder.MakeCompound(compound);
+	std::vector<Entry*> pending;
+	for (const auto& shape : shapes)
+	{
+		if (shape.IsNull())
+		{
+			continue;
+		}
+
+		Entry& entry = m_entries[shape.TShape().get()];
+		if (!entry.shape.IsNull() && entry.generation == m_generation)
+		{
+			++m_hits;
+			continue;
+		}
+
+		// a triangulation of other deflections is removed, the mesher would keep a finer one
+		if (!entry.shape.IsNull())
+		{
+			BRepTools::Clean(entry.shape);
+			m_bytes -= entry.bytes;
+		}
+		entry.shape = shape;
+		entry.generation = m_generation;
+		entry.bytes = 0;
+		builder.Add(compound, shape);
+		pending.push_back(&entry);
+	}
+	if (pending.empty())
+	{
+		return 0;
+	}
+
+	IMeshTools_Parameters parameters;
+	parameters.Deflection = m_options.linearDeflection;
+	parameters.Angle = m_options.angularDeflection;
+	parameters.Relative = m_options.relative;
+	parameters.InParallel = m_options.parallel;
+	BRepMesh_IncrementalMesh mesher(compound, parameters);
+
+	for (Entry* entry : pending)
+	{
+		entry->bytes = triangulationBytes(entry->shape);
+		m_bytes += entry->bytes;
+	}
+	m_misses += static_cast<long long>(pending.size());
+	return static_cast<int>(pending.size());
+}
+
+bool util::MeshCache::contains(const TopoDS_Shape& shape) const
+{
+	auto found = shape.IsNull() ? m_entries.end() : m_entries.find(shape.TShape().get());
+	return found != m_entries.end() && found->second.generation == m_generation;
+}
+
+void util::MeshCache::remove(const TopoDS_Shape& shape)
+{
+	auto found = shape.IsNull() ? m_entries.end() : m_entries.find(shape.TShape().get());
+	if (found != m_entries.end())
+	{
+		m_bytes -= found->second.bytes;
+		m_entries.erase(found);
+	}
+}
+
+void util::MeshCache::clear()
+{
+	m_entries.clear();
+	m_bytes = 0;
+}
+
+size_t util::MeshCache::size() const
+{
+	return m_entries.size();
+}
+
+size_t util::MeshCache::memoryBytes() const
+{
+	return m_bytes;
+}
+
+long long util::MeshCache::hits() const
+{
+	return m_hits;
+}
+
+long long util::MeshCache::misses() const
+{
+	return m_misses;
+}
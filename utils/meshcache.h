@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include <TopoDS_Shape.hxx>
+
+namespace util
+{
+	// Deflections of the triangulations of MeshCache
+	struct MeshOptions
+	{
+		double linearDeflection = 0.001;	// fraction of the size of each face when "relative", length otherwise
+		bool relative = true;
+		double angularDeflection = 0.5;	// radians
+		bool parallel = true;	// mesh the faces on all cores
+	};
+
+	/*
+	 * Triangulations of shapes computed ahead of display. mesh() meshes the shapes it has not met yet, all of them
+	 * in one parallel incremental meshing pass, and remembers them, so displaying them again or switching between
+	 * shading and wireframe finds the triangulation in the faces and never meshes. The presentations of the shapes
+	 * should not triangulate by themselves (Prs3d_Drawer::SetAutoTriangulation(false)), or they would mesh again
+	 * with their own deflection. Changing the options meshes the remembered shapes again at their next mesh().
+	 * Exports need no meshes, io::saveStep and the StepStreamWriter write the exact B-spline geometry.
+	 **/
+	class MeshCache
+	{
+	public:
+		explicit MeshCache(const MeshOptions& options = MeshOptions());
+
+		// the shapes meshed with other options are meshed again by the next mesh()
+		void setOptions(const MeshOptions& options);
+		const MeshOptions& options() const;
+
+		// mesh the shapes which are not meshed with the current options, returns their number
+		int mesh(const std::vector<TopoDS_Shape>& shapes);
+
+		bool contains(const TopoDS_Shape& shape) const;
+
+		// forget shapes, their triangulations stay in their faces
+		void remove(const TopoDS_Shape& shape);
+		void clear();
+
+		size_t size() const;	// shapes remembered
+		size_t memoryBytes() const;	// triangulations of the shapes remembered
+		long long hits() const;	// shapes found meshed by mesh()
+		long long misses() const;	// shapes meshed by mesh()
+
+	private:
+		// Shape meshed with the options of "generation"
+		struct Entry
+		{
+			TopoDS_Shape shape;	// keeps the shape alive, so its address is not reused by another
+			int generation = 0;
+			size_t bytes = 0;
+		};
+
+	private:
+		MeshOptions m_options;
+		int m_generation;
+		std::unordered_map<const void*, Entry> m_entries;	// by TopoDS_TShape, the triangulations do not depend on the location
+		size_t m_bytes;
+		long long m_hits;
+		long long m_misses;
+	};
+};
@@ -0,0 +1,443 @@
+#include "nativefile.h"
+#include "utils.h"
+#include "trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <TColgp_Array1OfPnt.hxx>
+#include <TColgp_Array2OfPnt.hxx>
+#include <TColStd_Array1OfReal.hxx>
+#include <TColStd_Array2OfReal.hxx>
+#include <TColStd_Array1OfInteger.hxx>
+
+namespace
+{
+	const char nativeMagic[8] = { 'S', 'K', 'I', 'N', 'N', 'U', 'R', 'B' };
+
+	enum RecordType : uint32_t
+	{
+		CurveRecord = 1,
+		SurfaceRecord = 2
+	};
+
+	enum RecordFlags : uint32_t
+	{
+		Rational = 1,
+		UPeriodic = 2,
+		VPeriodic = 4
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerBytes;
+		uint64_t numCurves;
+		uint64_t numSurfaces;
+		uint64_t tableOffset;
+		uint64_t fileSize;
+	};
+
+	struct Record
+	{
+		uint32_t type;
+		uint32_t flags;
+		int32_t uDegree, vDegree;
+		int32_t numUKnots, numVKnots;
+		int32_t numUPoles, numVPoles;
+		uint64_t knots;
+		uint64_t mults;
+		uint64_t poles;
+		uint64_t weights;
+	};
+
+	static_assert(sizeof(Header) == 48 && sizeof(Record) == 64, "the native layout has no padding");
+	static_assert(sizeof(gp_Pnt) == 3 * sizeof(double), "poles are mapped as gp_Pnt");
+	static_assert(sizeof(Standard_Integer) == sizeof(int32_t), "multiplicities are mapped as Standard_Integer");
+
+	bool isLittleEndian()
+	{
+		const uint16_t one = 1;
+		unsigned char first;
+		std::memcpy(&first, &one, 1);
+		return first == 1;
+	}
+
+	uint64_t align8(uint64_t offset)
+	{
+		return (offset + 7) & ~uint64_t(7);
+	}
+
+	// place the arrays of a record at offset and return the end of its data
+	uint64_t layoutRecord(Record& record, uint64_t offset)
+	{
+		uint64_t numKnots = static_cast<uint64_t>(record.numUKnots) + record.numVKnots;
+		uint64_t numPoles = static_cast<uint64_t>(record.numUPoles) * record.numVPoles;
+		record.knots = offset;
+		record.mults = record.knots + numKnots * sizeof(double);
+		record.poles = align8(record.mults + numKnots * sizeof(int32_t));
+		record.weights = record.flags & Rational ? record.poles + numPoles * 3 * sizeof(double) : 0;
+		return record.weights ? record.weights + numPoles * sizeof(double) : record.poles + numPoles * 3 * sizeof(double);
+	}
+
+	Record curveRecord(const Handle(Geom_BSplineCurve)& curve)
+	{
+		Record record = {};
+		record.type = CurveRecord;
+		record.flags = (curve->IsRational() ? Rational : 0) | (curve->IsPeriodic() ? UPeriodic : 0);
+		record.uDegree = curve->Degree();
+		record.numUKnots = curve->NbKnots();
+		record.numUPoles = curve->NbPoles();
+		record.numVPoles = 1;
+		return record;
+	}
+
+	Record surfaceRecord(const Handle(Geom_BSplineSurface)& surface)
+	{
+		Record record = {};
+		record.type = SurfaceRecord;
+		record.flags = (surface->IsURational() || surface->IsVRational() ? Rational : 0) | (surface->IsUPeriodic() ? UPeriodic : 0) |
+			(surface->IsVPeriodic() ? VPeriodic : 0);
+		record.uDegree = surface->UDegree();
+		record.vDegree = surface->VDegree();
+		record.numUKnots = surface->NbUKnots();
+		record.numVKnots = surface->NbVKnots();
+		record.numUPoles = surface->NbUPoles();
+		record.numVPoles = surface->NbVPoles();
+		return record;
+	}
+
+	// Writer of the arrays of the records, pads the stream to the offsets of the layout
+	class ArrayWriter
+	{
+	public:
+		explicit ArrayWriter(std::ofstream& output, uint64_t offset) : m_output(output), m_offset(offset) {}
+
+		void write(uint64_t offset, const void* data, size_t bytes)
+		{
+			static const char zeros[8] = {};
+			m_output.write(zeros, static_cast<std::streamsize>(offset - m_offset));
+			m_output.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+			m_offset = offset + bytes;
+		}
+
+	private:
+		std::ofstream& m_output;
+		uint64_t m_offset;
+	};
+
+	// check that count values of size bytes at offset lie within the file and start at a multiple of 8 bytes
+	bool inFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize)
+	{
+		return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+	}
+
+	bool checkRecord(const Record& record, uint64_t fileSize)
+	{
+		if (record.uDegree < 1 || record.numUKnots < 2 || record.numUPoles < 2 || record.numVPoles < 1 || record.vDegree < 0 ||
+			record.numVKnots < 0)
+		{
+			return false;
+		}
+		if (record.type == SurfaceRecord && (record.vDegree < 1 || record.numVKnots < 2 || record.numVPoles < 2))
+		{
+			return false;
+		}
+
+		uint64_t numKnots = static_cast<uint64_t>(record.numUKnots) + record.numVKnots;
+		uint64_t numPoles = static_cast<uint64_t>(record.numUPoles) * record.numVPoles;
+		bool rational = record.flags & Rational;
+		return inFile(record.knots, numKnots, sizeof(double), fileSize) && inFile(record.mults, numKnots, sizeof(int32_t), fileSize) &&
+			inFile(record.poles, numPoles, 3 * sizeof(double), fileSize) &&
+			(rational ? record.weights != 0 && inFile(record.weights, numPoles, sizeof(double), fileSize) : record.weights == 0);
+	}
+
+	Record loadRecord(const unsigned char* data)
+	{
+		Record record;
+		std::memcpy(&record, data, sizeof(Record));
+		return record;
+	}
+}
+
+bool io::NativeFile::open(const std::string& filename, std::string& error)
+{
+	close();
+	if (!isLittleEndian())
+	{
+		error = "native files are read on little-endian hosts only";
+		return false;
+	}
+	if (!m_file.open(filename))
+	{
+		error = "cannot open " + filename;
+		return false;
+	}
+
+	Header header;
+	if (m_file.size() < sizeof(Header))
+	{
+		error = filename + " is not a native file";
+		close();
+		return false;
+	}
+	std::memcpy(&header, m_file.data(), sizeof(Header));
+	if (std::memcmp(header.magic, nativeMagic, sizeof(nativeMagic)) != 0)
+	{
+		error = filename + " is not a native file";
+		close();
+		return false;
+	}
+	if (header.version != nativeVersion || header.headerBytes != sizeof(Header))
+	{
+		error = filename + " has the unsupported native version " + std::to_string(header.version);
+		close();
+		return false;
+	}
+
+	uint64_t fileSize = m_file.size();
+	uint64_t numRecords = header.numCurves + header.numSurfaces;
+	if (header.fileSize != fileSize || header.numCurves > INT32_MAX || header.numSurfaces > INT32_MAX ||
+		!inFile(header.tableOffset, numRecords, sizeof(Record), fileSize))
+	{
+		error = filename + " is truncated or damaged";
+		close();
+		return false;
+	}
+
+	m_records = reinterpret_cast<const unsigned char*>(m_file.data()) + header.tableOffset;
+	m_numCurves = static_cast<int>(header.numCurves);
+	m_numSurfaces = static_cast<int>(header.numSurfaces);
+	for (uint64_t i = 0; i < numRecords; ++i)
+	{
+		Record record = loadRecord(m_records + i * sizeof(Record));
+		if (record.type != (i < header.numCurves ? CurveRecord : SurfaceRecord) || !checkRecord(record, fileSize))
+		{
+			error = filename + " has a damaged record " + std::to_string(i);
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void io::NativeFile::close()
+{
+	m_file.close();
+	m_numCurves = 0;
+	m_numSurfaces = 0;
+	m_records = nullptr;
+}
+
+int io::NativeFile::numCurves() const
+{
+	return m_numCurves;
+}
+
+int io::NativeFile::numSurfaces() const
+{
+	return m_numSurfaces;
+}
+
+const unsigned char* io::NativeFile::record(int index) const
+{
+	return m_records + static_cast<size_t>(index) * sizeof(Record);
+}
+
+io::NativeCurve io::NativeFile::curve(int index) const
+{
+	Record record = loadRecord(this->record(index));
+	const char* data = m_file.data();
+
+	NativeCurve curve;
+	curve.degree = record.uDegree;
+	curve.rational = record.flags & Rational;
+	curve.periodic = record.flags & UPeriodic;
+	curve.numKnots = record.numUKnots;
+	curve.knots = reinterpret_cast<const double*>(data + record.knots);
+	curve.mults = reinterpret_cast<const int32_t*>(data + record.mults);
+	curve.numPoles = record.numUPoles;
+	curve.poles = reinterpret_cast<const double*>(data + record.poles);
+	curve.weights = curve.rational ? reinterpret_cast<const double*>(data + record.weights) : nullptr;
+	return curve;
+}
+
+io::NativeSurface io::NativeFile::surface(int index) const
+{
+	Record record = loadRecord(this->record(m_numCurves + index));
+	const char* data = m_file.data();
+
+	NativeSurface surface;
+	surface.uDegree = record.uDegree;
+	surface.vDegree = record.vDegree;
+	surface.rational = record.flags & Rational;
+	surface.uPeriodic = record.flags & UPeriodic;
+	surface.vPeriodic = record.flags & VPeriodic;
+	surface.numUKnots = record.numUKnots;
+	surface.numVKnots = record.numVKnots;
+	surface.uKnots = reinterpret_cast<const double*>(data + record.knots);
+	surface.vKnots = surface.uKnots + record.numUKnots;
+	surface.uMults = reinterpret_cast<const int32_t*>(data + record.mults);
+	surface.vMults = surface.uMults + record.numUKnots;
+	surface.numUPoles = record.numUPoles;
+	surface.numVPoles = record.numVPoles;
+	surface.poles = reinterpret_cast<const double*>(data + record.poles);
+	surface.weights = surface.rational ? reinterpret_cast<const double*>(data + record.weights) : nullptr;
+	return surface;
+}
+
+Handle(Geom_BSplineCurve) io::NativeFile::makeCurve(int index) const
+{
+	NativeCurve view = curve(index);
+
+	// the arrays are built on the mapped memory, the curve copies them
+	TColgp_Array1OfPnt poles(*reinterpret_cast<const gp_Pnt*>(view.poles), 1, view.numPoles);
+	TColStd_Array1OfReal knots(*view.knots, 1, view.numKnots);
+	TColStd_Array1OfInteger mults(*reinterpret_cast<const Standard_Integer*>(view.mults), 1, view.numKnots);
+	if (view.rational)
+	{
+		TColStd_Array1OfReal weights(*view.weights, 1, view.numPoles);
+		return new Geom_BSplineCurve(poles, weights, knots, mults, view.degree, view.periodic);
+	}
+	return new Geom_BSplineCurve(poles, knots, mults, view.degree, view.periodic);
+}
+
+Handle(Geom_BSplineSurface) io::NativeFile::makeSurface(int index) const
+{
+	NativeSurface view = surface(index);
+
+	TColgp_Array2OfPnt poles(*reinterpret_cast<const gp_Pnt*>(view.poles), 1, view.numUPoles, 1, view.numVPoles);
+	TColStd_Array1OfReal uKnots(*view.uKnots, 1, view.numUKnots);
+	TColStd_Array1OfReal vKnots(*view.vKnots, 1, view.numVKnots);
+	TColStd_Array1OfInteger uMults(*reinterpret_cast<const Standard_Integer*>(view.uMults), 1, view.numUKnots);
+	TColStd_Array1OfInteger vMults(*reinterpret_cast<const Standard_Integer*>(view.vMults), 1, view.numVKnots);
+	if (view.rational)
+	{
+		TColStd_Array2OfReal weights(*view.weights, 1, view.numUPoles, 1, view.numVPoles);
+		return new Geom_BSplineSurface(poles, weights, uKnots, vKnots, uMults, vMults, view.uDegree, view.vDegree,
+			view.uPeriodic, view.vPeriodic);
+	}
+	return new Geom_BSplineSurface(poles, uKnots, vKnots, uMults, vMults, view.uDegree, view.vDegree, view.uPeriodic, view.vPeriodic);
+}
+
+bool io::saveNative(const std::string& filename, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+	const std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error)
+{
+	if (!isLittleEndian())
+	{
+		error = "native files are written on little-endian hosts only";
+		return false;
+	}
+
+	// the record table follows the header and the arrays follow the table
+	std::vector<Record> records;
+	records.reserve(curves.size() + surfaces.size());
+	for (const auto& curve : curves)
+	{
+		records.push_back(curveRecord(curve));
+	}
+	for (const auto& surface : surfaces)
+	{
+		records.push_back(surfaceRecord(surface));
+	}
+
+	uint64_t offset = sizeof(Header) + records.size() * sizeof(Record);
+	for (auto& record : records)
+	{
+		offset = align8(layoutRecord(record, offset));
+	}
+
+	Header header = {};
+	std::memcpy(header.magic, nativeMagic, sizeof(nativeMagic));
+	header.version = nativeVersion;
+	header.headerBytes = sizeof(Header);
+	header.numCurves = curves.size();
+	header.numSurfaces = surfaces.size();
+	header.tableOffset = sizeof(Header);
+	header.fileSize = offset;
+
+	std::ofstream output(filename, std::ios::binary);
+	if (!output)
+	{
+		error = "cannot write " + filename;
+		return false;
+	}
+	output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	output.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+
+	// OCC stores the arrays contiguously, so each one is written as a block
+	ArrayWriter writer(output, sizeof(Header) + records.size() * sizeof(Record));
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		const Record& record = records[i];
+		const Handle(Geom_BSplineCurve)& curve = curves[i];
+		writer.write(record.knots, &curve->Knots().First(), record.numUKnots * sizeof(double));
+		writer.write(record.mults, &curve->Multiplicities().First(), record.numUKnots * sizeof(int32_t));
+		writer.write(record.poles, &curve->Poles().First(), record.numUPoles * sizeof(gp_Pnt));
+		if (record.weights)
+		{
+			writer.write(record.weights, &curve->Weights()->First(), record.numUPoles * sizeof(double));
+		}
+	}
+	for (size_t i = 0; i < surfaces.size(); ++i)
+	{
+		const Record& record = records[curves.size() + i];
+		const Handle(Geom_BSplineSurface)& surface = surfaces[i];
+		const TColgp_Array2OfPnt& poles = surface->Poles();
+		size_t numPoles = static_cast<size_t>(record.numUPoles) * record.numVPoles;
+		writer.write(record.knots, &surface->UKnots().First(), record.numUKnots * sizeof(double));
+		writer.write(record.knots + record.numUKnots * sizeof(double), &surface->VKnots().First(), record.numVKnots * sizeof(double));
+		writer.write(record.mults, &surface->UMultiplicities().First(), record.numUKnots * sizeof(int32_t));
+		writer.write(record.mults + record.numUKnots * sizeof(int32_t), &surface->VMultiplicities().First(), record.numVKnots * sizeof(int32_t));
+		writer.write(record.poles, &poles(poles.LowerRow(), poles.LowerCol()), numPoles * sizeof(gp_Pnt));
+		if (record.weights)
+		{
+			const TColStd_Array2OfReal& weights = *surface->Weights();
+			writer.write(record.weights, &weights(weights.LowerRow(), weights.LowerCol()), numPoles * sizeof(double));
+		}
+	}
+	writer.write(offset, nullptr, 0);
+
+	if (!output.flush())
+	{
+		error = "cannot write " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool io::readNative(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves,
+	std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error)
+{
+	util::TraceScope trace("io::readNative", "io", filename);
+	curves.clear();
+	surfaces.clear();
+
+	NativeFile file;
+	if (!file.open(filename, error))
+	{
+		return false;
+	}
+
+	try
+	{
+		curves.reserve(file.numCurves());
+		for (int i = 0; i < file.numCurves(); ++i)
+		{
+			curves.push_back(file.makeCurve(i));
+		}
+		surfaces.reserve(file.numSurfaces());
+		for (int i = 0; i < file.numSurfaces(); ++i)
+		{
+			surfaces.push_back(file.makeSurface(i));
+		}
+	}
+	catch (Standard_Failure& failure)
+	{
+		error = filename + ": " + failure.GetMessageString();
+		curves.clear();
+		surfaces.clear();
+		return false;
+	}
+	return true;
+}
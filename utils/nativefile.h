@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <string>
+#include <Geom_BSplineCurve.hxx>
+#include <Geom_BSplineSurface.hxx>
+
+namespace io
+{
+	/*
+	 * Native binary format of B-spline curves and surfaces, version 1. All values are little-endian and every array
+	 * starts at a multiple of 8 bytes, so a mapped file is read in place.
+	 *
+	 *   header, 48 bytes:  magic "SKINNURB", uint32 version, uint32 header size, uint64 number of curves,
+	 *                      uint64 number of surfaces, uint64 offset of the record table, uint64 file size
+	 *   records, 64 bytes: uint32 type (1 curve, 2 surface), uint32 flags (1 rational, 2 periodic at u, 4 periodic at v),
+	 *                      int32 degree u and v, int32 knots at u and v, int32 poles at u and v,
+	 *                      uint64 offsets of the knots (u then v, double), of the multiplicities (u then v, int32),
+	 *                      of the poles (x, y, z doubles) and of the weights (double, 0 if not rational)
+	 *
+	 * The curves come first in the record table. The poles of a surface are stored row by row at u, pole (i, j) at
+	 * (i - 1) * poles at v + (j - 1), and curves have degree 0, no knot and one pole at v.
+	 **/
+	const uint32_t nativeVersion = 1;
+
+	// Curve of a native file, the arrays point into the file
+	struct NativeCurve
+	{
+		int degree = 0;
+		bool rational = false;
+		bool periodic = false;
+		int numKnots = 0;
+		const double* knots = nullptr;
+		const int32_t* mults = nullptr;
+		int numPoles = 0;
+		const double* poles = nullptr;	// x, y and z of each pole
+		const double* weights = nullptr;	// null if not rational
+	};
+
+	// Surface of a native file, the arrays point into the file
+	struct NativeSurface
+	{
+		int uDegree = 0, vDegree = 0;
+		bool rational = false;
+		bool uPeriodic = false, vPeriodic = false;
+		int numUKnots = 0, numVKnots = 0;
+		const double* uKnots = nullptr;
+		const double* vKnots = nullptr;
+		const int32_t* uMults = nullptr;
+		const int32_t* vMults = nullptr;
+		int numUPoles = 0, numVPoles = 0;
+		const double* poles = nullptr;	// x, y and z of each pole, row by row at u
+		const double* weights = nullptr;	// null if not rational
+	};
+
+	// Memory mapped native file, its curves and surfaces are views into the mapping and are not copied
+	class NativeFile
+	{
+	public:
+		// map the file and check the header and the bounds of every record
+		bool open(const std::string& filename, std::string& error);
+		void close();
+
+		int numCurves() const;
+		int numSurfaces() const;
+
+		// views valid until the file is closed
+		NativeCurve curve(int index) const;
+		NativeSurface surface(int index) const;
+
+		// OCC objects built on the views, OCC copies the arrays into its own, a failure throws Standard_Failure
+		Handle(Geom_BSplineCurve) makeCurve(int index) const;
+		Handle(Geom_BSplineSurface) makeSurface(int index) const;
+
+	private:
+		const unsigned char* record(int index) const;
+
+	private:
+		MappedFile m_file;
+		int m_numCurves = 0;
+		int m_numSurfaces = 0;
+		const unsigned char* m_records = nullptr;
+	};
+};
@@ -0,0 +1,1143 @@
+#include "utils.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <Eigen/Geometry>
+#include <Standard_Failure.hxx>
+
+/*
+ * Fast reader of the section curves of a STEP file.
+ *
+ * The data section is cut into chunks at entity boundaries and every chunk is indexed by a task: the id, the start
+ * of the record and the terminating ';' of each entity, and the kind of the few entities needed later. Nothing else
+ * is parsed. The representations are then walked down through curve sets and trimmed curves to their B-spline
+ * curves, the placements of the representation relationships give the transformation of each of them, and the
+ * curves are finally parsed with their points by parallel tasks and converted to millimetres.
+ **/
+
+namespace
+{
+	// bytes of the data section indexed by one task
+	const size_t scanChunkBytes = size_t(4) << 20;
+
+	// curves built by one task
+	const int curveBlock = 64;
+
+	// deepest chain of representations, sets or units followed
+	const int maxDepth = 64;
+
+	// Entities needed to resolve the curves, all others are only indexed
+	enum class Kind : unsigned char
+	{
+		Other,
+		Curve,	// B_SPLINE_CURVE_WITH_KNOTS, alone or within a complex rational entity
+		CurveSet,	// GEOMETRIC_CURVE_SET or GEOMETRIC_SET
+		TrimmedCurve,
+		Representation,
+		Relationship,	// representation relationship with a transformation
+		Unsupported	// topology, mapped items and composite curves, which are left to the full reader
+	};
+
+	// One entity "#id = record;" of the data section, the record is [begin, end)
+	struct Entity
+	{
+		int id;
+		Kind kind;
+		const char* begin;
+		const char* end;
+	};
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline bool isKeywordChar(char c)
+	{
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || isDigit(c) || c == '_';
+	}
+
+	// skip spaces and comments
+	const char* skipSpace(const char* p, const char* end)
+	{
+		while (p < end)
+		{
+			if (isSpace(*p))
+			{
+				++p;
+			}
+			else if (*p == '/' && p + 1 < end && p[1] == '*')
+			{
+				const char* close = p + 2;
+				while (close + 1 < end && !(close[0] == '*' && close[1] == '/'))
+				{
+					++close;
+				}
+				p = std::min(close + 2, end);
+			}
+			else
+			{
+				break;
+			}
+		}
+		return p;
+	}
+
+	// skip a quoted string starting at p, a doubled quote inside is an escaped one
+	const char* skipString(const char* p, const char* end)
+	{
+		char quote = *p++;
+		while (p < end)
+		{
+			if (*p++ == quote)
+			{
+				if (p < end && *p == quote)
+				{
+					++p;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+		return p;
+	}
+
+	// Reader of the parameters of one record, every call skips the spaces and comments before its token
+	class Parser
+	{
+	public:
+		Parser(const char* begin, const char* end) : m_p(begin), m_end(end) {}
+
+		const char* position() const { return m_p; }
+
+		bool peek(char c)
+		{
+			m_p = skipSpace(m_p, m_end);
+			return m_p < m_end && *m_p == c;
+		}
+
+		bool expect(char c)
+		{
+			if (!peek(c))
+			{
+				return false;
+			}
+			++m_p;
+			return true;
+		}
+
+		bool readKeyword(std::string_view& keyword)
+		{
+			m_p = skipSpace(m_p, m_end);
+			const char* begin = m_p;
+			while (m_p < m_end && isKeywordChar(*m_p))
+			{
+				++m_p;
+			}
+			keyword = std::string_view(begin, m_p - begin);
+			return m_p > begin;
+		}
+
+		// enumeration value such as .F. or .MILLI., $ gives an empty name
+		bool readEnumeration(std::string_view& name)
+		{
+			if (expect('$'))
+			{
+				name = std::string_view();
+				return true;
+			}
+			return expect('.') && readKeyword(name) && expect('.');
+		}
+
+		bool readInteger(int& value)
+		{
+			m_p = skipSpace(m_p, m_end);
+			if (m_p < m_end && *m_p == '+')
+			{
+				++m_p;
+			}
+			auto result = std::from_chars(m_p, m_end, value);
+			if (result.ec != std::errc())
+			{
+				return false;
+			}
+			m_p = result.ptr;
+			return true;
+		}
+
+		bool readReal(double& value)
+		{
+			m_p = skipSpace(m_p, m_end);
+			if (m_p < m_end && *m_p == '+')
+			{
+				++m_p;
+			}
+			auto result = std::from_chars(m_p, m_end, value);
+			if (result.ec != std::errc())
+			{
+				return false;
+			}
+			m_p = result.ptr;
+			return true;
+		}
+
+		bool readReference(int& id)
+		{
+			return expect('#') && readInteger(id);
+		}
+
+		// skip one parameter of any type, including lists and typed values such as LENGTH_MEASURE(1.)
+		bool skipValue()
+		{
+			m_p = skipSpace(m_p, m_end);
+			if (m_p >= m_end)
+			{
+				return false;
+			}
+			if (*m_p == '\'' || *m_p == '"')
+			{
+				m_p = skipString(m_p, m_end);
+				return true;
+			}
+			if (*m_p == '(')
+			{
+				int depth = 0;
+				while (m_p < m_end)
+				{
+					char c = *m_p;
+					if (c == '\'' || c == '"')
+					{
+						m_p = skipString(m_p, m_end);
+						continue;
+					}
+					++m_p;
+					if (c == '(')
+					{
+						++depth;
+					}
+					else if (c == ')' && --depth == 0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+			while (m_p < m_end && *m_p != ',' && *m_p != ')' && *m_p != '(' && !isSpace(*m_p))
+			{
+				++m_p;
+			}
+			// typed value
+			if (peek('('))
+			{
+				return skipValue();
+			}
+			return true;
+		}
+
+		// read "(a, b, ...)" by calling readItem for each item
+		template <class Func>
+		bool readList(Func readItem)
+		{
+			if (!expect('('))
+			{
+				return false;
+			}
+			if (expect(')'))
+			{
+				return true;
+			}
+			do
+			{
+				if (!readItem())
+				{
+					return false;
+				}
+			} while (expect(','));
+			return expect(')');
+		}
+
+		bool readReferences(std::vector<int>& ids)
+		{
+			ids.clear();
+			return readList([&]() { int id; if (!readReference(id)) return false; ids.push_back(id); return true; });
+		}
+
+		bool readIntegers(std::vector<int>& values)
+		{
+			values.clear();
+			return readList([&]() { int value; if (!readInteger(value)) return false; values.push_back(value); return true; });
+		}
+
+		bool readReals(std::vector<double>& values)
+		{
+			values.clear();
+			return readList([&]() { double value; if (!readReal(value)) return false; values.push_back(value); return true; });
+		}
+
+		// skip "count" parameters and the comma after each of them
+		bool skipValues(int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				if (!skipValue() || !expect(','))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		const char* m_p;
+		const char* m_end;
+	};
+
+	bool isComplex(const Entity& entity)
+	{
+		return *entity.begin == '(';
+	}
+
+	// position a parser after the opening parenthesis of the parameters of the record "name", which is the whole
+	// entity for a simple one and one of the partial records of a complex one
+	bool openRecord(const Entity& entity, std::string_view name, Parser& parser)
+	{
+		parser = Parser(entity.begin, entity.end);
+		std::string_view keyword;
+		if (!isComplex(entity))
+		{
+			return parser.readKeyword(keyword) && keyword == name && parser.expect('(');
+		}
+
+		parser.expect('(');
+		while (parser.readKeyword(keyword))
+		{
+			if (keyword == name)
+			{
+				return parser.expect('(');
+			}
+			if (!parser.skipValue())
+			{
+				return false;
+			}
+		}
+		return false;
+	}
+
+	// type of a simple entity
+	std::string_view simpleType(const char* begin, const char* end)
+	{
+		const char* p = begin;
+		while (p < end && isKeywordChar(*p))
+		{
+			++p;
+		}
+		return std::string_view(begin, p - begin);
+	}
+
+	// whether a complex record holds the partial record "name"
+	bool hasPartialRecord(const char* begin, const char* end, std::string_view name)
+	{
+		Entity entity{ 0, Kind::Other, begin, end };
+		Parser parser(begin, end);
+		return openRecord(entity, name, parser);
+	}
+
+	Kind classify(const char* begin, const char* end)
+	{
+		if (*begin == '(')
+		{
+			if (hasPartialRecord(begin, end, "B_SPLINE_CURVE_WITH_KNOTS"))
+			{
+				return Kind::Curve;
+			}
+			if (hasPartialRecord(begin, end, "REPRESENTATION_RELATIONSHIP_WITH_TRANSFORMATION"))
+			{
+				return Kind::Relationship;
+			}
+			return Kind::Other;
+		}
+
+		std::string_view type = simpleType(begin, end);
+		if (type == "CARTESIAN_POINT" || type == "DIRECTION")
+		{
+			return Kind::Other;
+		}
+		if (type == "B_SPLINE_CURVE_WITH_KNOTS")
+		{
+			return Kind::Curve;
+		}
+		if (type == "GEOMETRIC_CURVE_SET" || type == "GEOMETRIC_SET")
+		{
+			return Kind::CurveSet;
+		}
+		if (type == "TRIMMED_CURVE")
+		{
+			return Kind::TrimmedCurve;
+		}
+		if (type == "EDGE_CURVE" || type == "MAPPED_ITEM" || type == "COMPOSITE_CURVE" || type == "SURFACE_CURVE"
+			|| type == "SEAM_CURVE" || type == "INTERSECTION_CURVE")
+		{
+			return Kind::Unsupported;
+		}
+		// representations hold a name, their items and a context, unlike the other entities named *_REPRESENTATION
+		// such as SHAPE_DEFINITION_REPRESENTATION or PROPERTY_DEFINITION_REPRESENTATION, whose parameters are references
+		static const std::string_view suffix = "REPRESENTATION";
+		if (type.size() >= suffix.size() && type.substr(type.size() - suffix.size()) == suffix)
+		{
+			std::string_view keyword;
+			Parser parser(begin, end);
+			if (parser.readKeyword(keyword) && parser.expect('(') && parser.skipValues(1) && parser.peek('('))
+			{
+				return Kind::Representation;
+			}
+		}
+		return Kind::Other;
+	}
+
+	// whether "#digits =" starts at p
+	bool isEntityStart(const char* p, const char* end)
+	{
+		if (p >= end || *p != '#')
+		{
+			return false;
+		}
+		++p;
+		const char* digits = p;
+		while (p < end && isDigit(*p))
+		{
+			++p;
+		}
+		return p > digits && skipSpace(p, end) < end && *skipSpace(p, end) == '=';
+	}
+
+	// first entity start after p that follows the ';' ending an entity, or end
+	const char* nextEntityStart(const char* p, const char* begin, const char* end)
+	{
+		while (p < end)
+		{
+			p = static_cast<const char*>(std::memchr(p, '#', end - p));
+			if (!p)
+			{
+				return end;
+			}
+			const char* before = p;
+			while (before > begin && isSpace(before[-1]))
+			{
+				--before;
+			}
+			if (before > begin && before < p && before[-1] == ';' && isEntityStart(p, end))
+			{
+				return p;
+			}
+			++p;
+		}
+		return end;
+	}
+
+	// Entities of [begin, end) in file order, the scan stops at ENDSEC
+	struct ScanResult
+	{
+		std::vector<Entity> entities;
+		const char* stop = nullptr;	// position after the last entity
+		bool valid = true;
+	};
+
+	void scanEntities(const char* begin, const char* end, const char* fileEnd, ScanResult& result)
+	{
+		const char* p = skipSpace(begin, end);
+		while (p < end && *p == '#')
+		{
+			Entity entity;
+			Parser parser(p, fileEnd);
+			if (!parser.readReference(entity.id) || !parser.expect('='))
+			{
+				result.valid = false;
+				return;
+			}
+			const char* record = skipSpace(parser.position(), fileEnd);
+
+			// ';' only ends the entity outside strings and comments, so the first string or comment before it is skipped
+			const char* q = record;
+			while (q < fileEnd)
+			{
+				const char* semicolon = static_cast<const char*>(std::memchr(q, ';', fileEnd - q));
+				if (!semicolon)
+				{
+					q = fileEnd;
+					break;
+				}
+				const char* special = semicolon;
+				for (char c : { '\'', '"', '/' })
+				{
+					if (const void* found = std::memchr(q, c, special - q))
+					{
+						special = static_cast<const char*>(found);
+					}
+				}
+				if (special == semicolon)
+				{
+					q = semicolon;
+					break;
+				}
+				if (*special != '/')
+				{
+					q = skipString(special, fileEnd);
+				}
+				else
+				{
+					q = special + 1 < fileEnd && special[1] == '*' ? skipSpace(special, fileEnd) : special + 1;
+				}
+			}
+			if (q >= fileEnd || record == q)
+			{
+				result.valid = false;
+				return;
+			}
+
+			entity.begin = record;
+			entity.end = q;
+			entity.kind = classify(record, q);
+			result.entities.push_back(entity);
+			p = skipSpace(q + 1, fileEnd);
+		}
+		result.stop = p;
+	}
+
+	// Entities by id, a dense table when the ids are compact and a sorted one otherwise
+	class EntityIndex
+	{
+	public:
+		explicit EntityIndex(const std::vector<Entity>& entities)
+			: m_entities(entities)
+		{
+			int maxId = 0;
+			for (const auto& entity : entities)
+			{
+				maxId = std::max(maxId, entity.id);
+			}
+
+			if (static_cast<size_t>(maxId) <= 4 * entities.size() + 1024)
+			{
+				m_dense.assign(static_cast<size_t>(maxId) + 1, -1);
+				for (size_t i = 0; i < entities.size(); ++i)
+				{
+					m_dense[entities[i].id] = static_cast<int>(i);
+				}
+			}
+			else
+			{
+				m_sorted.reserve(entities.size());
+				for (size_t i = 0; i < entities.size(); ++i)
+				{
+					m_sorted.emplace_back(entities[i].id, static_cast<int>(i));
+				}
+				std::sort(m_sorted.begin(), m_sorted.end());
+			}
+		}
+
+		// position of the entity in file order, -1 if there is none
+		int position(int id) const
+		{
+			if (!m_dense.empty() || m_sorted.empty())
+			{
+				return id >= 0 && static_cast<size_t>(id) < m_dense.size() ? m_dense[id] : -1;
+			}
+			auto it = std::lower_bound(m_sorted.begin(), m_sorted.end(), std::make_pair(id, -1));
+			return it != m_sorted.end() && it->first == id ? it->second : -1;
+		}
+
+		const Entity* find(int id) const
+		{
+			int i = position(id);
+			return i < 0 ? nullptr : &m_entities[i];
+		}
+
+	private:
+		const std::vector<Entity>& m_entities;
+		std::vector<int> m_dense;
+		std::vector<std::pair<int, int>> m_sorted;
+	};
+
+	// millimetres per length unit, or 0 if the unit is not a length unit
+	double lengthUnitScale(const EntityIndex& index, int id, int depth)
+	{
+		const Entity* entity = index.find(id);
+		if (!entity || depth > maxDepth)
+		{
+			return 0.0;
+		}
+
+		Parser parser(entity->begin, entity->end);
+		if (!isComplex(*entity))
+		{
+			// LENGTH_MEASURE_WITH_UNIT(LENGTH_MEASURE(25.4),#unit) of a conversion based unit
+			std::string_view keyword;
+			double value;
+			int unit;
+			if (!openRecord(*entity, "LENGTH_MEASURE_WITH_UNIT", parser) || !parser.readKeyword(keyword) || !parser.expect('(')
+				|| !parser.readReal(value) || !parser.expect(')') || !parser.expect(',') || !parser.readReference(unit))
+			{
+				return 0.0;
+			}
+			return value * lengthUnitScale(index, unit, depth + 1);
+		}
+
+		if (!openRecord(*entity, "LENGTH_UNIT", parser))
+		{
+			return 0.0;
+		}
+		if (openRecord(*entity, "SI_UNIT", parser))
+		{
+			static const std::map<std::string_view, double> prefixes = {
+				{ "EXA", 1e18 }, { "PETA", 1e15 }, { "TERA", 1e12 }, { "GIGA", 1e9 }, { "MEGA", 1e6 }, { "KILO", 1e3 },
+				{ "HECTO", 1e2 }, { "DECA", 1e1 }, { "DECI", 1e-1 }, { "CENTI", 1e-2 }, { "MILLI", 1e-3 }, { "MICRO", 1e-6 },
+				{ "NANO", 1e-9 }, { "PICO", 1e-12 }, { "FEMTO", 1e-15 }, { "ATTO", 1e-18 } };
+
+			std::string_view prefix;
+			if (!parser.readEnumeration(prefix))
+			{
+				return 0.0;
+			}
+			auto it = prefixes.find(prefix);
+			return 1000.0 * (prefix.empty() ? 1.0 : it != prefixes.end() ? it->second : 0.0);
+		}
+		int measure;
+		if (openRecord(*entity, "CONVERSION_BASED_UNIT", parser) && parser.skipValues(1) && parser.readReference(measure))
+		{
+			return lengthUnitScale(index, measure, depth + 1);
+		}
+		return 0.0;
+	}
+
+	// millimetres per length unit of a representation context, lengths are taken as millimetres if it has none
+	double contextScale(const EntityIndex& index, int id)
+	{
+		const Entity* entity = index.find(id);
+		Parser parser(nullptr, nullptr);
+		std::vector<int> units;
+		if (entity && openRecord(*entity, "GLOBAL_UNIT_ASSIGNED_CONTEXT", parser) && parser.readReferences(units))
+		{
+			for (int unit : units)
+			{
+				double scale = lengthUnitScale(index, unit, 0);
+				if (scale > 0.0)
+				{
+					return scale;
+				}
+			}
+		}
+		return 1.0;
+	}
+
+	// coordinates of CARTESIAN_POINT or DIRECTION
+	bool readCoordinates(const Entity& entity, std::string_view type, double coordinates[3])
+	{
+		Parser parser(nullptr, nullptr);
+		int count = 0;
+		return openRecord(entity, type, parser) && parser.skipValues(1)
+			&& parser.readList([&]() { return count < 3 && parser.readReal(coordinates[count++]); }) && count == 3;
+	}
+
+	// placement of an AXIS2_PLACEMENT_3D, mapping its local coordinates to those of its representation
+	bool readPlacement(const EntityIndex& index, int id, double scale, Eigen::Isometry3d& placement)
+	{
+		const Entity* entity = index.find(id);
+		Parser parser(nullptr, nullptr);
+		int location;
+		if (!entity || !openRecord(*entity, "AXIS2_PLACEMENT_3D", parser) || !parser.skipValues(1) || !parser.readReference(location)
+			|| !parser.expect(','))
+		{
+			return false;
+		}
+
+		// optional axis and reference direction
+		double directions[2][3] = { { 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0 } };
+		for (int k = 0; k < 2; ++k)
+		{
+			int direction;
+			if (!parser.expect('$') && (!parser.readReference(direction) || !index.find(direction)
+				|| !readCoordinates(*index.find(direction), "DIRECTION", directions[k])))
+			{
+				return false;
+			}
+			if (k == 0 && !parser.expect(','))
+			{
+				return false;
+			}
+		}
+
+		double origin[3];
+		if (!index.find(location) || !readCoordinates(*index.find(location), "CARTESIAN_POINT", origin))
+		{
+			return false;
+		}
+
+		Eigen::Vector3d z(directions[0][0], directions[0][1], directions[0][2]);
+		Eigen::Vector3d x(directions[1][0], directions[1][1], directions[1][2]);
+		if (z.norm() == 0.0)
+		{
+			return false;
+		}
+		z.normalize();
+		x -= x.dot(z) * z;
+		if (x.norm() < 1e-12)
+		{
+			x = z.unitOrthogonal();
+		}
+		x.normalize();
+
+		placement.setIdentity();
+		placement.linear().col(0) = x;
+		placement.linear().col(1) = z.cross(x);
+		placement.linear().col(2) = z;
+		placement.translation() = scale * Eigen::Vector3d(origin[0], origin[1], origin[2]);
+		return true;
+	}
+
+	// One B-spline curve to build: its entity, the scale of its representation and the placement of one instance
+	struct CurveInstance
+	{
+		int position;	// of the curve entity in file order
+		double scale;
+		Eigen::Isometry3d placement;
+		bool identity;
+	};
+
+	// Buffers of one task building curves
+	struct CurveData
+	{
+		int degree = 0;
+		std::vector<int> points;
+		std::vector<int> mults;
+		std::vector<double> knots;
+		std::vector<double> weights;
+	};
+
+	// parameters of a B_SPLINE_CURVE_WITH_KNOTS, alone or within a complex rational entity
+	bool readCurve(const Entity& entity, CurveData& data)
+	{
+		Parser parser(nullptr, nullptr);
+		data.weights.clear();
+
+		if (!isComplex(entity))
+		{
+			// name, degree, points, form, closed, self intersect, multiplicities, knots, knot type
+			return openRecord(entity, "B_SPLINE_CURVE_WITH_KNOTS", parser) && parser.skipValues(1) && parser.readInteger(data.degree)
+				&& parser.expect(',') && parser.readReferences(data.points) && parser.expect(',') && parser.skipValues(3)
+				&& parser.readIntegers(data.mults) && parser.expect(',') && parser.readReals(data.knots);
+		}
+
+		if (!openRecord(entity, "B_SPLINE_CURVE", parser) || !parser.readInteger(data.degree) || !parser.expect(',')
+			|| !parser.readReferences(data.points))
+		{
+			return false;
+		}
+		if (!openRecord(entity, "B_SPLINE_CURVE_WITH_KNOTS", parser) || !parser.readIntegers(data.mults) || !parser.expect(',')
+			|| !parser.readReals(data.knots))
+		{
+			return false;
+		}
+		return !openRecord(entity, "RATIONAL_B_SPLINE_CURVE", parser) || parser.readReals(data.weights);
+	}
+
+	// build the curve of an instance, an empty string is returned on success
+	std::string buildCurve(const std::vector<Entity>& entities, const EntityIndex& index, const CurveInstance& instance,
+		CurveData& data, Handle(Geom_BSplineCurve)& curve)
+	{
+		const Entity& entity = entities[instance.position];
+		auto name = [&]() { return "curve #" + std::to_string(entity.id); };
+		if (!readCurve(entity, data))
+		{
+			return name() + " cannot be parsed";
+		}
+
+		int numPoles = static_cast<int>(data.points.size());
+		int numKnots = static_cast<int>(data.knots.size());
+		int sumMults = 0;
+		for (int mult : data.mults)
+		{
+			sumMults += mult;
+		}
+		if (data.degree < 1 || numKnots < 2 || static_cast<int>(data.mults.size()) != numKnots || sumMults != numPoles + data.degree + 1
+			|| (!data.weights.empty() && static_cast<int>(data.weights.size()) != numPoles))
+		{
+			return name() + " has inconsistent poles, knots or weights";
+		}
+
+		TColgp_Array1OfPnt poles(1, numPoles);
+		for (int i = 0; i < numPoles; ++i)
+		{
+			const Entity* point = index.find(data.points[i]);
+			double xyz[3];
+			if (!point || !readCoordinates(*point, "CARTESIAN_POINT", xyz))
+			{
+				return name() + " refers to a missing or non 3D point #" + std::to_string(data.points[i]);
+			}
+			Eigen::Vector3d p = instance.scale * Eigen::Vector3d(xyz[0], xyz[1], xyz[2]);
+			if (!instance.identity)
+			{
+				p = instance.placement * p;
+			}
+			poles.SetValue(i + 1, gp_Pnt(p.x(), p.y(), p.z()));
+		}
+
+		TColStd_Array1OfReal knots(1, numKnots);
+		TColStd_Array1OfInteger mults(1, numKnots);
+		for (int i = 0; i < numKnots; ++i)
+		{
+			knots.SetValue(i + 1, data.knots[i]);
+			mults.SetValue(i + 1, data.mults[i]);
+		}
+
+		try
+		{
+			if (data.weights.empty())
+			{
+				curve = new Geom_BSplineCurve(poles, knots, mults, data.degree);
+			}
+			else
+			{
+				TColStd_Array1OfReal weights(1, numPoles);
+				for (int i = 0; i < numPoles; ++i)
+				{
+					weights.SetValue(i + 1, data.weights[i]);
+				}
+				curve = new Geom_BSplineCurve(poles, weights, knots, mults, data.degree);
+			}
+		}
+		catch (Standard_Failure& failure)
+		{
+			return name() + ": " + failure.GetMessageString();
+		}
+		return std::string();
+	}
+
+	// collect the curves under an item of a representation, through curve sets and trimmed curves
+	bool collectItemCurves(const std::vector<Entity>& entities, const EntityIndex& index, int id, int depth, std::vector<int>& curves)
+	{
+		int position = index.position(id);
+		if (position < 0 || depth > maxDepth)
+		{
+			return false;
+		}
+
+		const Entity& entity = entities[position];
+		Parser parser(nullptr, nullptr);
+		std::vector<int> items;
+		int basis;
+		switch (entity.kind)
+		{
+		case Kind::Curve:
+			curves.push_back(position);
+			return true;
+		case Kind::CurveSet:
+			if (!openRecord(entity, simpleType(entity.begin, entity.end), parser) || !parser.skipValues(1) || !parser.readReferences(items))
+			{
+				return false;
+			}
+			for (int item : items)
+			{
+				if (!collectItemCurves(entities, index, item, depth + 1, curves))
+				{
+					return false;
+				}
+			}
+			return true;
+		case Kind::TrimmedCurve:
+			// the edge of a trimmed curve lies on its basis curve
+			return openRecord(entity, "TRIMMED_CURVE", parser) && parser.skipValues(1) && parser.readReference(basis)
+				&& collectItemCurves(entities, index, basis, depth + 1, curves);
+		default:
+			// placements, points and curves of other types hold no B-spline curve
+			return true;
+		}
+	}
+
+	// Representation placed into another one
+	struct Placement
+	{
+		int parent;	// position of the parent representation
+		Eigen::Isometry3d transformation;
+	};
+
+	// placements of all instances of a representation in the root representations
+	bool instancePlacements(const std::map<int, std::vector<Placement>>& parents, int representation, int depth,
+		std::vector<Eigen::Isometry3d>& placements)
+	{
+		if (depth > maxDepth)
+		{
+			return false;
+		}
+
+		auto it = parents.find(representation);
+		if (it == parents.end())
+		{
+			placements.push_back(Eigen::Isometry3d::Identity());
+			return true;
+		}
+
+		for (const Placement& placement : it->second)
+		{
+			std::vector<Eigen::Isometry3d> parentPlacements;
+			if (!instancePlacements(parents, placement.parent, depth + 1, parentPlacements))
+			{
+				return false;
+			}
+			for (const auto& parentPlacement : parentPlacements)
+			{
+				placements.push_back(parentPlacement * placement.transformation);
+			}
+		}
+		return true;
+	}
+}
+
+bool io::readStepCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error, int numThreads)
+{
+	util::TraceScope trace("io::readStepCurves", "io", filename);
+	curves.clear();
+
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		error = "cannot open " + filename;
+		return false;
+	}
+	const char* fileBegin = file.data();
+	const char* fileEnd = fileBegin + file.size();
+
+	// the data section starts after the header, whose strings may hold anything
+	const char* dataBegin = nullptr;
+	for (const char* p = fileBegin; p < fileEnd;)
+	{
+		if (*p == '\'' || *p == '"')
+		{
+			p = skipString(p, fileEnd);
+		}
+		else if (static_cast<size_t>(fileEnd - p) >= 5 && std::memcmp(p, "DATA", 4) == 0
+			&& (p == fileBegin || !isKeywordChar(p[-1])) && (p[4] == ';' || p[4] == '(' || isSpace(p[4])))
+		{
+			p = static_cast<const char*>(std::memchr(p, ';', fileEnd - p));
+			dataBegin = p ? p + 1 : nullptr;
+			break;
+		}
+		else
+		{
+			++p;
+		}
+	}
+	if (!dataBegin)
+	{
+		error = filename + " has no data section";
+		return false;
+	}
+
+	// chunks start at entity boundaries, a chunk that does not end exactly where the next one starts reveals a
+	// boundary misplaced inside a string, and the section is then indexed again in one piece
+	size_t numChunks = std::max<size_t>(1, static_cast<size_t>(fileEnd - dataBegin) / scanChunkBytes);
+	std::vector<const char*> bounds(numChunks + 1, fileEnd);
+	bounds[0] = skipSpace(dataBegin, fileEnd);
+	for (size_t k = 1; k < numChunks; ++k)
+	{
+		const char* from = std::max(bounds[k - 1] + 1, dataBegin + k * scanChunkBytes);
+		bounds[k] = from < fileEnd ? nextEntityStart(from, bounds[0], fileEnd) : fileEnd;
+	}
+
+	std::unique_ptr<util::ThreadPool> pool;
+	if (numThreads != 1 && numChunks > 1)
+	{
+		pool.reset(new util::ThreadPool(numThreads));
+	}
+
+	std::vector<ScanResult> chunks(numChunks);
+	auto scanChunks = [&](int first, int last)
+	{
+		for (int k = first; k < last; ++k)
+		{
+			scanEntities(bounds[k], bounds[k + 1], fileEnd, chunks[k]);
+		}
+	};
+	if (pool)
+	{
+		pool->parallelFor(0, static_cast<int>(numChunks), 1, scanChunks);
+	}
+	else
+	{
+		scanChunks(0, static_cast<int>(numChunks));
+	}
+
+	bool aligned = true;
+	for (size_t k = 0; k < numChunks; ++k)
+	{
+		aligned = aligned && chunks[k].valid && (k + 1 == numChunks || chunks[k].stop == bounds[k + 1]);
+	}
+	if (!aligned)
+	{
+		chunks.assign(1, ScanResult());
+		scanEntities(bounds[0], fileEnd, fileEnd, chunks[0]);
+		if (!chunks[0].valid)
+		{
+			error = filename + " holds a malformed entity";
+			return false;
+		}
+	}
+
+	std::vector<Entity> entities;
+	size_t numEntities = 0;
+	for (const auto& chunk : chunks)
+	{
+		numEntities += chunk.entities.size();
+	}
+	entities.reserve(numEntities);
+	for (auto& chunk : chunks)
+	{
+		entities.insert(entities.end(), chunk.entities.begin(), chunk.entities.end());
+		std::vector<Entity>().swap(chunk.entities);
+	}
+	EntityIndex index(entities);
+
+	// curves of every representation and the placements of representations into others
+	std::vector<std::pair<int, std::vector<int>>> representations;
+	std::map<int, double> scales;
+	std::map<int, std::vector<Placement>> parents;
+	for (size_t i = 0; i < entities.size(); ++i)
+	{
+		const Entity& entity = entities[i];
+		Parser parser(nullptr, nullptr);
+		if (entity.kind == Kind::Unsupported)
+		{
+			error = filename + " holds " + std::string(simpleType(entity.begin, entity.end)) + " entities, which are left to the full reader";
+			return false;
+		}
+		else if (entity.kind == Kind::Representation)
+		{
+			std::vector<int> items;
+			int context;
+			if (!openRecord(entity, simpleType(entity.begin, entity.end), parser) || !parser.skipValues(1) || !parser.readReferences(items)
+				|| !parser.expect(',') || !parser.readReference(context))
+			{
+				error = "representation #" + std::to_string(entity.id) + " cannot be parsed";
+				return false;
+			}
+			scales[static_cast<int>(i)] = contextScale(index, context);
+
+			std::vector<int> itemCurves;
+			for (int item : items)
+			{
+				if (!collectItemCurves(entities, index, item, 0, itemCurves))
+				{
+					error = "representation #" + std::to_string(entity.id) + " refers to a missing item";
+					return false;
+				}
+			}
+			if (!itemCurves.empty())
+			{
+				representations.emplace_back(static_cast<int>(i), std::move(itemCurves));
+			}
+		}
+	}
+
+	for (const auto& entity : entities)
+	{
+		if (entity.kind != Kind::Relationship)
+		{
+			continue;
+		}
+
+		// the first representation is placed into the second one, the transformation maps the first placement onto the second
+		Parser parser(nullptr, nullptr);
+		int child, parent, operation, origin, target;
+		const Entity* transformation = nullptr;
+		bool valid = openRecord(entity, "REPRESENTATION_RELATIONSHIP", parser) && parser.skipValues(2) && parser.readReference(child)
+			&& parser.expect(',') && parser.readReference(parent)
+			&& openRecord(entity, "REPRESENTATION_RELATIONSHIP_WITH_TRANSFORMATION", parser) && parser.readReference(operation)
+			&& (transformation = index.find(operation)) != nullptr
+			&& openRecord(*transformation, "ITEM_DEFINED_TRANSFORMATION", parser) && parser.skipValues(2)
+			&& parser.readReference(origin) && parser.expect(',') && parser.readReference(target);
+
+		Eigen::Isometry3d from, to;
+		int childPosition = index.position(child), parentPosition = index.position(parent);
+		valid = valid && childPosition >= 0 && parentPosition >= 0 && scales.count(childPosition) && scales.count(parentPosition)
+			&& readPlacement(index, origin, scales[childPosition], from) && readPlacement(index, target, scales[parentPosition], to);
+		if (!valid)
+		{
+			error = "transformation of relationship #" + std::to_string(entity.id) + " is not supported";
+			return false;
+		}
+		parents[childPosition].push_back({ parentPosition, to * from.inverse() });
+	}
+
+	// one instance per placement of every representation holding a curve, sorted by curve in file order
+	std::vector<CurveInstance> instances;
+	for (const auto& representation : representations)
+	{
+		std::vector<Eigen::Isometry3d> placements;
+		if (!instancePlacements(parents, representation.first, 0, placements))
+		{
+			error = "representation #" + std::to_string(entities[representation.first].id) + " is placed in a cycle";
+			return false;
+		}
+		for (int position : representation.second)
+		{
+			for (const auto& placement : placements)
+			{
+				bool identity = placement.matrix() == Eigen::Matrix4d::Identity();
+				instances.push_back({ position, scales[representation.first], placement, identity });
+			}
+		}
+	}
+	std::stable_sort(instances.begin(), instances.end(),
+		[](const CurveInstance& a, const CurveInstance& b) { return a.position < b.position; });
+
+	// parse and build the curves
+	curves.resize(instances.size());
+	std::vector<std::string> errors(instances.size());
+	auto buildCurves = [&](int first, int last)
+	{
+		CurveData data;
+		for (int i = first; i < last; ++i)
+		{
+			errors[i] = buildCurve(entities, index, instances[i], data, curves[i]);
+		}
+	};
+	int numInstances = static_cast<int>(instances.size());
+	if (numThreads != 1 && numInstances > curveBlock)
+	{
+		if (!pool)
+		{
+			pool.reset(new util::ThreadPool(numThreads));
+		}
+		pool->parallelFor(0, numInstances, curveBlock, buildCurves);
+	}
+	else
+	{
+		buildCurves(0, numInstances);
+	}
+
+	for (const auto& message : errors)
+	{
+		if (!message.empty())
+		{
+			curves.clear();
+			error = filename + ": " + message;
+			return false;
+		}
+	}
+	return true;
+}
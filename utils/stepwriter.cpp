@@ -0,0 +1,527 @@
+#include "stepwriter.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <filesystem>
+#include <TColgp_Array2OfPnt.hxx>
+#include <TColStd_Array2OfReal.hxx>
+
+namespace
+{
+	// ids of the entities written at the start of every file
+	const int contextId = 14;
+	const int productShapeId = 9;
+	const int firstItemId = 15;
+
+	// string literal of Part 21, apostrophes and backslashes are doubled
+	std::string stepString(const std::string& text)
+	{
+		std::string literal = "'";
+		for (char c : text)
+		{
+			literal += c;
+			if (c == '\'' || c == '\\')
+			{
+				literal += c;
+			}
+		}
+		return literal + "'";
+	}
+
+	// name of shard "index" of a file, "name_1.step" for the first one
+	std::string shardName(const std::string& filename, int index)
+	{
+		std::filesystem::path path(filename);
+		std::filesystem::path name = path.stem().string() + "_" + std::to_string(index) + path.extension().string();
+		return (path.parent_path() / name).string();
+	}
+
+	std::string timeStamp()
+	{
+		std::time_t now = std::time(nullptr);
+		char text[32] = "";
+		std::tm local = {};
+#ifdef _WIN32
+		localtime_s(&local, &now);
+#else
+		localtime_r(&now, &local);
+#endif
+		std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &local);
+		return text;
+	}
+}
+
+io::StepStreamWriter::StepStreamWriter(const StepStreamOptions& options)
+	: m_options{ options }
+{
+	m_options.setSize = std::max(m_options.setSize, 1);
+}
+
+io::StepStreamWriter::~StepStreamWriter()
+{
+	std::string error;
+	close(error);
+}
+
+bool io::StepStreamWriter::open(const std::string& filename, std::string& error)
+{
+	if (!close(error))
+	{
+		return false;
+	}
+	m_filename = filename;
+	m_files.clear();
+	m_totalBytes = 0;
+	m_numItems = 0;
+	return true;
+}
+
+bool io::StepStreamWriter::add(const Handle(Geom_BSplineCurve)& curve, std::string& error)
+{
+	if (m_filename.empty())
+	{
+		error = "no STEP file is open";
+		return false;
+	}
+	if (!m_file && !beginFile(error))
+	{
+		return false;
+	}
+
+	if (curve->IsPeriodic())
+	{
+		Handle(Geom_BSplineCurve) copy = Handle(Geom_BSplineCurve)::DownCast(curve->Copy());
+		copy->SetNotPeriodic();
+		writeCurve(copy);
+	}
+	else
+	{
+		writeCurve(curve);
+	}
+	return endItem(false, error);
+}
+
+bool io::StepStreamWriter::add(const Handle(Geom_BSplineSurface)& surface, std::string& error)
+{
+	if (m_filename.empty())
+	{
+		error = "no STEP file is open";
+		return false;
+	}
+	if (!m_file && !beginFile(error))
+	{
+		return false;
+	}
+
+	if (surface->IsUPeriodic() || surface->IsVPeriodic())
+	{
+		Handle(Geom_BSplineSurface) copy = Handle(Geom_BSplineSurface)::DownCast(surface->Copy());
+		copy->SetUNotPeriodic();
+		copy->SetVNotPeriodic();
+		writeSurface(copy);
+	}
+	else
+	{
+		writeSurface(surface);
+	}
+	m_hasSurfaces = true;
+	return endItem(true, error);
+}
+
+bool io::StepStreamWriter::close(std::string& error)
+{
+	bool success = !m_file || endFile(error);
+	m_filename.clear();
+	return success;
+}
+
+const std::vector<std::string>& io::StepStreamWriter::files() const
+{
+	return m_files;
+}
+
+uint64_t io::StepStreamWriter::bytesWritten() const
+{
+	return m_totalBytes + m_fileBytes + m_buffer.size();
+}
+
+uint64_t io::StepStreamWriter::numItems() const
+{
+	return m_numItems;
+}
+
+bool io::StepStreamWriter::beginFile(std::string& error)
+{
+	std::string filename = m_options.maxShardBytes > 0 ? shardName(m_filename, static_cast<int>(m_files.size()) + 1) : m_filename;
+	m_file = std::fopen(filename.c_str(), "wb");
+	if (!m_file)
+	{
+		error = "cannot write " + filename;
+		return false;
+	}
+	m_files.push_back(filename);
+	m_buffer.clear();
+	m_buffer.reserve(m_options.bufferBytes + (1 << 16));
+	m_fileBytes = 0;
+	m_failed = false;
+	m_hasSurfaces = false;
+	m_items.clear();
+	m_sets.clear();
+
+	// header, product and units, with the fixed ids of the constants above
+	std::string product = stepString(m_options.productName);
+	put("ISO-10303-21;\nHEADER;\nFILE_DESCRIPTION(('B-spline curves and surfaces'),'2;1');\n");
+	put("FILE_NAME(" + stepString(std::filesystem::path(filename).filename().string()) + ",'" + timeStamp() + "',(''),(''),'skin','skin','');\n");
+	put("FILE_SCHEMA(('AUTOMOTIVE_DESIGN { 1 0 10303 214 1 1 1 1 }'));\nENDSEC;\nDATA;\n");
+	put("#1=APPLICATION_CONTEXT('core data for automotive mechanical design processes');\n"
+		"#2=APPLICATION_PROTOCOL_DEFINITION('international standard','automotive_design',2000,#1);\n"
+		"#3=PRODUCT_CONTEXT('',#1,'mechanical');\n");
+	put("#4=PRODUCT(" + product + "," + product + ",'',(#3));\n");
+	put("#5=PRODUCT_RELATED_PRODUCT_CATEGORY('part',$,(#4));\n"
+		"#6=PRODUCT_DEFINITION_FORMATION('','',#4);\n"
+		"#7=PRODUCT_DEFINITION_CONTEXT('part definition',#1,'design');\n"
+		"#8=PRODUCT_DEFINITION('design','',#6,#7);\n"
+		"#9=PRODUCT_DEFINITION_SHAPE('','',#8);\n"
+		"#10=( LENGTH_UNIT() NAMED_UNIT(*) SI_UNIT(.MILLI.,.METRE.) );\n"
+		"#11=( NAMED_UNIT(*) PLANE_ANGLE_UNIT() SI_UNIT($,.RADIAN.) );\n"
+		"#12=( NAMED_UNIT(*) SI_UNIT($,.STERADIAN.) SOLID_ANGLE_UNIT() );\n"
+		"#13=UNCERTAINTY_MEASURE_WITH_UNIT(LENGTH_MEASURE(1.E-07),#10,'distance_accuracy_value','confusion accuracy');\n"
+		"#14=( GEOMETRIC_REPRESENTATION_CONTEXT(3) GLOBAL_UNCERTAINTY_ASSIGNED_CONTEXT((#13)) "
+		"GLOBAL_UNIT_ASSIGNED_CONTEXT((#10,#11,#12)) REPRESENTATION_CONTEXT('Context #1','3D Context with UNIT and UNCERTAINTY') );\n");
+	m_nextId = firstItemId;
+	return true;
+}
+
+bool io::StepStreamWriter::endFile(std::string& error)
+{
+	endSet();
+
+	// the representation of all sets, tied to the product
+	int representation = m_nextId++;
+	put("#");
+	putInteger(representation);
+	put(m_hasSurfaces ? "=GEOMETRICALLY_BOUNDED_SURFACE_SHAPE_REPRESENTATION(" : "=GEOMETRICALLY_BOUNDED_WIREFRAME_SHAPE_REPRESENTATION(");
+	put(stepString(m_options.productName) + ",(");
+	for (size_t i = 0; i < m_sets.size(); ++i)
+	{
+		put(i == 0 ? "" : ",");
+		putReference(m_sets[i]);
+	}
+	put("),");
+	putReference(contextId);
+	put(");\n#");
+	putInteger(m_nextId++);
+	put("=SHAPE_DEFINITION_REPRESENTATION(");
+	putReference(productShapeId);
+	put(",");
+	putReference(representation);
+	put(");\nENDSEC;\nEND-ISO-10303-21;\n");
+
+	bool success = flush(error);
+	if (std::fclose(m_file) != 0 && success)
+	{
+		error = "cannot write " + m_files.back();
+		success = false;
+	}
+	m_file = nullptr;
+	m_totalBytes += m_fileBytes;
+	m_fileBytes = 0;
+	m_sets.clear();
+	return success;
+}
+
+bool io::StepStreamWriter::endItem(bool surface, std::string& error)
+{
+	int item = m_nextId - 1;
+	if (!m_items.empty() && m_setOfSurfaces != surface)
+	{
+		endSet();
+	}
+	m_setOfSurfaces = surface;
+	m_items.push_back(item);
+	if (static_cast<int>(m_items.size()) >= m_options.setSize)
+	{
+		endSet();
+	}
+	++m_numItems;
+
+	spill();
+	if (m_failed)
+	{
+		error = "cannot write " + m_files.back();
+		return false;
+	}
+	if (m_options.maxShardBytes > 0 && m_fileBytes + m_buffer.size() >= m_options.maxShardBytes)
+	{
+		return endFile(error);
+	}
+	return true;
+}
+
+void io::StepStreamWriter::endSet()
+{
+	if (m_items.empty())
+	{
+		return;
+	}
+
+	int set = m_nextId++;
+	put("#");
+	putInteger(set);
+	put(m_setOfSurfaces ? "=GEOMETRIC_SET('',(" : "=GEOMETRIC_CURVE_SET('',(");
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		put(i == 0 ? "" : ",");
+		putReference(m_items[i]);
+	}
+	put("));\n");
+	m_sets.push_back(set);
+	m_items.clear();
+}
+
+void io::StepStreamWriter::spill()
+{
+	if (m_buffer.size() < m_options.bufferBytes)
+	{
+		return;
+	}
+	if (!m_failed && std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size())
+	{
+		m_failed = true;
+	}
+	m_fileBytes += m_buffer.size();
+	m_buffer.clear();
+}
+
+bool io::StepStreamWriter::flush(std::string& error)
+{
+	if (!m_failed && !m_buffer.empty() && std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size())
+	{
+		m_failed = true;
+	}
+	m_fileBytes += m_buffer.size();
+	m_buffer.clear();
+	if (m_failed)
+	{
+		error = "cannot write " + m_files.back();
+		return false;
+	}
+	return true;
+}
+
+int io::StepStreamWriter::writePoles(const gp_Pnt* poles, int count)
+{
+	int first = m_nextId;
+	for (int i = 0; i < count; ++i)
+	{
+		put("#");
+		putInteger(m_nextId++);
+		put("=CARTESIAN_POINT('',(");
+		putReal(poles[i].X());
+		put(",");
+		putReal(poles[i].Y());
+		put(",");
+		putReal(poles[i].Z());
+		put("));\n");
+		spill();
+	}
+	return first;
+}
+
+void io::StepStreamWriter::writeCurve(const Handle(Geom_BSplineCurve)& curve)
+{
+	int numPoles = curve->NbPoles();
+	int firstPole = writePoles(&curve->Poles().First(), numPoles);
+
+	put("#");
+	putInteger(m_nextId++);
+	if (curve->IsRational())
+	{
+		put("=( BOUNDED_CURVE() B_SPLINE_CURVE(");
+	}
+	else
+	{
+		put("=B_SPLINE_CURVE_WITH_KNOTS('',");
+	}
+	putInteger(curve->Degree());
+	put(",");
+	putReferenceRange(firstPole, numPoles);
+	put(",.UNSPECIFIED.,.F.,.F.");
+	put(curve->IsRational() ? ") B_SPLINE_CURVE_WITH_KNOTS(" : ",");
+	putIntegers(curve->Multiplicities());
+	put(",");
+	putReals(curve->Knots());
+	put(",.UNSPECIFIED.");
+	if (curve->IsRational())
+	{
+		put(") CURVE() GEOMETRIC_REPRESENTATION_ITEM() RATIONAL_B_SPLINE_CURVE(");
+		putReals(*curve->Weights());
+		put(") REPRESENTATION_ITEM('') );\n");
+	}
+	else
+	{
+		put(");\n");
+	}
+}
+
+void io::StepStreamWriter::writeSurface(const Handle(Geom_BSplineSurface)& surface)
+{
+	const TColgp_Array2OfPnt& poles = surface->Poles();
+	int numUPoles = surface->NbUPoles();
+	int numVPoles = surface->NbVPoles();
+	int firstPole = writePoles(&poles(poles.LowerRow(), poles.LowerCol()), numUPoles * numVPoles);
+	bool rational = surface->IsURational() || surface->IsVRational();
+
+	put("#");
+	putInteger(m_nextId++);
+	put(rational ? "=( BOUNDED_SURFACE() B_SPLINE_SURFACE(" : "=B_SPLINE_SURFACE_WITH_KNOTS('',");
+	putInteger(surface->UDegree());
+	put(",");
+	putInteger(surface->VDegree());
+	put(",(");
+	for (int i = 0; i < numUPoles; ++i)
+	{
+		put(i == 0 ? "" : ",");
+		putReferenceRange(firstPole + i * numVPoles, numVPoles);
+	}
+	put("),.UNSPECIFIED.,.F.,.F.,.F.");
+	put(rational ? ") B_SPLINE_SURFACE_WITH_KNOTS(" : ",");
+	putIntegers(surface->UMultiplicities());
+	put(",");
+	putIntegers(surface->VMultiplicities());
+	put(",");
+	putReals(surface->UKnots());
+	put(",");
+	putReals(surface->VKnots());
+	put(",.UNSPECIFIED.");
+	if (rational)
+	{
+		const TColStd_Array2OfReal& weights = *surface->Weights();
+		put(") GEOMETRIC_REPRESENTATION_ITEM() RATIONAL_B_SPLINE_SURFACE((");
+		for (int i = weights.LowerRow(); i <= weights.UpperRow(); ++i)
+		{
+			put(i == weights.LowerRow() ? "(" : ",(");
+			for (int j = weights.LowerCol(); j <= weights.UpperCol(); ++j)
+			{
+				put(j == weights.LowerCol() ? "" : ",");
+				putReal(weights(i, j));
+			}
+			put(")");
+		}
+		put(")) REPRESENTATION_ITEM('') SURFACE() );\n");
+	}
+	else
+	{
+		put(");\n");
+	}
+}
+
+void io::StepStreamWriter::put(const char* text)
+{
+	m_buffer += text;
+}
+
+void io::StepStreamWriter::put(const std::string& text)
+{
+	m_buffer += text;
+}
+
+void io::StepStreamWriter::putInteger(long long value)
+{
+	char text[24];
+	char* end = std::to_chars(text, text + sizeof(text), value).ptr;
+	m_buffer.append(text, end);
+}
+
+void io::StepStreamWriter::putReal(double value)
+{
+	// shortest text reading back to the same value, with the decimal point and the upper case exponent of Part 21
+	char text[40];
+	char* end = std::to_chars(text, text + sizeof(text), value).ptr;
+	char* exponent = std::find(text, end, 'e');
+	if (std::find(text, exponent, '.') == exponent)
+	{
+		std::copy_backward(exponent, end, end + 1);
+		*exponent++ = '.';
+		++end;
+	}
+	if (exponent != end)
+	{
+		*exponent = 'E';
+	}
+	m_buffer.append(text, end);
+}
+
+void io::StepStreamWriter::putReference(int id)
+{
+	m_buffer += '#';
+	putInteger(id);
+}
+
+void io::StepStreamWriter::putIntegers(const TColStd_Array1OfInteger& values)
+{
+	put("(");
+	for (int i = values.Lower(); i <= values.Upper(); ++i)
+	{
+		put(i == values.Lower() ? "" : ",");
+		putInteger(values(i));
+	}
+	put(")");
+}
+
+void io::StepStreamWriter::putReals(const TColStd_Array1OfReal& values)
+{
+	put("(");
+	for (int i = values.Lower(); i <= values.Upper(); ++i)
+	{
+		put(i == values.Lower() ? "" : ",");
+		putReal(values(i));
+	}
+	put(")");
+}
+
+void io::StepStreamWriter::putReferenceRange(int first, int count)
+{
+	put("(");
+	for (int i = 0; i < count; ++i)
+	{
+		put(i == 0 ? "" : ",");
+		putReference(first + i);
+	}
+	put(")");
+}
+
+bool io::saveStepStream(const std::string& filename, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+	const std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error, uint64_t maxShardBytes,
+	std::vector<std::string>* files)
+{
+	StepStreamOptions options;
+	options.maxShardBytes = maxShardBytes;
+	StepStreamWriter writer(options);
+	if (!writer.open(filename, error))
+	{
+		return false;
+	}
+	for (const auto& curve : curves)
+	{
+		if (!writer.add(curve, error))
+		{
+			return false;
+		}
+	}
+	for (const auto& surface : surfaces)
+	{
+		if (!writer.add(surface, error))
+		{
+			return false;
+		}
+	}
+	bool success = writer.close(error);
+	if (files)
+	{
+		*files = writer.files();
+	}
+	return success;
+}
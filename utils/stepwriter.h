@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <Geom_BSplineCurve.hxx>
+#include <Geom_BSplineSurface.hxx>
+
+namespace io
+{
+	// Options of StepStreamWriter
+	struct StepStreamOptions
+	{
+		uint64_t maxShardBytes = 0;	// a file growing over this size is closed and the next items go to a new one, 0 writes one file
+		int setSize = 1024;	// items per geometric set
+		size_t bufferBytes = 1 << 20;	// output written by blocks of this size
+		std::string productName = "skin";
+	};
+
+	/*
+	 * STEP AP214 writer emitting each B-spline curve or surface as soon as it is added, without any OCC model. The
+	 * poles and the B-spline entity of an item are formatted into a fixed buffer and written out, only the ids of
+	 * the items of the current geometric set and of the finished sets are kept, so memory stays bounded by the
+	 * size of one item however many are written. Each file is complete: the product and the units (millimetres)
+	 * come first, then the items grouped by geometric sets, and the geometrically bounded representation of the
+	 * sets comes last, wireframe if the file holds only curves and surface otherwise. Surfaces are read back as
+	 * faces bounded by their natural boundaries.
+	 *
+	 * With maxShardBytes the output is split into "name_1.step", "name_2.step", ... and a file is closed as soon
+	 * as it grows over the bound, so every shard stands on its own.
+	 **/
+	class StepStreamWriter
+	{
+	public:
+		explicit StepStreamWriter(const StepStreamOptions& options = StepStreamOptions());
+		~StepStreamWriter();
+
+		StepStreamWriter(const StepStreamWriter&) = delete;
+		StepStreamWriter& operator=(const StepStreamWriter&) = delete;
+
+		// start writing to filename, or to its shards, nothing is created before the first item
+		bool open(const std::string& filename, std::string& error);
+
+		// periodic curves and surfaces are written as their non-periodic forms
+		bool add(const Handle(Geom_BSplineCurve)& curve, std::string& error);
+		bool add(const Handle(Geom_BSplineSurface)& surface, std::string& error);
+
+		// finish the last file
+		bool close(std::string& error);
+
+		const std::vector<std::string>& files() const;	// files written so far
+		uint64_t bytesWritten() const;	// bytes of all files
+		uint64_t numItems() const;
+
+	private:
+		bool beginFile(std::string& error);
+		bool endFile(std::string& error);
+		bool endItem(bool surface, std::string& error);
+		void endSet();
+		void spill();
+		bool flush(std::string& error);
+
+		int writePoles(const gp_Pnt* poles, int count);	// returns the id of the first pole
+		void writeCurve(const Handle(Geom_BSplineCurve)& curve);
+		void writeSurface(const Handle(Geom_BSplineSurface)& surface);
+
+		void put(const char* text);
+		void put(const std::string& text);
+		void putInteger(long long value);
+		void putReal(double value);
+		void putReference(int id);
+		void putIntegers(const TColStd_Array1OfInteger& values);
+		void putReals(const TColStd_Array1OfReal& values);
+		void putReferenceRange(int first, int count);
+
+	private:
+		StepStreamOptions m_options;
+		std::string m_filename;
+		std::FILE* m_file = nullptr;
+		std::string m_buffer;
+		std::vector<std::string> m_files;
+		uint64_t m_fileBytes = 0;	// bytes of the current file out of the buffer
+		uint64_t m_totalBytes = 0;	// bytes of the finished files
+		uint64_t m_numItems = 0;
+		int m_nextId = 1;
+		bool m_failed = false;	// a write to the current file failed
+		bool m_hasSurfaces = false;
+		std::vector<int> m_items;	// items of the current set
+		bool m_setOfSurfaces = false;
+		std::vector<int> m_sets;	// finished sets of the current file
+	};
+};
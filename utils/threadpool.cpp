@@ -0,0 +1,239 @@
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+namespace
+{
+	// Shared state of one parallelFor call, helpers keep it alive until they return
+	struct ParallelForState
+	{
+		std::function<void(int, int)> func;
+		int begin = 0;
+		int end = 0;
+		int grain = 1;
+		int numChunks = 0;
+
+		std::atomic<int> nextChunk{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr exception;
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		int activeHelpers = 0;
+		bool closed = false;	// every chunk was taken, helpers starting now have nothing to do
+
+		// grab chunks until none is left
+		void run()
+		{
+			for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+			{
+				if (failed)
+				{
+					continue;
+				}
+
+				int first = begin + chunk * grain;
+				int last = std::min(end, first + grain);
+				try
+				{
+					func(first, last);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!failed.exchange(true))
+					{
+						exception = std::current_exception();
+					}
+				}
+			}
+		}
+
+		// run chunks on a worker, the caller waits for the helpers which started before the loop was closed
+		void help()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (closed)
+				{
+					return;
+				}
+				++activeHelpers;
+			}
+
+			run();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--activeHelpers == 0)
+			{
+				finished.notify_one();
+			}
+		}
+	};
+
+	// pool and deque of the calling thread when it is a worker
+	thread_local const util::ThreadPool* currentPool = nullptr;
+	thread_local int currentQueue = -1;
+}
+
+util::ThreadPool::ThreadPool(int numThreads)
+	: m_numPending{ 0 }, m_nextQueue{ 0 }, m_stop{ false }
+{
+	if (numThreads <= 0)
+	{
+		numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	// the calling thread is the last worker
+	for (int i = 1; i < numThreads; ++i)
+	{
+		m_queues.emplace_back(std::make_unique<Queue>());
+	}
+	for (int i = 1; i < numThreads; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i - 1);
+	}
+}
+
+util::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+int util::ThreadPool::size() const
+{
+	return static_cast<int>(m_workers.size()) + 1;
+}
+
+void util::ThreadPool::submit(std::function<void()> task)
+{
+	if (m_workers.empty())
+	{
+		task();
+		return;
+	}
+
+	// a worker keeps its own tasks, the others are dealt round the deques
+	int index = currentPool == this ? currentQueue : static_cast<int>(m_nextQueue++ % m_queues.size());
+	{
+		std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+		m_queues[index]->tasks.emplace_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_numPending;
+	}
+	m_condition.notify_one();
+}
+
+void util::ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& func)
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	grain = std::max(1, grain);
+	int numChunks = (end - begin + grain - 1) / grain;
+	if (numChunks == 1 || m_workers.empty())
+	{
+		for (int first = begin; first < end; first += grain)
+		{
+			func(first, std::min(end, first + grain));
+		}
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>();
+	state->func = func;
+	state->begin = begin;
+	state->end = end;
+	state->grain = grain;
+	state->numChunks = numChunks;
+
+	// at most one helper per remaining chunk
+	int numHelpers = std::min(static_cast<int>(m_workers.size()), numChunks - 1);
+	for (int i = 0; i < numHelpers; ++i)
+	{
+		submit([state]() { state->help(); });
+	}
+
+	state->run();
+
+	// wait for the helpers still working on their last chunk, the ones not started yet will return at once
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->closed = true;
+	state->finished.wait(lock, [&state]() { return state->activeHelpers == 0; });
+
+	if (state->exception)
+	{
+		std::rethrow_exception(state->exception);
+	}
+}
+
+bool util::ThreadPool::popTask(int index, std::function<void()>& task)
+{
+	{
+		Queue& own = *m_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	int numQueues = static_cast<int>(m_queues.size());
+	for (int k = 1; k < numQueues; ++k)
+	{
+		Queue& victim = *m_queues[(index + k) % numQueues];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void util::ThreadPool::workerLoop(int index)
+{
+	trace::setThreadName("pool worker");
+	currentPool = this;
+	currentQueue = index;
+
+	for (;;)
+	{
+		std::function<void()> task;
+		if (popTask(index, task))
+		{
+			--m_numPending;
+			task();
+			continue;
+		}
+
+		// sleep until a task is submitted, the pending tasks are run before stopping
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this]() { return m_stop || m_numPending > 0; });
+		if (m_stop && m_numPending <= 0)
+		{
+			return;
+		}
+	}
+}
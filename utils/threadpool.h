@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace util
+{
+	/*
+	 * Fixed-size work-stealing pool of worker threads. Every worker owns a deque of tasks: the tasks a worker submits
+	 * go to the back of its own deque and are run from there, and a worker running out of tasks steals the oldest
+	 * one from the front of another deque. Tasks submitted by other threads are spread over the deques.
+	 *
+	 * parallelFor may be nested in the tasks of the pool: the task runs the chunks of its loop itself while idle
+	 * workers steal the helpers it submitted, so a large job spreads over the workers other jobs left idle and the
+	 * loop never waits for a helper which has not started. The calling thread also takes part in parallelFor.
+	 **/
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(int numThreads = 0);	// "numThreads" counts the calling thread, 0 means all cores
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// number of threads including the calling thread
+		int size() const;
+
+		// run task on a worker, or right away when the pool has no worker, the task must not throw
+		void submit(std::function<void()> task);
+
+		// call func(first, last) on chunks of at most "grain" indices covering [begin, end) and wait for all of them,
+		// the first exception thrown by func is rethrown in the calling thread
+		void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& func);
+
+	private:
+		// Tasks of one worker
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		// pop from the back of the own deque, else steal from the front of the others
+		bool popTask(int index, std::function<void()>& task);
+
+		void workerLoop(int index);
+
+	private:
+		std::vector<std::thread> m_workers;
+		std::vector<std::unique_ptr<Queue>> m_queues;	// one per worker
+		std::atomic<int> m_numPending;	// tasks submitted and not popped yet
+		std::atomic<unsigned> m_nextQueue;	// deque receiving the next task of another thread
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop;
+	};
+};
@@ -0,0 +1,238 @@
+#include "trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct TraceEvent
+	{
+		const char* name;
+		const char* category;
+		std::string detail;
+		double start;	// microseconds since the recording started
+		double duration;
+	};
+
+	// Events of one thread, the mutex is only contended while the trace is written
+	struct ThreadBuffer
+	{
+		int id = 0;
+		std::string name;
+		std::mutex mutex;
+		std::vector<TraceEvent> events;
+	};
+
+	// Recording shared by all threads, the buffers outlive the threads which filled them
+	struct Recording
+	{
+		std::atomic<bool> enabled{ false };
+		std::mutex mutex;
+		std::string filename;
+		std::atomic<Clock::rep> origin{ 0 };	// start of the recording in clock ticks
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		bool exitHandler = false;
+	};
+
+	Recording& recording()
+	{
+		static Recording* instance = new Recording();	// never destroyed, threads may still trace during exit
+		return *instance;
+	}
+
+	thread_local std::string threadName;
+	thread_local std::shared_ptr<ThreadBuffer> threadBuffer;
+
+	ThreadBuffer& currentBuffer()
+	{
+		if (!threadBuffer)
+		{
+			Recording& rec = recording();
+			std::lock_guard<std::mutex> lock(rec.mutex);
+			threadBuffer = std::make_shared<ThreadBuffer>();
+			threadBuffer->id = static_cast<int>(rec.buffers.size()) + 1;
+			threadBuffer->name = threadName.empty() ? "thread " + std::to_string(threadBuffer->id) : threadName;
+			rec.buffers.emplace_back(threadBuffer);
+		}
+		return *threadBuffer;
+	}
+
+	// string of a JSON document
+	void putString(std::FILE* file, const char* text)
+	{
+		std::fputc('"', file);
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char ch = static_cast<unsigned char>(*c);
+			if (ch == '"' || ch == '\\')
+			{
+				std::fputc('\\', file);
+				std::fputc(ch, file);
+			}
+			else if (ch < 0x20)
+			{
+				std::fprintf(file, "\\u%04x", ch);
+			}
+			else
+			{
+				std::fputc(ch, file);
+			}
+		}
+		std::fputc('"', file);
+	}
+
+	void stopAtExit()
+	{
+		std::string error;
+		if (util::trace::enabled() && !util::trace::stop(error))
+		{
+			std::fprintf(stderr, "%s\n", error.c_str());
+		}
+	}
+}
+
+bool util::trace::start(const std::string& filename)
+{
+	if (filename.empty())
+	{
+		return false;
+	}
+
+	Recording& rec = recording();
+	std::lock_guard<std::mutex> lock(rec.mutex);
+	for (auto& buffer : rec.buffers)
+	{
+		std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+		buffer->events.clear();
+	}
+	rec.filename = filename;
+	rec.origin = Clock::now().time_since_epoch().count();
+	if (!rec.exitHandler)
+	{
+		std::atexit(stopAtExit);
+		rec.exitHandler = true;
+	}
+	rec.enabled = true;
+	return true;
+}
+
+bool util::trace::startFromEnvironment()
+{
+	const char* filename = std::getenv("SKIN_TRACE");
+	return filename && start(filename);
+}
+
+bool util::trace::stop(std::string& error)
+{
+	Recording& rec = recording();
+	std::lock_guard<std::mutex> lock(rec.mutex);
+	if (!rec.enabled.exchange(false))
+	{
+		error = "tracing was not started";
+		return false;
+	}
+
+	std::FILE* file = std::fopen(rec.filename.c_str(), "w");
+	if (!file)
+	{
+		error = "cannot write trace " + rec.filename;
+		return false;
+	}
+
+	// one process, threads numbered in the order of their first event
+	std::fprintf(file, "{\"traceEvents\":[\n");
+	std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"skin\"}}");
+	for (auto& buffer : rec.buffers)
+	{
+		std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+		std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", buffer->id);
+		putString(file, buffer->name.c_str());
+		std::fprintf(file, "}}");
+
+		for (const auto& event : buffer->events)
+		{
+			std::fprintf(file, ",\n{\"name\":");
+			putString(file, event.name);
+			std::fprintf(file, ",\"cat\":");
+			putString(file, event.category);
+			std::fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d", event.start, event.duration, buffer->id);
+			if (!event.detail.empty())
+			{
+				std::fprintf(file, ",\"args\":{\"detail\":");
+				putString(file, event.detail.c_str());
+				std::fprintf(file, "}");
+			}
+			std::fprintf(file, "}");
+		}
+		buffer->events.clear();
+	}
+	std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	bool written = !std::ferror(file);
+	written = std::fclose(file) == 0 && written;
+	if (!written)
+	{
+		error = "cannot write trace " + rec.filename;
+	}
+	return written;
+}
+
+bool util::trace::enabled()
+{
+	return recording().enabled.load(std::memory_order_relaxed);
+}
+
+void util::trace::setThreadName(const std::string& name)
+{
+	threadName = name;
+	if (threadBuffer)
+	{
+		std::lock_guard<std::mutex> lock(threadBuffer->mutex);
+		threadBuffer->name = name;
+	}
+}
+
+util::TraceScope::TraceScope(const char* name, const char* category)
+	: m_name{ name }, m_category{ category }, m_enabled{ trace::enabled() }
+{
+	if (m_enabled)
+	{
+		m_start = Clock::now();
+	}
+}
+
+util::TraceScope::TraceScope(const char* name, const char* category, const std::string& detail)
+	: m_name{ name }, m_category{ category }, m_enabled{ trace::enabled() }
+{
+	if (m_enabled)
+	{
+		m_detail = detail;
+		m_start = Clock::now();
+	}
+}
+
+util::TraceScope::~TraceScope()
+{
+	if (!m_enabled)
+	{
+		return;
+	}
+
+	Clock::time_point end = Clock::now();
+	Clock::time_point origin{ Clock::duration(recording().origin.load()) };
+	ThreadBuffer& buffer = currentBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	if (!trace::enabled() || m_start < origin)
+	{
+		return;	// the recording stopped or restarted meanwhile
+	}
+	buffer.events.push_back({ m_name, m_category, std::move(m_detail),
+		std::chrono::duration<double, std::micro>(m_start - origin).count(),
+		std::chrono::duration<double, std::micro>(end - m_start).count() });
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace util
+{
+	/*
+	 * Timeline of scoped events written as a Chrome trace (chrome://tracing, ui.perfetto.dev). Every thread appends
+	 * its events to its own buffer, so recording takes no shared lock, and the buffers are gathered into the JSON
+	 * file when tracing stops. While tracing is off a scope only reads one atomic flag.
+	 *
+	 * Tracing is started by trace::start, or by trace::startFromEnvironment when the environment variable SKIN_TRACE
+	 * names the output file. The file is written by trace::stop, or at exit if stop is never called.
+	 **/
+	namespace trace
+	{
+		// start recording into filename, the events of a previous recording are dropped
+		bool start(const std::string& filename);
+
+		// start recording into the file named by SKIN_TRACE, false when the variable is unset
+		bool startFromEnvironment();
+
+		// stop recording and write the trace file
+		bool stop(std::string& error);
+
+		bool enabled();
+
+		// name shown for the calling thread, e.g. "main" or "pool worker"
+		void setThreadName(const std::string& name);
+	}
+
+	// Records the duration of its scope as a complete event of the calling thread,
+	// "name" and "category" must outlive the recording, string literals in practice
+	class TraceScope
+	{
+	public:
+		TraceScope(const char* name, const char* category);
+		TraceScope(const char* name, const char* category, const std::string& detail);	// detail is shown in the event arguments
+		~TraceScope();
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+	private:
+		const char* m_name;
+		const char* m_category;
+		std::string m_detail;
+		bool m_enabled;
+		std::chrono::steady_clock::time_point m_start;
+	};
+};
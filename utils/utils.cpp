@@ -1,12 +1,22 @@
 #include "utils.h"
+#include "basis.h"
+#include "lanes.h"
+#include "threadpool.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <Eigen/Dense>
 #include <BSplCLib.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopoDS.hxx>
 #include <BRep_Tool.hxx>
+#include <BRepBuilderAPI_MakeEdge.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <Precision.hxx>
 #include <STEPControl_Reader.hxx>
 #include <STEPControl_Writer.hxx>
 #include <IGESControl_Reader.hxx>
@@ -51,22 +61,211 @@ void nurbs::getChordParameterization(const std::vector<TColgp_Array1OfPnt>& poin
 	int number = points.size();	// number of groups
 	int size = points[0].Length();	// number of points of each group
 
-	params.resize(size, 0.0);
-	std::vector<double> temp;
+	// each distance is computed once into the accumulated chord length of the group, groups of zero length are skipped
+	params.assign(size, 0.0);
+	std::vector<double> accumulated(size, 0.0);
+	int numValid = 0;
 
-	for (int i = 0; i < number; ++i)
+	for (const auto& group : points)
 	{
-		getChordParameterization(points[i], temp);
-		for (int j = 0; j < size; ++j)
+		for (int j = 1; j < size; ++j)
+		{
+			accumulated[j] = accumulated[j - 1] + group.Value(group.Lower() + j).Distance(group.Value(group.Lower() + j - 1));
+		}
+
+		double length = accumulated[size - 1];
+		if (length > 0.0)
 		{
-			params[j] += temp[j];
+			for (int j = 1; j < size; ++j)
+			{
+				params[j] += accumulated[j] / length;
+			}
+			++numValid;
 		}
 	}
 
 	for (int j = 0; j < size; ++j)
 	{
-		params[j] /= number;
+		params[j] = numValid > 0 ? params[j] / numValid : static_cast<double>(j) / std::max(size - 1, 1);
+	}
+}
+
+void nurbs::getChordParameterization(const ControlNet& net, std::vector<double>& params)
+{
+	getParameterization(net, Parameterization::ChordLength, params);
+}
+
+namespace
+{
+	// Bytes of the distances of a block of columns, about the size of an L2 cache
+	const int parameterizationBlockBytes = 1 << 20;
+
+	/*
+	 * Distances between the points (j - 1, i) and (j, i) of columns [first, count), stored in distances[i] and added
+	 * to lengths[i]. The previous row starts at x, y, z and the row j is stride values further.
+	 * Returns the first column left to narrower lanes.
+	 **/
+	template <class Lanes>
+	int rowDistances(const double* x, const double* y, const double* z, size_t stride, int first, int count, bool centripetal,
+		double* distances, double* lengths)
+	{
+		using Real = typename Lanes::Real;
+
+		int i = first;
+		for (; i + Lanes::width <= count; i += Lanes::width)
+		{
+			Real dx = Lanes::sub(Lanes::load(x + stride + i), Lanes::load(x + i));
+			Real dy = Lanes::sub(Lanes::load(y + stride + i), Lanes::load(y + i));
+			Real dz = Lanes::sub(Lanes::load(z + stride + i), Lanes::load(z + i));
+			Real distance = Lanes::sqrt(Lanes::add(Lanes::add(Lanes::mul(dx, dx), Lanes::mul(dy, dy)), Lanes::mul(dz, dz)));
+			if (centripetal)
+			{
+				distance = Lanes::sqrt(distance);
+			}
+			Lanes::store(distances + i, distance);
+			Lanes::store(lengths + i, Lanes::add(Lanes::load(lengths + i), distance));
+		}
+		return i;
+	}
+
+	/*
+	 * Add the distances of one row to the accumulated lengths of columns [first, count) and add the accumulated
+	 * lengths weighted by the inverse total lengths to sums, one partial sum per lane.
+	 * Returns the first column left to narrower lanes.
+	 **/
+	template <class Lanes>
+	int accumulateRow(const double* distances, const double* inverseLengths, int first, int count, double* accumulated, double* sums)
+	{
+		using Real = typename Lanes::Real;
+
+		Real sum = Lanes::set1(0.0);
+		int i = first;
+		for (; i + Lanes::width <= count; i += Lanes::width)
+		{
+			Real length = Lanes::add(Lanes::load(accumulated + i), Lanes::load(distances + i));
+			Lanes::store(accumulated + i, length);
+			sum = Lanes::add(sum, Lanes::mul(length, Lanes::load(inverseLengths + i)));
+		}
+		Lanes::store(sums, Lanes::add(Lanes::load(sums), sum));
+		return i;
+	}
+}
+
+void nurbs::getParameterization(const ControlNet& net, Parameterization scheme, std::vector<double>& params, int numThreads,
+	util::ThreadPool* pool)
+{
+	int size = net.rows();	// number of points of each column
+	int number = net.cols();	// number of columns
+
+	params.assign(size, 0.0);
+	auto uniform = [&]()
+	{
+		for (int j = 0; j < size; ++j)
+		{
+			params[j] = static_cast<double>(j) / std::max(size - 1, 1);
+		}
+	};
+	if (scheme == Parameterization::Uniform || size < 2 || number == 0)
+	{
+		uniform();
+		return;
+	}
+
+	// the blocks depend on the size of the net only, never on the number of threads
+	int blockWidth = std::clamp(parameterizationBlockBytes / (8 * size), 8, 1024) / 8 * 8;
+	int numBlocks = (number + blockWidth - 1) / blockWidth;
+	std::vector<double> blockSums(static_cast<size_t>(numBlocks) * size, 0.0);
+	std::vector<int> blockValid(numBlocks, 0);
+	bool centripetal = scheme == Parameterization::Centripetal;
+
+	const double* x = net.plane(0);
+	const double* y = net.plane(1);
+	const double* z = net.plane(2);
+
+	auto func = [&](int firstBlock, int lastBlock)
+	{
+		std::vector<double> distances(static_cast<size_t>(size) * blockWidth), lengths(blockWidth), accumulated(blockWidth);
+
+		for (int block = firstBlock; block < lastBlock; ++block)
+		{
+			int first = block * blockWidth;
+			int count = std::min(blockWidth, number - first);
+
+			// single pass over the coordinates, row j - 1 and row j are contiguous runs of the planes
+			std::fill(lengths.begin(), lengths.end(), 0.0);
+			for (int j = 1; j < size; ++j)
+			{
+				size_t offset = static_cast<size_t>(j - 1) * number + first;
+				double* rowDistance = distances.data() + static_cast<size_t>(j) * blockWidth;
+				int i = rowDistances<nurbs::VectorLanes>(x + offset, y + offset, z + offset, number, 0, count, centripetal, rowDistance, lengths.data());
+				rowDistances<nurbs::ScalarLanes>(x + offset, y + offset, z + offset, number, i, count, centripetal, rowDistance, lengths.data());
+			}
+
+			// sum of the normalized accumulated lengths of the block at every row, from the distances in cache
+			int numValid = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				numValid += lengths[i] > 0.0 ? 1 : 0;
+				lengths[i] = lengths[i] > 0.0 ? 1.0 / lengths[i] : 0.0;
+				accumulated[i] = 0.0;
+			}
+
+			// the lanes are summed in a fixed order at the end of every row
+			double* sums = blockSums.data() + static_cast<size_t>(block) * size;
+			for (int j = 1; j < size; ++j)
+			{
+				const double* rowDistance = distances.data() + static_cast<size_t>(j) * blockWidth;
+				double laneSums[nurbs::VectorLanes::width] = {};
+				int i = accumulateRow<nurbs::VectorLanes>(rowDistance, lengths.data(), 0, count, accumulated.data(), laneSums);
+				accumulateRow<nurbs::ScalarLanes>(rowDistance, lengths.data(), i, count, accumulated.data(), laneSums);
+
+				double sum = 0.0;
+				for (double laneSum : laneSums)
+				{
+					sum += laneSum;
+				}
+				sums[j] = sum;
+			}
+			blockValid[block] = numValid;
+		}
+	};
+
+	if (pool && numBlocks > 1)
+	{
+		pool->parallelFor(0, numBlocks, 1, func);
 	}
+	else if (numThreads == 1 || numBlocks == 1)
+	{
+		func(0, numBlocks);
+	}
+	else
+	{
+		util::ThreadPool ownPool(numThreads);
+		ownPool.parallelFor(0, numBlocks, 1, func);
+	}
+
+	// the blocks are summed in order
+	int numValid = 0;
+	for (int block = 0; block < numBlocks; ++block)
+	{
+		numValid += blockValid[block];
+	}
+	if (numValid == 0)
+	{
+		uniform();
+		return;
+	}
+
+	for (int j = 1; j < size - 1; ++j)
+	{
+		double sum = 0.0;
+		for (int block = 0; block < numBlocks; ++block)
+		{
+			sum += blockSums[static_cast<size_t>(block) * size + j];
+		}
+		params[j] = sum / numValid;
+	}
+	params[size - 1] = 1.0;
 }
 
 void nurbs::averageKnotVector(int degree, const std::vector<double>& params, std::vector<double>& knots)
@@ -92,39 +291,381 @@ void nurbs::averageKnotVector(int degree, const std::vector<double>& params, std
 	}
 }
 
-int nurbs::findSpan(int degree, const std::vector<double>& knots, double u)
+void nurbs::mergeKnots(const std::vector<const TColStd_Array1OfReal*>& knots, const std::vector<const TColStd_Array1OfInteger*>& mults,
+	double tolerance, TColStd_Array1OfReal& mergedKnots, TColStd_Array1OfInteger& mergedMults, KnotMergeReport& report)
+{
+	// next unmerged knot of every vector in a binary min-heap, ties are broken by the vector index
+	struct Head
+	{
+		double knot;
+		int vector;
+		int index;
+		bool operator<(const Head& other) const { return knot < other.knot || (knot == other.knot && vector < other.vector); }
+	};
+	std::vector<Head> heads;
+
+	int number = static_cast<int>(knots.size());
+	report.numInputKnots = 0;
+	for (int k = 0; k < number; ++k)
+	{
+		if (knots[k]->Length() > 0)
+		{
+			heads.push_back({ knots[k]->Value(knots[k]->Lower()), k, knots[k]->Lower() });
+		}
+		report.numInputKnots += knots[k]->Length();
+	}
+
+	// move the top down to its place, the vector of the top is advanced in place instead of a pop and a push
+	auto siftDown = [&heads](size_t i)
+	{
+		Head head = heads[i];
+		size_t size = heads.size();
+		while (2 * i + 1 < size)
+		{
+			size_t child = 2 * i + 1;
+			if (child + 1 < size && heads[child + 1] < heads[child])
+			{
+				++child;
+			}
+			if (!(heads[child] < head))
+			{
+				break;
+			}
+			heads[i] = heads[child];
+			i = child;
+		}
+		heads[i] = head;
+	};
+	for (size_t i = heads.size() / 2; i-- > 0;)
+	{
+		siftDown(i);
+	}
+
+	// the multiplicity a vector contributes to the current group, summed if it has several knots in the group
+	std::vector<int> lastGroup(number, -1), groupMults(number, 0);
+	std::vector<double> values;
+	std::vector<int> groupMax;
+	report.numSnappedKnots = 0;
+
+	while (!heads.empty())
+	{
+		Head& head = heads.front();
+
+		if (values.empty() || head.knot - values.back() > tolerance)
+		{
+			values.push_back(head.knot);
+			groupMax.push_back(0);
+		}
+		else if (head.knot != values.back())
+		{
+			++report.numSnappedKnots;
+		}
+
+		int group = static_cast<int>(values.size()) - 1;
+		int mult = mults[head.vector]->Value(head.index);
+		groupMults[head.vector] = lastGroup[head.vector] == group ? groupMults[head.vector] + mult : mult;
+		lastGroup[head.vector] = group;
+		groupMax[group] = std::max(groupMax[group], groupMults[head.vector]);
+
+		if (head.index < knots[head.vector]->Upper())
+		{
+			++head.index;
+			head.knot = knots[head.vector]->Value(head.index);
+		}
+		else
+		{
+			head = heads.back();
+			heads.pop_back();
+		}
+		if (!heads.empty())
+		{
+			siftDown(0);
+		}
+	}
+
+	int nbKnots = static_cast<int>(values.size());
+	mergedKnots.Resize(1, std::max(1, nbKnots), false);
+	mergedMults.Resize(1, std::max(1, nbKnots), false);
+	for (int i = 0; i < nbKnots; ++i)
+	{
+		mergedKnots.SetValue(i + 1, values[i]);
+		mergedMults.SetValue(i + 1, groupMax[i]);
+	}
+	report.numMergedKnots = nbKnots;
+}
+
+bool nurbs::containsKnots(const TColStd_Array1OfReal& knots, const TColStd_Array1OfInteger& mults,
+	const TColStd_Array1OfReal& subKnots, const TColStd_Array1OfInteger& subMults, double tolerance)
+{
+	// both vectors are sorted, so they are walked together
+	int i = knots.Lower();
+	for (int k = subKnots.Lower(); k <= subKnots.Upper(); ++k)
+	{
+		double knot = subKnots.Value(k);
+		while (i <= knots.Upper() && knots.Value(i) < knot - tolerance)
+		{
+			++i;
+		}
+		if (i > knots.Upper() || knots.Value(i) > knot + tolerance || mults.Value(i) < subMults.Value(k))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+namespace
+{
+	// Insert knots into flat poles of the given dimension and store the cartesian result in row j of net,
+	// the fourth coordinate of rational poles is the weight dividing the others.
+	bool insertKnots(int degree, int dimension, const TColStd_Array1OfReal& poles, const TColStd_Array1OfReal& knots,
+		const TColStd_Array1OfInteger& mults, const TColStd_Array1OfReal& newKnots, const TColStd_Array1OfInteger& newMults,
+		double tolerance, nurbs::ControlNet& net, int j)
+	{
+		int numPoles = 0, numKnots = 0;
+		if (!BSplCLib::PrepareInsertKnots(degree, Standard_False, knots, mults, newKnots, &newMults, numPoles, numKnots, tolerance, Standard_False)
+			|| numPoles != net.cols())
+		{
+			return false;
+		}
+
+		TColStd_Array1OfReal insertedPoles(1, dimension * numPoles), insertedKnots(1, numKnots);
+		TColStd_Array1OfInteger insertedMults(1, numKnots);
+		BSplCLib::InsertKnots(degree, Standard_False, dimension, poles, knots, mults, newKnots, &newMults,
+			insertedPoles, insertedKnots, insertedMults, tolerance, Standard_False);
+
+		auto row = net.row(j);
+		const double* values = &insertedPoles.Value(1);
+		for (int i = 0; i < numPoles; ++i, values += dimension)
+		{
+			double scale = dimension == 4 ? 1.0 / values[3] : 1.0;
+			row.x[i] = values[0] * scale;
+			row.y[i] = values[1] * scale;
+			row.z[i] = values[2] * scale;
+		}
+		return true;
+	}
+}
+
+bool nurbs::compatiblePoles(const Handle(Geom_BSplineCurve)& curve, int degree, const TColStd_Array1OfReal& knots,
+	const TColStd_Array1OfInteger& mults, double tolerance, ControlNet& net, int j)
 {
-	int m = static_cast<int>(knots.size() - 1);
-	int n = m - degree - 1;
+	// flat poles, multiplied by their weights for rational curves
+	const TColgp_Array1OfPnt& curvePoles = curve->Poles();
+	const TColStd_Array1OfReal* weights = curve->Weights();
+	int dimension = weights != nullptr ? 4 : 3;
+	int numPoles = curvePoles.Length();
 
-	if (u == knots[knots.size() - degree - 1])
+	TColStd_Array1OfReal poles(1, dimension * numPoles);
+	for (int i = 0; i < numPoles; ++i)
 	{
-		return n;
+		const gp_Pnt& pole = curvePoles.Value(curvePoles.Lower() + i);
+		double weight = weights != nullptr ? weights->Value(weights->Lower() + i) : 1.0;
+		poles.SetValue(dimension * i + 1, pole.X() * weight);
+		poles.SetValue(dimension * i + 2, pole.Y() * weight);
+		poles.SetValue(dimension * i + 3, pole.Z() * weight);
+		if (dimension == 4)
+		{
+			poles.SetValue(dimension * i + 4, weight);
+		}
 	}
 
-	int mid = std::upper_bound(knots.begin() + degree, knots.begin() + n + 1, u) - knots.begin() - 1;
+	int increase = degree - curve->Degree();
+	if (increase <= 0)
+	{
+		return insertKnots(degree, dimension, poles, curve->Knots(), curve->Multiplicities(), knots, mults, tolerance, net, j);
+	}
+
+	// Increasing the degree keeps the knots and adds the increase to every multiplicity
+	const TColStd_Array1OfReal& curveKnots = curve->Knots();
+	TColStd_Array1OfInteger elevatedMults = curve->Multiplicities();
+	for (int i = elevatedMults.Lower(); i <= elevatedMults.Upper(); ++i)
+	{
+		elevatedMults.SetValue(i, elevatedMults.Value(i) + increase);
+	}
+
+	TColStd_Array1OfReal elevatedPoles(1, dimension * BSplCLib::NbPoles(degree, Standard_False, elevatedMults));
+	TColStd_Array1OfReal elevatedKnots(1, curveKnots.Length());
+	BSplCLib::IncreaseDegree(curve->Degree(), degree, Standard_False, dimension, poles, curveKnots, curve->Multiplicities(),
+		elevatedPoles, elevatedKnots, elevatedMults);
+
+	return insertKnots(degree, dimension, elevatedPoles, elevatedKnots, elevatedMults, knots, mults, tolerance, net, j);
+}
 
-	return mid;
+bool nurbs::refinePoles(const ControlNet& net, int j, int degree, const TColStd_Array1OfReal& knots, const TColStd_Array1OfInteger& mults,
+	const TColStd_Array1OfReal& newKnots, const TColStd_Array1OfInteger& newMults, double tolerance, ControlNet& refined)
+{
+	auto row = net.row(j);
+	TColStd_Array1OfReal poles(1, 3 * row.size);
+	for (int i = 0; i < row.size; ++i)
+	{
+		poles.SetValue(3 * i + 1, row.x[i]);
+		poles.SetValue(3 * i + 2, row.y[i]);
+		poles.SetValue(3 * i + 3, row.z[i]);
+	}
+
+	return insertKnots(degree, 3, poles, knots, mults, newKnots, newMults, tolerance, refined, j);
+}
+
+int nurbs::findSpan(int degree, const std::vector<double>& knots, double u)
+{
+	return findSpan(degree, knots.data(), static_cast<int>(knots.size()), u);
 }
 
 void nurbs::calcBasisFunctions(int span, int degree, const std::vector<double>& knots, double u, std::vector<double>& basisFuns)
 {
 	basisFuns.resize(degree + 1);
-	std::vector<double> left(degree + 1), right(degree + 1);
-	basisFuns[0] = 1.0;
+	basisFunctions(span, degree, knots.data(), u, basisFuns.data());
+}
+
+void nurbs::calcBasisFunctions(int span, int degree, const double* knots, double u, double* basisFuns)
+{
+	basisFunctions(span, degree, knots, u, basisFuns);
+}
+
+void nurbs::buildInterpolationMatrix(int degree, const std::vector<double>& params, const std::vector<double>& knots, BandedMatrix& matrix)
+{
+	int size = static_cast<int>(params.size());
+
+	// spans of all parameters determine the bandwidths
+	std::vector<int> spans(size);
+	int lower = 0, upper = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		spans[i] = findSpan(degree, knots, params[i]);
+		lower = std::max(lower, i - (spans[i] - degree));
+		upper = std::max(upper, spans[i] - i);
+	}
+
+	matrix.size = size;
+	matrix.lower = lower;
+	matrix.upper = upper;
+	matrix.data.assign(static_cast<size_t>(size) * (lower + upper + 1), 0.0);
+
+	double values[maxBasisDegree + 1];
+	for (int i = 0; i < size; ++i)
+	{
+		basisFunctions(spans[i], degree, knots.data(), params[i], values);
+		for (int k = 0; k <= degree; ++k)
+		{
+			matrix(i, spans[i] - degree + k) = values[k];
+		}
+	}
+}
+
+void nurbs::approximationKnotVector(int degree, int numPoles, const std::vector<double>& params, std::vector<double>& knots)
+{
+	int m = static_cast<int>(params.size()) - 1;
+	int n = numPoles - 1;
+
+	knots.assign(n + degree + 2, 0.0);
+	for (int i = n + 1; i <= n + degree + 1; ++i)
+	{
+		knots[i] = 1.0;
+	}
+
+	// every knot span holds at least one parameter, so the normal matrix is regular
+	double d = static_cast<double>(m + 1) / (n - degree + 1);
+	for (int j = 1; j <= n - degree; ++j)
+	{
+		int i = static_cast<int>(j * d);
+		double alpha = j * d - i;
+		knots[degree + j] = (1.0 - alpha) * params[i - 1] + alpha * params[i];
+	}
+}
+
+void nurbs::buildNormalMatrix(int degree, int numPoles, const std::vector<double>& params, const std::vector<double>& knots, BandedMatrix& matrix)
+{
+	int m = static_cast<int>(params.size()) - 1;
+	int n = numPoles - 1;
+
+	// unknowns are the control points 1 to n - 1
+	matrix.size = std::max(n - 1, 0);
+	matrix.lower = std::min(degree, std::max(n - 2, 0));
+	matrix.upper = matrix.lower;
+	matrix.data.assign(static_cast<size_t>(matrix.size) * (matrix.lower + matrix.upper + 1), 0.0);
+
+	double values[maxBasisDegree + 1];
+	for (int k = 1; k < m; ++k)
+	{
+		int span = findSpan(degree, knots, params[k]);
+		basisFunctions(span, degree, knots.data(), params[k], values);
+		for (int a = 0; a <= degree; ++a)
+		{
+			int i = span - degree + a;
+			if (i < 1 || i > n - 1)
+			{
+				continue;
+			}
+			for (int b = 0; b <= degree; ++b)
+			{
+				int j = span - degree + b;
+				if (j >= 1 && j <= n - 1)
+				{
+					matrix(i - 1, j - 1) += values[a] * values[b];
+				}
+			}
+		}
+	}
+}
 
-	for (int j = 1; j <= degree; j++)
+bool nurbs::factorBanded(BandedMatrix& matrix)
+{
+	// The interpolation matrix is totally positive, so Gaussian elimination without pivoting is stable
+	// and no fill-in occurs outside the band.
+	int n = matrix.size;
+
+	for (int k = 0; k < n; ++k)
 	{
-		left[j] = u - knots[span + 1 - j];
-		right[j] = knots[span + j] - u;
-		double saved = 0.0;
-		for (int r = 0; r < j; r++)
+		double pivot = matrix(k, k);
+		if (pivot == 0.0)
+		{
+			return false;
+		}
+
+		int rowEnd = std::min(n - 1, k + matrix.lower);
+		int colEnd = std::min(n - 1, k + matrix.upper);
+		for (int i = k + 1; i <= rowEnd; ++i)
 		{
-			double temp = basisFuns[r] / (right[r + 1] + left[j - r]);
-			basisFuns[r] = saved + right[r + 1] * temp;
-			saved = left[j - r] * temp;
+			double factor = matrix(i, k) / pivot;
+			matrix(i, k) = factor;
+			for (int j = k + 1; j <= colEnd; ++j)
+			{
+				matrix(i, j) -= factor * matrix(k, j);
+			}
 		}
-		basisFuns[j] = saved;
+	}
+
+	return true;
+}
+
+void nurbs::solveBanded(const BandedMatrix& lu, Eigen::Ref<RowMatrix> rhs)
+{
+	solveBanded(lu, rhs, 0, static_cast<int>(rhs.cols()));
+}
+
+void nurbs::solveBanded(const BandedMatrix& lu, Eigen::Ref<RowMatrix> rhs, int firstCol, int numCols)
+{
+	int n = lu.size;
+
+	// forward substitution with the unit lower triangle
+	for (int i = 1; i < n; ++i)
+	{
+		for (int k = std::max(0, i - lu.lower); k < i; ++k)
+		{
+			rhs.row(i).segment(firstCol, numCols) -= lu(i, k) * rhs.row(k).segment(firstCol, numCols);
+		}
+	}
+
+	// backward substitution with the upper triangle
+	for (int i = n - 1; i >= 0; --i)
+	{
+		int colEnd = std::min(n - 1, i + lu.upper);
+		for (int j = i + 1; j <= colEnd; ++j)
+		{
+			rhs.row(i).segment(firstCol, numCols) -= lu(i, j) * rhs.row(j).segment(firstCol, numCols);
+		}
+		rhs.row(i).segment(firstCol, numCols) /= lu(i, i);
 	}
 }
 
@@ -134,45 +675,185 @@ void nurbs::curveInterpolation(const std::vector<double>& params, const std::vec
 	int n = points.Length() - 1;
 	int degree = m - n - 1;
 
-	// create coefficents matrix and vectors
-	Eigen::MatrixXd A = Eigen::MatrixXd::Zero((n + 1) * 3, (n + 1) * 3);
-	Eigen::MatrixXd C = Eigen::MatrixXd::Zero(n + 1, n + 1);
-	Eigen::VectorXd P((n + 1) * 3);
-	Eigen::VectorXd Q((n + 1) * 3);
+	// create banded coefficients matrix C
+	BandedMatrix C;
+	buildInterpolationMatrix(degree, params, knots, C);
 
-	// fill matrix and vectors
-	int spanIndex;
-	std::vector<double> values;
+	/**
+	* solve the equation which is
+	* C[Px, Py, Pz] = [Qx, Qy, Qz]
+	*/
+	RowMatrix P(n + 1, 3);
 	for (int i = 0; i <= n; ++i)
 	{
-		spanIndex = findSpan(degree, knots, params[i]);
-		calcBasisFunctions(spanIndex, degree, knots, params[i], values);
+		const gp_Pnt& point = points[i + points.Lower()];
+		P(i, 0) = point.X();
+		P(i, 1) = point.Y();
+		P(i, 2) = point.Z();
+	}
 
-		C.row(i).segment(spanIndex - degree, degree + 1) = Eigen::Map<Eigen::VectorXd>(values.data(), values.size());
-		Q(i, 0) = points[i + points.Lower()].X();
-		Q(i + (n + 1), 0) = points[i + points.Lower()].Y();
-		Q(i + (n + 1) * 2, 0) = points[i + points.Lower()].Z();
+	// LU decomposition
+	if (!factorBanded(C))
+	{
+		return;
 	}
-	A.block(0, 0, n + 1, n + 1) = C;
-	A.block(n + 1, n + 1, n + 1, n + 1) = C;
-	A.block((n + 1) * 2, (n + 1) * 2, n + 1, n + 1) = C;
+	solveBanded(C, P);
 
-	/**
-	* solve the equation which is
-	* [C, 0, 0]	   [Qx]
-	* [0, C, 0]P = [Qy]
-	* [0, 0, C]	   [Qz]
-	*/
+	for (int i = 0; i <= n; ++i)
+	{
+		controlPoints.SetValue(i + controlPoints.Lower(), gp_Pnt(P(i, 0), P(i, 1), P(i, 2)));
+	}
+}
 
-	// LU decomposition
-	Eigen::FullPivLU<Eigen::MatrixXd> lu(A);
+int nurbs::removeKnots(int degree, std::vector<double>& knots, RowMatrix poles[3], double tolerance, std::vector<double>& errors, int numThreads,
+	util::ThreadPool* pool)
+{
+	int numCurves = static_cast<int>(poles[0].cols());
+	errors.resize(numCurves, 0.0);
+
+	// the curves are processed in blocks of columns, the decision to remove a knot is taken for all of them
+	const int curveBlock = 256;
+	int numBlocks = (numCurves + curveBlock - 1) / curveBlock;
+	std::unique_ptr<util::ThreadPool> ownPool;
+	if (!pool && numThreads != 1 && numBlocks > 1)
+	{
+		ownPool = std::make_unique<util::ThreadPool>(numThreads);
+		pool = ownPool.get();
+	}
+	auto forEachBlock = [&](const std::function<void(int, int)>& func)
+	{
+		auto run = [&](int first, int last)
+		{
+			for (int block = first; block < last; ++block)
+			{
+				func(block * curveBlock, std::min(curveBlock, numCurves - block * curveBlock));
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(0, numBlocks, 1, run);
+		}
+		else
+		{
+			run(0, numBlocks);
+		}
+	};
 
-	P = lu.solve(Q);
+	int order = degree + 1;
+	int numRemoved = 0;
+	RowMatrix temp[3];
+	std::vector<double> removalErrors(numCurves);
 
-	for (int i = 0; i <= n; ++i)
+	int r = order;
+	while (r < static_cast<int>(knots.size()) - order)
 	{
-		controlPoints.SetValue(i + controlPoints.Lower(), gp_Pnt(P(i), P(i + (n + 1)), P(i + (n + 1) * 2)));
+		// r to last are the indices of the knot u
+		int last = r;
+		while (knots[last + 1] == knots[r])
+		{
+			++last;
+		}
+		int s = last - r + 1;
+		double u = knots[last];
+		if (s > degree)
+		{
+			r = last + 1;
+			continue;
+		}
+
+		// control points first to lastPole change, temp[c].row(k) stands for the new point first - 1 + k
+		int first = last - degree;
+		int lastPole = last - s;
+		int off = first - 1;
+		// indices where the points computed from both ends meet
+		int i = first, j = lastPole, ii = 1, jj = lastPole - off;
+		while (j - i > 0)
+		{
+			++i;
+			++ii;
+			--j;
+			--jj;
+		}
+
+		for (int c = 0; c < 3; ++c)
+		{
+			temp[c].resize(lastPole - off + 2, numCurves);
+		}
+
+		forEachBlock([&](int firstCurve, int count)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				auto T = temp[c].middleCols(firstCurve, count);
+				auto P = poles[c].middleCols(firstCurve, count);
+				T.row(0) = P.row(off);
+				T.row(lastPole + 1 - off) = P.row(lastPole + 1);
+				for (int ri = first, rj = lastPole, rii = 1, rjj = lastPole - off; rj - ri > 0; ++ri, ++rii, --rj, --rjj)
+				{
+					double alfi = (u - knots[ri]) / (knots[ri + order] - knots[ri]);
+					double alfj = (u - knots[rj]) / (knots[rj + order] - knots[rj]);
+					T.row(rii) = (P.row(ri) - (1.0 - alfi) * T.row(rii - 1)) / alfi;
+					T.row(rjj) = (P.row(rj) - alfj * T.row(rjj + 1)) / (1.0 - alfj);
+				}
+			}
+
+			// distance between the two ways of computing the middle control point
+			Eigen::ArrayXd squared = Eigen::ArrayXd::Zero(count);
+			for (int c = 0; c < 3; ++c)
+			{
+				auto T = temp[c].middleCols(firstCurve, count);
+				if (j - i < 0)
+				{
+					squared += (T.row(ii - 1) - T.row(jj + 1)).array().square().transpose();
+				}
+				else
+				{
+					double alfi = (u - knots[i]) / (knots[i + order] - knots[i]);
+					auto P = poles[c].middleCols(firstCurve, count);
+					squared += (P.row(i) - alfi * T.row(ii + 1) - (1.0 - alfi) * T.row(ii - 1)).array().square().transpose();
+				}
+			}
+			for (int k = 0; k < count; ++k)
+			{
+				removalErrors[firstCurve + k] = std::sqrt(squared[k]);
+			}
+		});
+
+		bool removable = true;
+		for (int k = 0; k < numCurves && removable; ++k)
+		{
+			removable = errors[k] + removalErrors[k] <= tolerance;
+		}
+		if (!removable)
+		{
+			r = last + 1;
+			continue;
+		}
+
+		// save the new control points and remove the knot and the control point fout
+		int fout = (2 * last - s - degree) / 2;
+		int numPoles = static_cast<int>(poles[0].rows());
+		for (int c = 0; c < 3; ++c)
+		{
+			for (int ri = first, rj = lastPole; rj - ri > 0; ++ri, --rj)
+			{
+				poles[c].row(ri) = temp[c].row(ri - off);
+				poles[c].row(rj) = temp[c].row(rj - off);
+			}
+			std::memmove(poles[c].data() + static_cast<size_t>(fout) * numCurves, poles[c].data() + static_cast<size_t>(fout + 1) * numCurves,
+				sizeof(double) * static_cast<size_t>(numPoles - 1 - fout) * numCurves);
+			poles[c].conservativeResize(numPoles - 1, numCurves);
+		}
+		knots.erase(knots.begin() + last);
+
+		for (int k = 0; k < numCurves; ++k)
+		{
+			errors[k] += removalErrors[k];
+		}
+		++numRemoved;
 	}
+
+	return numRemoved;
 }
 
 void util::convertKnots(const std::vector<double>& knots, TColStd_Array1OfReal& geom_knots, TColStd_Array1OfInteger& geom_mults)
@@ -216,13 +897,58 @@ bool util::convertToBSplineCurve(const TopoDS_Shape& shape, TopoDS_Edge& edge, H
 	return true;
 }
 
-void io::readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfShape)& hSequenceOfShape)
+void util::collectBSplineCurves(const Handle(TopTools_HSequenceOfShape)& hSequenceOfShape, std::vector<Handle(Geom_BSplineCurve)>& bsplineCurves)
 {
+	bsplineCurves.clear();
+
+	for (int i = 1; i <= hSequenceOfShape->Length(); ++i)
+	{
+		for (TopExp_Explorer explorer(hSequenceOfShape->Value(i), TopAbs_EDGE); explorer.More(); explorer.Next())
+		{
+			Standard_Real First, Last;
+			Handle(Geom_Curve) curve = BRep_Tool::Curve(TopoDS::Edge(explorer.Current()), First, Last);
+
+			Handle(Geom_BSplineCurve) bsplineCurve = Handle(Geom_BSplineCurve)::DownCast(curve);
+			if (!bsplineCurve.IsNull())
+			{
+				bsplineCurves.emplace_back(bsplineCurve);
+			}
+		}
+	}
+}
+
+void io::readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfShape)& hSequenceOfShape, bool fastCurves)
+{
+	util::TraceScope trace("io::readModel", "io", filename);
 	hSequenceOfShape->Clear();
 	std::string fileStr(filename);
 	std::string extension = fileStr.substr(fileStr.find_last_of('.') + 1);
 	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower); // convert to lower case
 
+	// section curves without any transfer, files the fast readers reject are transferred below
+	if (fastCurves)
+	{
+		std::vector<Handle(Geom_BSplineCurve)> curves;
+		std::string error;
+		bool read = false;
+		if (extension == "step" || extension == "stp")
+		{
+			read = readStepCurves(fileStr, curves, error);
+		}
+		else if (extension == "iges" || extension == "igs")
+		{
+			read = readIgesCurves(fileStr, curves, error);
+		}
+		if (read && !curves.empty())
+		{
+			for (const auto& curve : curves)
+			{
+				hSequenceOfShape->Append(BRepBuilderAPI_MakeEdge(curve).Edge());
+			}
+			return;
+		}
+	}
+
 	IFSelect_ReturnStatus status = IFSelect_RetError;
 
 	if (extension == "step" || extension == "stp")
@@ -286,6 +1012,25 @@ void io::readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfS
 		}
 		hSequenceOfShape->Append(shape);
 	}
+	else if (extension == "nrb")
+	{
+		std::vector<Handle(Geom_BSplineCurve)> curves;
+		std::vector<Handle(Geom_BSplineSurface)> surfaces;
+		std::string error;
+		if (!readNative(fileStr, curves, surfaces, error))
+		{
+			std::cerr << error << std::endl;
+			return;
+		}
+		for (const auto& curve : curves)
+		{
+			hSequenceOfShape->Append(BRepBuilderAPI_MakeEdge(curve).Edge());
+		}
+		for (const auto& surface : surfaces)
+		{
+			hSequenceOfShape->Append(BRepBuilderAPI_MakeFace(surface, Precision::Confusion()).Face());
+		}
+	}
 	else if (extension == "brep") 
 	{
 		TopoDS_Shape shape;
@@ -306,6 +1051,7 @@ void io::readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfS
 
 void io::saveStep(const Standard_CString filename, const Handle(TopTools_HSequenceOfShape)& hSequenceOfShape, const STEPControl_StepModelType mode)
 {
+	util::TraceScope trace("io::saveStep", "io", filename);
 	STEPControl_Writer writer;
 	IFSelect_ReturnStatus status;
 	for (int i = 1; i <= hSequenceOfShape->Length(); ++i)
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <vector>
+#include <Eigen/Core>
+#include "controlnet.h"
+#include "threadpool.h"
 #include <TColgp_Array1OfPnt.hxx>
 #include <TColStd_Array1OfReal.hxx>
 #include <TColStd_Array1OfInteger.hxx>
@@ -9,9 +14,25 @@
 #include <TopTools_HSequenceOfShape.hxx>
 #include <STEPControl_StepModelType.hxx>
 #include <Geom_BSplineCurve.hxx>
+#include <Geom_BSplineSurface.hxx>
 
 namespace nurbs
 {
+	// Dense matrix stored row by row, each row holds the coordinates of all right-hand sides
+	using RowMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+	// Square band matrix, row i stores the entries from column i - lower to column i + upper
+	struct BandedMatrix
+	{
+		int size = 0;	// number of rows and columns
+		int lower = 0;	// number of subdiagonals
+		int upper = 0;	// number of superdiagonals
+		std::vector<double> data;
+
+		double& operator()(int i, int j) { return data[i * (lower + upper + 1) + j - i + lower]; }
+		double operator()(int i, int j) const { return data[i * (lower + upper + 1) + j - i + lower]; }
+	};
+
 	// The total chord length
 	double getTotalChordLength(const TColgp_Array1OfPnt& points);
 
@@ -21,18 +42,115 @@ namespace nurbs
 	// The chord length parameterization for several groups of points
 	void getChordParameterization(const std::vector<TColgp_Array1OfPnt>& points, std::vector<double>& params);
 
+	// The chord length parameterization along the rows of a control net, averaged over its columns
+	void getChordParameterization(const ControlNet& net, std::vector<double>& params);
+
+	// Schemes of the parameters of the sections at v direction
+	enum class Parameterization
+	{
+		Uniform,	// equally spaced
+		ChordLength,	// proportional to the distances between the points
+		Centripetal	// proportional to the square roots of the distances
+	};
+
+	/*
+	 * Parameters along the rows of a control net by the given scheme, averaged over its columns. Every distance is
+	 * computed once with SIMD lanes, and blocks of columns are reduced in parallel and summed in a fixed order, so the
+	 * result is the same whatever the number of threads. Columns of zero length are left out of the average, the
+	 * parameters are uniform if all of them are. A given pool runs the blocks instead of numThreads threads.
+	 **/
+	void getParameterization(const ControlNet& net, Parameterization scheme, std::vector<double>& params, int numThreads = 1,
+		util::ThreadPool* pool = nullptr);
+
 	// Technique of averaging
 	void averageKnotVector(int degree, const std::vector<double>& params, std::vector<double>& knots);
 
+	// Statistics of a knot merge
+	struct KnotMergeReport
+	{
+		int numInputKnots = 0;	// distinct knots of all input vectors
+		int numSnappedKnots = 0;	// knots within tolerance of a different merged knot
+		int numMergedKnots = 0;	// distinct knots of the merged vector
+	};
+
+	/*
+	 * k-way merge of sorted knot vectors into the union of their knots with the maximum multiplicities.
+	 * Knots closer than tolerance to the first knot of a group are snapped onto it, and the multiplicity
+	 * of the group is the largest one contributed by any single vector.
+	 **/
+	void mergeKnots(const std::vector<const TColStd_Array1OfReal*>& knots, const std::vector<const TColStd_Array1OfInteger*>& mults,
+		double tolerance, TColStd_Array1OfReal& mergedKnots, TColStd_Array1OfInteger& mergedMults, KnotMergeReport& report);
+
+	// Check that every knot of the second vector is within tolerance of a knot of the first one with at least its multiplicity
+	bool containsKnots(const TColStd_Array1OfReal& knots, const TColStd_Array1OfInteger& mults,
+		const TColStd_Array1OfReal& subKnots, const TColStd_Array1OfInteger& subMults, double tolerance);
+
+	/*
+	 * Raise a non-periodic curve to "degree" and insert the given knots by BSplCLib on flat coordinate arrays,
+	 * the curve itself is only read. Rational curves are processed in homogeneous coordinates. The resulting
+	 * poles are written to row j of net, false is returned if their number differs from the columns of net.
+	 **/
+	bool compatiblePoles(const Handle(Geom_BSplineCurve)& curve, int degree, const TColStd_Array1OfReal& knots,
+		const TColStd_Array1OfInteger& mults, double tolerance, ControlNet& net, int j);
+
+	// Insert knots into the poles of row j of net, a curve with the given degree and knots, and write them to row j of refined
+	bool refinePoles(const ControlNet& net, int j, int degree, const TColStd_Array1OfReal& knots, const TColStd_Array1OfInteger& mults,
+		const TColStd_Array1OfReal& newKnots, const TColStd_Array1OfInteger& newMults, double tolerance, ControlNet& refined);
+
 	// Find the span of the given parameter in the knot vector
 	int findSpan(int degree, const std::vector<double>& knots, double u);
 
-	// Compute the nonvanishing basis functions.
+	// Compute the nonvanishing basis functions, no allocation happens once basisFuns holds degree + 1 values.
 	void calcBasisFunctions(int span, int degree, const std::vector<double>& knots, double u,
 		std::vector<double>& basisFuns);
 
+	// Compute the nonvanishing basis functions into basisFuns[0..degree] without any allocation
+	void calcBasisFunctions(int span, int degree, const double* knots, double u, double* basisFuns);
+
+	/*
+	 * Find the spans and compute the nonvanishing basis functions of count parameters at once.
+	 * The result is a structure of arrays: spans[i] is the span of params[i] and basisFuns[k * count + i]
+	 * its k-th nonvanishing basis function, so basisFuns holds (degree + 1) * count values.
+	 **/
+	void calcBasisFunctionsBatch(int degree, const std::vector<double>& knots, const double* params, int count,
+		int* spans, double* basisFuns);
+
+	// Number of parameters evaluated together by calcBasisFunctionsBatch, 8 with AVX-512, 4 with AVX2 and 1 otherwise
+	int batchLaneWidth();
+
+	// Build the banded coefficient matrix of interpolation, whose rows are the nonvanishing basis functions at params
+	void buildInterpolationMatrix(int degree, const std::vector<double>& params, const std::vector<double>& knots, BandedMatrix& matrix);
+
+	// Knot vector of a least-squares fit by numPoles control points, NURBS book eq. 9.68 and 9.69
+	void approximationKnotVector(int degree, int numPoles, const std::vector<double>& params, std::vector<double>& knots);
+
+	/*
+	 * Matrix N^T N of the least-squares fit by numPoles control points whose first and last ones interpolate the end points.
+	 * N holds the basis functions 1 to numPoles - 2 at the inner parameters. The matrix is symmetric positive definite
+	 * with bandwidth "degree", so it is factorized by factorBanded.
+	 **/
+	void buildNormalMatrix(int degree, int numPoles, const std::vector<double>& params, const std::vector<double>& knots, BandedMatrix& matrix);
+
+	// LU decomposition of a band matrix in place without pivoting, return false if a zero pivot is met
+	bool factorBanded(BandedMatrix& matrix);
+
+	// Solve the factorized system for all columns of rhs at once, rhs is overwritten by the solution
+	void solveBanded(const BandedMatrix& lu, Eigen::Ref<RowMatrix> rhs);
+
+	// Solve the factorized system for the columns [firstCol, firstCol + numCols) of rhs only
+	void solveBanded(const BandedMatrix& lu, Eigen::Ref<RowMatrix> rhs, int firstCol, int numCols);
+
 	// B-spline curve interpolation
 	void curveInterpolation(const std::vector<double>& params, const std::vector<double>& knots, const TColgp_Array1OfPnt& points, TColgp_Array1OfPnt& controlPoints);
+
+	/*
+	 * Remove knots from curves sharing one knot vector, NURBS book A5.8. "knots" is the flat knot vector, poles[c] holds
+	 * coordinate c with one row per control point and one column per curve. A knot is removed when the accumulated error
+	 * bound of every curve stays within tolerance, errors holds these bounds. Returns the number of knots removed.
+	 * A given pool runs the blocks of curves instead of numThreads threads.
+	 **/
+	int removeKnots(int degree, std::vector<double>& knots, RowMatrix poles[3], double tolerance, std::vector<double>& errors, int numThreads = 1,
+		util::ThreadPool* pool = nullptr);
 };
 
 
@@ -46,13 +164,20 @@ namespace util
 
 	// convert edge to B-spline curve
 	bool convertToBSplineCurve(const TopoDS_Shape& shape, TopoDS_Edge& edge, Handle(Geom_BSplineCurve)& bsplineCurve);
+
+	// collect the B-spline curves of all edges of the shapes, in the order they are explored
+	void collectBSplineCurves(const Handle(TopTools_HSequenceOfShape)& hSequenceOfShape, std::vector<Handle(Geom_BSplineCurve)>& bsplineCurves);
 };
 
 
 namespace io
 {
-	// read step file and save models
-	void readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfShape)& hSequenceOfShape);
+	/*
+	 * read step file and save models. With "fastCurves" the B-spline curves of STEP wireframe models and IGES curve
+	 * files are read by readStepCurves or readIgesCurves and saved as one edge each, the other files are transferred.
+	 * The curves and surfaces of native files (.nrb) are saved as one edge or face each.
+	 **/
+	void readModel(const Standard_CString filename, Handle(TopTools_HSequenceOfShape)& hSequenceOfShape, bool fastCurves = false);
 
 	/*
 	 * translate models and save step file
@@ -60,4 +185,49 @@ namespace io
 	void saveStep(const Standard_CString filename,
 		const Handle(TopTools_HSequenceOfShape)& hSequenceOfShape,
 		const STEPControl_StepModelType mode);
+
+	/*
+	 * Streaming counterpart of saveStep for B-spline geometry: each curve and surface is written as soon as it is
+	 * formatted by a StepStreamWriter, so the memory does not grow with the output. With "maxShardBytes" the output
+	 * is split into files of about that size, "files" receives the names of the files written.
+	 **/
+	bool saveStepStream(const std::string& filename, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+		const std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error, uint64_t maxShardBytes = 0,
+		std::vector<std::string>* files = nullptr);
+
+	/*
+	 * Fast path of readModel for section curves: read the B-spline curves of a STEP wireframe model from the memory
+	 * mapped file without transferring any shape. Only B_SPLINE_CURVE_WITH_KNOTS entities, rational or not, and the
+	 * points they refer to are parsed, after the curves of every representation have been found through its curve
+	 * sets and trimmed curves. The curves are placed by the transformations of the representation relationships and
+	 * scaled to millimetres, one curve per instance, in the order of their entities. "numThreads" counts the calling
+	 * thread, 0 means all cores. Returns false for models holding topology, mapped items or composite curves, which
+	 * are left to readModel.
+	 **/
+	bool readStepCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error,
+		int numThreads = 0);
+
+	/*
+	 * Fast path of readModel for IGES section curves: read the independent rational B-spline curves (type 126) from the
+	 * memory mapped directory and parameter sections without transferring any entity. The curves are placed by their
+	 * transformation matrices and scaled to millimetres, in the order of their directory entries. Their parameter data
+	 * is decoded on "numThreads" threads, counting the calling thread, 0 means all cores. Returns false for files with
+	 * other independent geometry, subfigures or topology, which are left to readModel.
+	 **/
+	bool readIgesCurves(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves, std::string& error,
+		int numThreads = 0);
+
+	/*
+	 * Save B-spline curves and surfaces in the native binary format of nativefile.h: flat little-endian arrays of
+	 * knots, multiplicities, poles and weights written block by block from the OCC arrays, with no translation.
+	 **/
+	bool saveNative(const std::string& filename, const std::vector<Handle(Geom_BSplineCurve)>& curves,
+		const std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error);
+
+	/*
+	 * Read the curves and surfaces of a native file. The file is memory mapped and OCC builds each object from the
+	 * arrays in place, use NativeFile to read the arrays without building any object.
+	 **/
+	bool readNative(const std::string& filename, std::vector<Handle(Geom_BSplineCurve)>& curves,
+		std::vector<Handle(Geom_BSplineSurface)>& surfaces, std::string& error);
 };
\ No newline at end of file